@@ -18,13 +18,22 @@ layout(std140, binding = 0) uniform Camera
 	vec3 u_position;
 };
 
+// Set when drawing a mesh that lives on the GPU, batched vertices are already in world space
+uniform mat4 u_model;
+uniform mat3 u_normalMatrix;
+uniform vec4 u_color;
+uniform int u_textureIndex; // -1 uses the per-vertex index
+
+// Must produce the exact same depth as the depth pre-pass
+invariant gl_Position;
+
 void main()
 {
-	v_position = a_position;
-	v_normal = a_normal;
-	v_color = a_color;
+	v_position = vec3(u_model * vec4(a_position, 1.0f));
+	v_normal = u_normalMatrix * a_normal; // take non-uniform scaling into consideration
+	v_color = a_color * u_color;
 	v_textureCoordinates = a_textureCoordinates;
-	v_textureIndex = a_textureIndex;
+	v_textureIndex = u_textureIndex >= 0 ? uint(u_textureIndex) : a_textureIndex;
 	// Vclip = Camera projection * Camera view * Model transform * Vlocal
-	gl_Position = u_projectionView * vec4(a_position, 1.0f);
+	gl_Position = u_projectionView * (u_model * vec4(a_position, 1.0f));
 }
@@ -2,14 +2,14 @@
 
 layout(location = 0) out vec4 color;
 
-in vec4 v_color;
+in flat vec4 v_color;
 in vec2 v_textureCoordinates;
 in flat uint v_textureIndex;
-in float v_width;
-in float v_edge;
-in float v_borderWidth;
-in float v_borderEdge;
-in vec4 v_borderColor;
+in flat float v_width;
+in flat float v_edge;
+in flat float v_borderWidth;
+in flat float v_borderEdge;
+in flat vec4 v_borderColor;
 in flat float v_offset;
 
 uniform sampler2D u_textures[32];
@@ -1,36 +1,49 @@
 #version 450 core
 
-layout(location = 0) in vec3 a_position;
-layout(location = 1) in vec4 a_color;
-layout(location = 2) in vec2 a_textureCoordinates;
+layout(location = 0) in vec4 a_position;
+layout(location = 1) in vec4 a_textureCoordinates;
+layout(location = 2) in uint a_style;
 layout(location = 3) in uint a_textureIndex;
-layout(location = 4) in float a_width;
-layout(location = 5) in float a_edge;
-layout(location = 6) in float a_borderWidth;
-layout(location = 7) in float a_borderEdge;
-layout(location = 8) in vec4 a_borderColor;
-layout(location = 9) in float a_offset;
 
-out vec4 v_color;
+struct SymbolStyle {
+	vec4 color;
+	vec4 borderColor;
+	float width;
+	float edge;
+	float borderWidth;
+	float borderEdge;
+	float offset;
+};
+
+layout(std430, binding = 1) readonly buffer SymbolStyles
+{
+	SymbolStyle u_styles[];
+};
+
+out flat vec4 v_color;
 out vec2 v_textureCoordinates;
 out flat uint v_textureIndex;
-out float v_width;
-out float v_edge;
-out float v_borderWidth;
-out float v_borderEdge;
-out vec4 v_borderColor;
+out flat float v_width;
+out flat float v_edge;
+out flat float v_borderWidth;
+out flat float v_borderEdge;
+out flat vec4 v_borderColor;
 out flat float v_offset;
 
 void main()
 {
-	v_color = a_color;
-	v_textureCoordinates = a_textureCoordinates;
+	// Triangle strip corners: bottom left, bottom right, top left, top right
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	SymbolStyle style = u_styles[a_style];
+	v_color = style.color;
+	v_textureCoordinates = mix(a_textureCoordinates.xy, a_textureCoordinates.zw, corner);
 	v_textureIndex = a_textureIndex;
-	v_width = a_width;
-	v_edge = a_edge;
-	v_borderWidth = a_borderWidth;
-	v_borderEdge = a_borderEdge;
-	v_borderColor = a_borderColor;
-	v_offset = a_offset;
-	gl_Position = vec4(a_position, 1.0f);
+	v_width = style.width;
+	v_edge = style.edge;
+	v_borderWidth = style.borderWidth;
+	v_borderEdge = style.borderEdge;
+	v_borderColor = style.borderColor;
+	v_offset = style.offset;
+	gl_Position = vec4(mix(a_position.xy, a_position.zw, corner), 0.0f, 1.0f);
 }
@@ -0,0 +1,6 @@
+#version 450 core
+
+void main()
+{
+	// Color writes are disabled, only the depth is stored
+}
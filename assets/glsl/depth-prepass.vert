@@ -0,0 +1,20 @@
+#version 450 core
+
+layout(location = 0) in vec3 a_position;
+
+layout(std140, binding = 0) uniform Camera
+{
+	mat4 u_projectionView;
+	vec3 u_position;
+};
+
+uniform mat4 u_model;
+
+// Must produce the exact same depth as batch-3d, which tests with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+	// Vclip = Camera projection * Camera view * Model transform * Vlocal
+	gl_Position = u_projectionView * (u_model * vec4(a_position, 1.0f));
+}
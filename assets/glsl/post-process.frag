@@ -25,9 +25,9 @@ struct DirectionalLight {
 	vec3 specular;
 };
 
-const int MAX_DIRECTIONAL_LIGHTS = 4;
-layout(std430, binding = 0) buffer DirectionalLights {
-	DirectionalLight u_directionalLight[MAX_DIRECTIONAL_LIGHTS];
+// Sized by the bound buffer range
+layout(std430, binding = 0) readonly buffer DirectionalLights {
+	DirectionalLight u_directionalLight[];
 };
 
 // -----------------------------------------
@@ -50,7 +50,7 @@ void main()
 	vec3 viewDirection = normalize(u_position - position);
 
 	// Loop through all directional lights
-	for (int i = 0; i < MAX_DIRECTIONAL_LIGHTS; ++i) {
+	for (int i = 0; i < u_directionalLight.length(); ++i) {
 		// Diffuse
 		vec3 lightDirection = normalize(-u_directionalLight[i].direction);
 		float diffuse = max(dot(normal, lightDirection), 0.0f);
@@ -12,6 +12,7 @@
 #include "ruc/meta/assert.h"
 
 #include "inferno/application.h"
+#include "inferno/asset/asset-manager.h"
 #include "inferno/component/transformcomponent.h"
 #include "inferno/core.h"
 #include "inferno/event/applicationevent.h"
@@ -24,9 +25,11 @@
 #include "inferno/render/context.h"
 #include "inferno/render/framebuffer.h"
 #include "inferno/render/uniformbuffer.h"
+#include "inferno/render/upload-ring.h"
 #include "inferno/system/rendersystem.h"
 // #include "inferno/render/gltf.h"
 #include "inferno/asset/shader.h"
+#include "inferno/asset/texture-streamer.h"
 #include "inferno/asset/texture.h"
 #include "inferno/render/render-command.h"
 #include "inferno/render/renderer.h"
@@ -54,6 +57,7 @@ Application::Application()
 
 	Input::initialize();
 	RenderCommand::initialize();
+	UploadRing::the(); // Created on the main thread, before the loader threads write into it
 	RenderSystem::the().initialize(m_window->getWidth(), m_window->getHeight());
 
 	m_scene = std::make_shared<Scene>();
@@ -89,6 +93,8 @@ Application::~Application()
 	RendererLightCube::destroy();
 	RenderCommand::destroy();
 	AssetManager::destroy();
+	TextureStreamer::destroy();
+	UploadRing::destroy();
 	// Input::destroy();
 
 	Settings::destroy();
@@ -168,6 +174,10 @@ int Application::run()
 
 		update();
 
+		// Finish the assets that were loaded in the background
+		AssetManager::the().update();
+		TextureStreamer::the().update();
+
 		Input::update();
 		m_window->update();
 		m_scene->update(deltaTime);
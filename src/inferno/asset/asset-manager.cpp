@@ -4,14 +4,21 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <memory> // std::shared_ptr, std::static_pointer_cast
+#include <algorithm> // std::all_of, std::any_of, std::sort
+#include <chrono>
+#include <functional> // std::function
+#include <memory>     // std::shared_ptr, std::static_pointer_cast
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "ruc/format/log.h"
 
 #include "inferno/asset/asset-manager.h"
 #include "inferno/asset/shader.h"
+#include "inferno/render/upload-ring.h"
+#include "inferno/util/thread-pool.h"
 
 namespace Inferno {
 
@@ -19,29 +26,219 @@ namespace Inferno {
 
 AssetManager::AssetManager(s)
 {
-	ruc::info("AssetManager initialized");
+	// ID 0 is reserved as the invalid ID, it resolves to nullptr
+	m_slotChunks[0].store(new Slot[slotChunkSize], std::memory_order_release);
+	m_slotCount.store(1, std::memory_order_release);
+
+	m_threadPool = std::make_unique<ThreadPool>();
+
+	ruc::info("AssetManager initialized, {} loader threads", m_threadPool->size());
 }
 
 AssetManager::~AssetManager()
 {
+	// Wait for the running decodes, before the upload queue goes away
+	m_threadPool.reset();
+
+	for (auto& chunk : m_slotChunks) {
+		delete[] chunk.load(std::memory_order_relaxed);
+	}
+}
+
+void AssetManager::update()
+{
+	uint32_t frame = m_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	std::vector<AssetId> reloads;
+	{
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		reloads.swap(m_reloadQueue);
+	}
+	for (AssetId id : reloads) {
+		Slot& entry = slot(id);
+		std::shared_lock lock(shardFor(entry.path).mutex);
+		auto reload = entry.reload;
+		lock.unlock();
+		reload(*this, id);
+	}
+
+	uploadQueued(true);
+
+	evict();
+
+	if (!reloads.empty()) {
+		ruc::info("AssetManager reloaded {} evicted assets in frame {}", reloads.size(), frame);
+	}
+}
+
+void AssetManager::wait(std::span<const AssetId> ids)
+{
+	auto isReady = [this](AssetId id) {
+		Asset* asset = slot(id).asset.load(std::memory_order_acquire);
+		return asset == nullptr || asset->ready();
+	};
+
+	while (true) {
+		uploadQueued(false);
+
+		if (std::all_of(ids.begin(), ids.end(), isReady)) {
+			break;
+		}
+
+		// Sleep until a worker finished decoding
+		std::unique_lock lock(m_uploadMutex);
+		m_uploadCondition.wait(lock, [this]() { return !m_uploadQueue.empty(); });
+	}
+}
+
+void AssetManager::uploadQueued(bool budgeted)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t uploaded = 0;
+	size_t size = 0;
+
+	// Reclaim the staging memory of the uploads that the GPU has finished
+	UploadRing::the().update();
+
+	while (true) {
+		std::shared_ptr<Asset> asset;
+		{
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
+			if (m_uploadQueue.empty()) {
+				break;
+			}
+
+			// Stop once over budget, the rest of the queue is uploaded in the next frames
+			if (budgeted && uploaded > 0) {
+				std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+				if (elapsed.count() > uploadBudgetTime || size + m_uploadQueue.front()->uploadSize() > uploadBudgetSize) {
+					break;
+				}
+			}
+
+			asset = std::move(m_uploadQueue.front());
+			m_uploadQueue.pop_front();
+		}
+
+		size += asset->uploadSize();
+		asset->upload();
+		asset->setReady();
+		uploaded++;
+	}
+}
+
+std::vector<AssetResidency> AssetManager::residency()
+{
+	std::vector<AssetResidency> result;
+
+	uint32_t count = m_slotCount.load(std::memory_order_acquire);
+	for (AssetId id = 1; id < count; ++id) {
+		Slot& entry = slot(id);
+		Asset* asset = entry.asset.load(std::memory_order_acquire);
+		if (asset == nullptr || !asset->ready()) {
+			continue;
+		}
+
+		result.push_back({
+			.id = id,
+			.type = asset->type(),
+			.cpu = asset->cpuSize(),
+			.gpu = asset->gpuSize(),
+			.shared = asset->sharedSize(),
+			.lastUsed = entry.lastUsed.load(std::memory_order_relaxed),
+		});
+	}
+
+	return result;
+}
+
+void AssetManager::dumpResidency()
+{
+	static constexpr const char* typeNames[] = { "font", "model", "shader", "texture", "other" };
+	static constexpr float mebibyte = 1024.0f * 1024.0f;
+
+	std::array<AssetResidency, static_cast<size_t>(AssetType::Count)> totals {};
+	std::array<uint32_t, static_cast<size_t>(AssetType::Count)> counts {};
+
+	auto assets = residency();
+	for (const auto& asset : assets) {
+		ruc::info("{} {:.2f} MiB cpu, {:.2f} MiB gpu, last used in frame {}: {}",
+		          typeNames[static_cast<size_t>(asset.type)], asset.cpu / mebibyte, asset.gpu / mebibyte, asset.lastUsed, path(asset.id));
+		totals[static_cast<size_t>(asset.type)].cpu += asset.cpu;
+		totals[static_cast<size_t>(asset.type)].gpu += asset.gpu;
+		totals[static_cast<size_t>(asset.type)].shared += asset.shared;
+		counts[static_cast<size_t>(asset.type)]++;
+	}
+
+	for (size_t i = 0; i < totals.size(); ++i) {
+		ruc::info("{}: {} assets, {:.2f}/{:.2f} MiB cpu, {:.2f}/{:.2f} MiB gpu (0 is unlimited), {:.2f} MiB gpu saved by sharing",
+		          typeNames[i], counts[i],
+		          totals[i].cpu / mebibyte, m_budgets[i].cpu / mebibyte,
+		          totals[i].gpu / mebibyte, m_budgets[i].gpu / mebibyte,
+		          totals[i].shared / mebibyte);
+	}
+}
+
+AssetId AssetManager::intern(std::string_view path)
+{
+	Shard& shard = shardFor(path);
+	{
+		std::shared_lock lock(shard.mutex);
+		if (auto it = shard.ids.find(path); it != shard.ids.end()) {
+			return it->second;
+		}
+	}
+
+	std::unique_lock lock(shard.mutex);
+	if (auto it = shard.ids.find(path); it != shard.ids.end()) {
+		return it->second;
+	}
+
+	AssetId id = allocateSlot(path);
+	shard.ids.emplace(std::string(path), id);
+
+	return id;
+}
+
+AssetId AssetManager::find(std::string_view path)
+{
+	Shard& shard = shardFor(path);
+	std::shared_lock lock(shard.mutex);
+
+	auto it = shard.ids.find(path);
+	return it != shard.ids.end() ? it->second : 0;
 }
 
 void AssetManager::add(std::string_view path, std::shared_ptr<Asset> asset)
 {
-	// Construct (key, value) pair and insert it into the unordered_map
-	auto stringPath = std::string(path.begin(), path.end());
-	m_assetList.emplace(std::move(stringPath), std::move(asset));
+	Slot& entry = slot(intern(path));
+	std::unique_lock lock(shardFor(path).mutex);
+
+	entry.asset.store(asset.get(), std::memory_order_release);
+	entry.owner = std::move(asset);
 }
 
 bool AssetManager::exists(std::string_view path)
 {
-	return m_assetList.find(path.data()) != m_assetList.end();
+	AssetId id = find(path);
+	return id != 0 && slot(id).asset.load(std::memory_order_acquire) != nullptr;
 }
 
 std::nullptr_t AssetManager::remove(std::string_view path)
 {
-	if (exists(path)) {
-		m_assetList.erase(path.data());
+	AssetId id = find(path);
+	if (id == 0) {
+		return nullptr;
+	}
+
+	// The ID stays assigned, so handles to it resolve to nullptr until it is loaded again
+	Slot& entry = slot(id);
+	std::shared_ptr<Asset> asset; // Destroyed outside of the lock
+	{
+		std::unique_lock lock(shardFor(path).mutex);
+		entry.asset.store(nullptr, std::memory_order_release);
+		entry.evicted.store(false, std::memory_order_relaxed);
+		asset = std::move(entry.owner);
 	}
 
 	return nullptr;
@@ -49,11 +246,129 @@ std::nullptr_t AssetManager::remove(std::string_view path)
 
 std::nullptr_t AssetManager::remove(std::shared_ptr<Asset> asset)
 {
-	if (exists(asset->path())) {
-		m_assetList.erase(asset->path());
+	return remove(asset->path());
+}
+
+// -----------------------------------------
+
+AssetId AssetManager::allocateSlot(std::string_view path)
+{
+	std::lock_guard<std::mutex> lock(m_slotMutex);
+
+	AssetId id = m_slotCount.load(std::memory_order_relaxed);
+	VERIFY(id < slotChunkSize * slotChunkCount, "asset table is full");
+
+	auto& chunk = m_slotChunks[id / slotChunkSize];
+	if (chunk.load(std::memory_order_relaxed) == nullptr) {
+		chunk.store(new Slot[slotChunkSize], std::memory_order_release);
 	}
+	chunk.load(std::memory_order_relaxed)[id % slotChunkSize].path = std::string(path);
 
-	return nullptr;
+	m_slotCount.store(id + 1, std::memory_order_release);
+
+	return id;
+}
+
+void AssetManager::requestReload(AssetId id)
+{
+	// Only the first use after the eviction queues the load
+	if (!slot(id).evicted.exchange(false, std::memory_order_relaxed)) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_reloadMutex);
+	m_reloadQueue.push_back(id);
+}
+
+void AssetManager::evict()
+{
+	bool hasBudget = std::any_of(m_budgets.begin(), m_budgets.end(), [](const AssetBudget& budget) {
+		return budget.cpu > 0 || budget.gpu > 0;
+	});
+	if (!hasBudget) {
+		return;
+	}
+
+	std::array<AssetBudget, static_cast<size_t>(AssetType::Count)> usage {};
+	auto assets = residency();
+	for (const auto& asset : assets) {
+		usage[static_cast<size_t>(asset.type)].cpu += asset.cpu;
+		usage[static_cast<size_t>(asset.type)].gpu += asset.gpu;
+	}
+
+	auto overBudget = [this, &usage](size_t type) {
+		return (m_budgets[type].cpu > 0 && usage[type].cpu > m_budgets[type].cpu)
+		       || (m_budgets[type].gpu > 0 && usage[type].gpu > m_budgets[type].gpu);
+	};
+
+	// Least recently used first
+	std::sort(assets.begin(), assets.end(), [](const AssetResidency& a, const AssetResidency& b) {
+		return a.lastUsed < b.lastUsed;
+	});
+
+	uint32_t frame = m_frame.load(std::memory_order_relaxed);
+	for (const auto& asset : assets) {
+		size_t type = static_cast<size_t>(asset.type);
+		if (!overBudget(type) || asset.lastUsed + m_budgets[type].evictionDelay > frame) {
+			continue;
+		}
+
+		if (evict(asset.id)) {
+			usage[type].cpu -= asset.cpu;
+			usage[type].gpu -= asset.gpu;
+		}
+	}
+}
+
+bool AssetManager::evict(AssetId id)
+{
+	Slot& entry = slot(id);
+	std::shared_ptr<Asset> asset; // Destroyed outside of the lock
+	{
+		std::unique_lock lock(shardFor(entry.path).mutex);
+
+		// Still referenced outside of the registry, or it can't be loaded again
+		if (entry.owner.use_count() != 1 || entry.handles.load(std::memory_order_relaxed) > 0 || entry.reload == nullptr) {
+			return false;
+		}
+
+		entry.asset.store(nullptr, std::memory_order_release);
+		entry.evicted.store(true, std::memory_order_relaxed);
+		asset = std::move(entry.owner);
+	}
+
+	return true;
+}
+
+// -----------------------------------------
+
+void AssetManager::enqueue(std::function<void()> task)
+{
+	m_threadPool->enqueue([this, task = std::move(task)]() {
+		auto start = std::chrono::steady_clock::now();
+		task();
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		m_decodeTime.fetch_add(elapsed.count(), std::memory_order_relaxed);
+	});
+}
+
+void AssetManager::queueUpload(std::shared_ptr<Asset> asset)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_uploadMutex);
+		m_uploadQueue.push_back(std::move(asset));
+	}
+	m_uploadCondition.notify_one();
+}
+
+void AssetManager::decodeAsync(std::shared_ptr<Asset> asset)
+{
+	enqueue([this, asset]() {
+		asset->decode();
+		if (!asset->decodeDeferred()) {
+			queueUpload(asset);
+		}
+	});
 }
 
 } // namespace Inferno
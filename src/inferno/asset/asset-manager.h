@@ -6,12 +6,25 @@
 
 #pragma once
 
-#include <cstddef> // std::nullptr_t
-#include <memory>  // std::shared_ptr
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef> // size_t, std::nullptr_t
+#include <cstdint> // int64_t, uint32_t
+#include <deque>
+#include <functional> // std::equal_to, std::hash
+#include <future>     // std::promise, std::shared_future
+#include <memory>     // std::shared_ptr, std::unique_ptr
+#include <mutex>
+#include <shared_mutex>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <utility> // std::forward
+#include <vector>
 
 #include "ruc/meta/assert.h"
 #include "ruc/meta/types.h"
@@ -19,12 +32,51 @@
 
 namespace Inferno {
 
+class ThreadPool;
+
+enum class AssetType : uint8_t {
+	Font = 0,
+	Model,
+	Shader,
+	Texture,
+	Other,
+	Count,
+};
+
 class Asset {
 public:
 	virtual ~Asset() = default;
 
 	std::string path() const { return m_path; }
 
+	// Assets that load in the background can only be used once they are ready
+	bool ready() const { return m_ready.load(std::memory_order_acquire); }
+	void setReady() { m_ready.store(true, std::memory_order_release); }
+
+	// Asynchronous loading, decode() runs on a worker thread and does the file
+	// reading and parsing, upload() runs on the main thread and creates the GPU objects
+	virtual void decode() {}
+	virtual void upload() {}
+	virtual size_t uploadSize() const { return 0; } // Bytes that upload() sends to the GPU
+	// Set by a decode() that continues in loader tasks of its own, the last of which
+	// queues the upload through AssetManager::queueUpload()
+	bool decodeDeferred() const { return m_decodeDeferred; }
+
+	// Estimated memory use, only valid once the asset is ready
+	virtual size_t cpuSize() const { return 0; }
+	virtual size_t gpuSize() const { return 0; }
+	// GPU memory that is used from another asset with the same content, not part of gpuSize()
+	virtual size_t sharedSize() const { return 0; }
+
+	AssetType type() const
+	{
+		return isFont()      ? AssetType::Font
+		       : isModel()   ? AssetType::Model
+		       : isShader()  ? AssetType::Shader
+		       : isTexture() ? AssetType::Texture
+		                     : AssetType::Other;
+	}
+
 	// -------------------------------------
 
 	std::string className() const { return typeid(*this).name(); }
@@ -48,6 +100,8 @@ protected:
 
 protected:
 	std::string m_path;
+	std::atomic<bool> m_ready { true };
+	bool m_decodeDeferred { false };
 };
 
 // -----------------------------------------
@@ -55,13 +109,172 @@ protected:
 template<typename T>
 concept IsAsset = std::same_as<Asset, T> || std::derived_from<T, Asset>;
 
+// Asset types that can be created in a pending state, to be decoded in the background
+template<typename T>
+concept IsAsyncAsset = IsAsset<T> && requires(std::string_view path) {
+	{ T::createAsync(path) } -> std::same_as<std::shared_ptr<T>>;
+};
+
+// -----------------------------------------
+
+// Interned asset path, 0 is never assigned so it doubles as the invalid ID
+using AssetId = uint32_t;
+
+// Lets the maps be searched with a std::string_view, without building a std::string
+struct StringHash {
+	using is_transparent = void;
+
+	size_t operator()(std::string_view string) const { return std::hash<std::string_view> {}(string); }
+};
+
+// Lightweight reference to an asset, stored in components instead of a
+// std::shared_ptr. It is resolved through the dense asset table and stays valid
+// when the asset is removed. The live handles of an asset are counted in its
+// slot, an asset that is referenced by a handle is never evicted.
+template<IsAsset T>
+class AssetHandle {
+public:
+	AssetHandle() = default;
+	explicit AssetHandle(AssetId id)
+		: m_id(id)
+	{
+		retain();
+	}
+	AssetHandle(const AssetHandle& other)
+		: m_id(other.m_id)
+	{
+		retain();
+	}
+	AssetHandle(AssetHandle&& other) noexcept
+		: m_id(other.m_id)
+	{
+		other.m_id = 0;
+	}
+	~AssetHandle() { release(); }
+
+	// Handles convert to handles of a base class, like std::shared_ptr
+	template<IsAsset U>
+	requires std::derived_from<U, T>
+	AssetHandle(const AssetHandle<U>& other)
+		: m_id(other.id())
+	{
+		retain();
+	}
+
+	AssetHandle& operator=(const AssetHandle& other)
+	{
+		if (m_id != other.m_id) {
+			release();
+			m_id = other.m_id;
+			retain();
+		}
+		return *this;
+	}
+	AssetHandle& operator=(AssetHandle&& other) noexcept
+	{
+		if (this != &other) {
+			release();
+			m_id = other.m_id;
+			other.m_id = 0;
+		}
+		return *this;
+	}
+
+	// Returns nullptr if the asset is not loaded
+	T* get() const;
+	T* operator->() const { return get(); }
+
+	bool valid() const { return m_id != 0; }
+	bool ready() const
+	{
+		T* asset = get();
+		return asset != nullptr && asset->ready();
+	}
+	AssetId id() const { return m_id; }
+
+	bool operator==(const AssetHandle& other) const { return m_id == other.m_id; }
+
+private:
+	void retain() const;
+	void release() const;
+
+	AssetId m_id { 0 };
+};
+
+// Memory limits of an asset type in bytes, 0 is unlimited
+struct AssetBudget {
+	size_t cpu { 0 };
+	size_t gpu { 0 };
+	uint32_t evictionDelay { 2 }; // Assets used within this many frames are never evicted
+};
+
+struct AssetResidency {
+	AssetId id { 0 };
+	AssetType type { AssetType::Other };
+	size_t cpu { 0 };
+	size_t gpu { 0 };
+	size_t shared { 0 };
+	uint32_t lastUsed { 0 }; // Frame
+};
+
 // -----------------------------------------
 
+// Thread-safe asset registry. Paths are interned once into an AssetId, which
+// indexes a dense table of the loaded assets. The path to ID maps are spread
+// over shards that each have their own read-write lock, so lookups only contend
+// when they are on the same shard. Concurrent loads of the same path are
+// deduplicated, the first caller loads the asset and the others wait for its result.
+//
+// Assets may only be removed on the main thread while nothing is being drawn,
+// resolved pointers are valid until then.
+//
+// When an asset type goes over its budget, the least recently used assets that
+// are not referenced outside of the registry, by a std::shared_ptr or a handle, are evicted. Their ID stays valid,
+// resolving a handle to an evicted asset loads it again in the background.
 class AssetManager : public ruc::Singleton<AssetManager> {
 public:
+	static constexpr const uint32_t shardCount = 16;
+	static constexpr const uint32_t slotChunkSize = 1024;
+	static constexpr const uint32_t slotChunkCount = 1024;
+
+	// Main thread time and bytes spent on uploads per frame, at least one asset is always uploaded
+	static constexpr const float uploadBudgetTime = 2.0f; // ms
+	static constexpr const size_t uploadBudgetSize = 32 * 1024 * 1024;
+
 	AssetManager(s);
 	virtual ~AssetManager();
 
+	// Upload the assets that finished decoding and evict the ones over budget, called once per frame
+	void update();
+
+	// Upload until all of the assets are ready, without a budget, main thread only
+	void wait(std::span<const AssetId> ids);
+
+	// Run part of a decode on the loader threads, its time counts as decode time
+	void enqueue(std::function<void()> task);
+	// Queue a decoded asset for its upload on the main thread
+	void queueUpload(std::shared_ptr<Asset> asset);
+
+	// Total time the loader threads spent decoding, summed over all threads
+	std::chrono::microseconds decodeTime() const { return std::chrono::microseconds(m_decodeTime.load(std::memory_order_relaxed)); }
+
+	void setBudget(AssetType type, AssetBudget budget) { m_budgets[static_cast<size_t>(type)] = budget; }
+	AssetBudget budget(AssetType type) const { return m_budgets[static_cast<size_t>(type)]; }
+
+	// Resident assets and their memory use, main thread only
+	std::vector<AssetResidency> residency();
+	void dumpResidency();
+
+	// Returns the ID of the path, assigning one the first time it is seen
+	AssetId intern(std::string_view path);
+	// Returns 0 if the path has never been interned
+	AssetId find(std::string_view path);
+	std::string_view path(AssetId id) { return slot(id).path; }
+
+	// Count the live handles of an asset, used by AssetHandle
+	void retain(AssetId id) { slot(id).handles.fetch_add(1, std::memory_order_relaxed); }
+	void release(AssetId id) { slot(id).handles.fetch_sub(1, std::memory_order_relaxed); }
+
 	void add(std::string_view path, std::shared_ptr<Asset> asset);
 	bool exists(std::string_view path);
 	std::nullptr_t remove(std::string_view path);
@@ -70,29 +283,208 @@ public:
 	template<IsAsset T>
 	std::shared_ptr<T> get(std::string_view path)
 	{
-		if (!exists(path)) {
+		AssetId id = find(path);
+		if (id == 0) {
 			return nullptr;
 		}
 
-		auto asset = m_assetList.at(path.data());
-		VERIFY(is<T>(asset.get()), "expected asset {}, got {}", typeid(T).name(), asset->className());
-		return std::static_pointer_cast<T>(asset);
+		Slot& entry = slot(id);
+		touch(entry);
+		std::shared_lock lock(shardFor(entry.path).mutex);
+		return entry.owner ? cast<T>(entry.owner) : nullptr;
+	}
+
+	// Lock-free lookup, the type was checked when the asset was loaded
+	template<IsAsset T>
+	T* resolve(AssetId id)
+	{
+		Slot& entry = slot(id);
+		touch(entry);
+
+		Asset* asset = entry.asset.load(std::memory_order_acquire);
+		if (asset == nullptr && entry.evicted.load(std::memory_order_relaxed)) {
+			requestReload(id);
+		}
+
+		return static_cast<T*>(asset);
 	}
 
 	template<IsAsset T, typename... Args>
 	std::shared_ptr<T> load(std::string_view path, Args&&... args)
 	{
-		if (exists(path)) {
-			return get<T>(path);
+		return load<T>(intern(path), std::forward<Args>(args)...);
+	}
+
+	template<IsAsset T, typename... Args>
+	AssetHandle<T> loadHandle(std::string_view path, Args&&... args)
+	{
+		AssetId id = intern(path);
+		load<T>(id, std::forward<Args>(args)...);
+		return AssetHandle<T>(id);
+	}
+
+	template<IsAsset T, typename... Args>
+	std::shared_ptr<T> load(AssetId id, Args&&... args)
+	{
+		Slot& entry = slot(id);
+		touch(entry);
+		Shard& shard = shardFor(entry.path);
+		{
+			std::shared_lock lock(shard.mutex);
+			if (entry.owner) {
+				return cast<T>(entry.owner);
+			}
+		}
+
+		// Claim the load, or join the one that is already in flight
+		std::promise<std::shared_ptr<Asset>> promise;
+		{
+			std::unique_lock lock(shard.mutex);
+
+			if (entry.owner) {
+				return cast<T>(entry.owner);
+			}
+
+			if (auto it = shard.loading.find(id); it != shard.loading.end()) {
+				auto future = it->second;
+				lock.unlock();
+				return cast<T>(future.get());
+			}
+
+			shard.loading.emplace(id, promise.get_future().share());
+		}
+
+		// Returns right away, the asset is ready once it has been decoded and uploaded
+		std::shared_ptr<T> asset;
+		if constexpr (IsAsyncAsset<T> && sizeof...(Args) == 0) {
+			asset = T::createAsync(entry.path);
+		}
+		else {
+			asset = T::create(entry.path, std::forward<Args>(args)...);
+		}
+
+		{
+			std::unique_lock lock(shard.mutex);
+			entry.owner = asset;
+			entry.asset.store(asset.get(), std::memory_order_release);
+			entry.evicted.store(false, std::memory_order_relaxed);
+			// Only assets that are loaded from their path alone can be evicted and loaded again
+			if constexpr (sizeof...(Args) == 0) {
+				entry.reload = &AssetManager::reload<T>;
+			}
+			shard.loading.erase(id);
+		}
+		promise.set_value(asset);
+
+		if constexpr (IsAsyncAsset<T> && sizeof...(Args) == 0) {
+			decodeAsync(asset);
 		}
 
-		auto asset = T::create(path, std::forward<Args>(args)...);
-		add(path, asset);
 		return asset;
 	}
 
 private:
-	std::unordered_map<std::string, std::shared_ptr<Asset>> m_assetList;
+	// Entry of the dense asset table. The path is written once when the ID is
+	// assigned, the owner and reload are guarded by the mutex of the shard of the path.
+	struct Slot {
+		std::atomic<Asset*> asset { nullptr };
+		std::atomic<uint32_t> lastUsed { 0 };
+		std::atomic<uint32_t> handles { 0 }; // Live AssetHandles
+		std::atomic<bool> evicted { false };
+		std::shared_ptr<Asset> owner;
+		void (*reload)(AssetManager&, AssetId) { nullptr };
+		std::string path;
+	};
+
+	struct Shard {
+		std::shared_mutex mutex;
+		std::unordered_map<std::string, AssetId, StringHash, std::equal_to<>> ids;
+		std::unordered_map<AssetId, std::shared_future<std::shared_ptr<Asset>>> loading;
+	};
+
+	Shard& shardFor(std::string_view path) { return m_shards[StringHash {}(path) % shardCount]; }
+
+	// Chunks are never moved or freed while running, so slots can be read without a lock
+	Slot& slot(AssetId id)
+	{
+		VERIFY(id < m_slotCount.load(std::memory_order_acquire), "invalid asset id {}", id);
+		return m_slotChunks[id / slotChunkSize].load(std::memory_order_acquire)[id % slotChunkSize];
+	}
+
+	AssetId allocateSlot(std::string_view path);
+
+	void touch(Slot& entry)
+	{
+		uint32_t frame = m_frame.load(std::memory_order_relaxed);
+		if (entry.lastUsed.load(std::memory_order_relaxed) != frame) {
+			entry.lastUsed.store(frame, std::memory_order_relaxed);
+		}
+	}
+
+	template<IsAsset T>
+	static void reload(AssetManager& manager, AssetId id)
+	{
+		manager.load<T>(id);
+	}
+
+	void requestReload(AssetId id);
+	void evict();
+	bool evict(AssetId id);
+
+	template<IsAsset T>
+	static std::shared_ptr<T> cast(const std::shared_ptr<Asset>& asset)
+	{
+		VERIFY(is<T>(asset.get()), "expected asset {}, got {}", typeid(T).name(), asset->className());
+		return std::static_pointer_cast<T>(asset);
+	}
+
+	void uploadQueued(bool budgeted);
+	void decodeAsync(std::shared_ptr<Asset> asset);
+
+private:
+	std::array<Shard, shardCount> m_shards;
+
+	std::mutex m_slotMutex; // Guards assigning IDs and allocating chunks
+	std::atomic<uint32_t> m_slotCount { 0 };
+	std::array<std::atomic<Slot*>, slotChunkCount> m_slotChunks {};
+
+	std::atomic<uint32_t> m_frame { 1 };
+	std::array<AssetBudget, static_cast<size_t>(AssetType::Count)> m_budgets {};
+
+	// Evicted assets that were used again, loaded at the next update
+	std::mutex m_reloadMutex;
+	std::vector<AssetId> m_reloadQueue;
+
+	// Decoded assets, waiting for their upload on the main thread
+	std::mutex m_uploadMutex;
+	std::condition_variable m_uploadCondition;
+	std::deque<std::shared_ptr<Asset>> m_uploadQueue;
+	std::atomic<int64_t> m_decodeTime { 0 }; // Microseconds
+	std::unique_ptr<ThreadPool> m_threadPool;
 };
 
+// -----------------------------------------
+
+template<IsAsset T>
+T* AssetHandle<T>::get() const
+{
+	return AssetManager::the().resolve<T>(m_id);
+}
+
+template<IsAsset T>
+void AssetHandle<T>::retain() const
+{
+	if (m_id != 0) {
+		AssetManager::the().retain(m_id);
+	}
+}
+
+template<IsAsset T>
+void AssetHandle<T>::release() const
+{
+	if (m_id != 0) {
+		AssetManager::the().release(m_id);
+	}
+}
+
 } // namespace Inferno
@@ -4,35 +4,329 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <array>    // std::array
-#include <charconv> // std;:from_chars
-#include <cstdint>  // int32_t, uint32_t
-#include <ranges>   // std::views::split
-#include <string>   // std::getline
+#include <algorithm> // std::any_of, std::lower_bound, std::sort
+#include <array>     // std::array
+#include <charconv>  // std;:from_chars
+#include <cstdint>   // int32_t, uint32_t, uint64_t
+#include <cstring>   // std::memcpy
+#include <fstream>   // std::ofstream
+#include <ranges>    // std::views::split
+#include <string>    // std::getline
 
 #include "ruc/file.h"
+#include "ruc/format/log.h"
 #include "ruc/meta/assert.h"
 #include "ruc/meta/concepts.h"
+#include "stb/stb_image.h"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb/stb_truetype.h"
 
 #include "inferno/asset/font.h"
+#include "inferno/asset/glyph-atlas.h"
 #include "inferno/asset/texture.h"
 
 namespace Inferno {
 
+Font::Font(std::string_view path)
+	: Asset(path)
+{
+}
+
+Font::~Font()
+{
+}
+
 std::shared_ptr<Font> Font::create(std::string_view path)
 {
 	auto result = std::shared_ptr<Font>(new Font(path));
 
-	auto stringPath = std::string(path);
-	std::string file = stringPath + ".fnt";
-	std::string image = stringPath + ".png";
+	if (path.ends_with(".ttf") || path.ends_with(".otf")) {
+		result->loadTrueType();
+	}
+	else if (!result->loadBinary()) {
+		result->loadBMFont();
+	}
+
+	return result;
+}
+
+const Symbol* Font::get(uint32_t codepoint)
+{
+	if (!m_atlas) {
+		return codepoint < m_symbols.size() && m_symbols[codepoint].defined ? &m_symbols[codepoint] : nullptr;
+	}
 
-	std::string font = ruc::File(file).data();
-	result->parseFont(font);
+	auto [it, inserted] = m_glyphs.try_emplace(codepoint);
+	Symbol& symbol = it->second;
+	if (inserted) {
+		if (stbtt_FindGlyphIndex(m_info.get(), static_cast<int>(codepoint)) == 0) {
+			return nullptr;
+		}
 
-	result->m_texture = Texture2D::create(image);
+		int advance = 0;
+		int leftSideBearing = 0;
+		stbtt_GetCodepointHMetrics(m_info.get(), static_cast<int>(codepoint), &advance, &leftSideBearing);
 
-	return result;
+		symbol.id = codepoint;
+		symbol.advance = advance * m_scale;
+		symbol.defined = true;
+
+		if (!rasterize(symbol)) {
+			m_glyphs.erase(it);
+			return nullptr;
+		}
+		return &symbol;
+	}
+
+	if (!symbol.defined) {
+		return nullptr;
+	}
+
+	// Empty symbols (like space) have nothing in the atlas
+	if (symbol.size.x == 0 || symbol.size.y == 0) {
+		return &symbol;
+	}
+
+	// Rasterize again if the glyph has been evicted
+	if (m_atlas->find(codepoint) == nullptr && !rasterize(symbol)) {
+		return nullptr;
+	}
+
+	return &symbol;
+}
+
+float Font::kerning(uint32_t previous, uint32_t current) const
+{
+	if (m_atlas) {
+		if (previous == 0) {
+			return 0.0f;
+		}
+		return stbtt_GetCodepointKernAdvance(m_info.get(), static_cast<int>(previous), static_cast<int>(current)) * m_scale;
+	}
+
+	if (m_kernings.empty()) {
+		return 0.0f;
+	}
+
+	uint64_t pair = (static_cast<uint64_t>(previous) << 32) | current;
+	auto it = std::lower_bound(m_kernings.begin(), m_kernings.end(), pair, [](const Kerning& kerning, uint64_t pair) {
+		return kerning.pair < pair;
+	});
+
+	return it != m_kernings.end() && it->pair == pair ? it->amount : 0.0f;
+}
+
+uint32_t Font::generation() const
+{
+	return m_atlas ? m_atlas->generation() : 0;
+}
+
+bool Font::evicted(std::span<const uint32_t> codepoints, uint32_t generation) const
+{
+	if (!m_atlas || m_atlas->generation() == generation) {
+		return false;
+	}
+
+	return std::any_of(codepoints.begin(), codepoints.end(), [this, generation](uint32_t codepoint) {
+		return m_atlas->evicted(codepoint, generation);
+	});
+}
+
+void Font::touch(std::span<const uint32_t> codepoints)
+{
+	if (!m_atlas) {
+		return;
+	}
+
+	for (uint32_t codepoint : codepoints) {
+		m_atlas->find(codepoint);
+	}
+}
+
+void Font::upload()
+{
+	if (m_atlas) {
+		m_atlas->upload();
+	}
+}
+
+size_t Font::cpuSize() const
+{
+	size_t size = m_symbolStorage.capacity() * sizeof(Symbol)
+	              + m_kerningStorage.capacity() * sizeof(Kerning)
+	              + m_file.size()
+	              + m_glyphs.size() * sizeof(Symbol);
+	if (m_atlas) {
+		size += static_cast<size_t>(atlasSize) * atlasSize; // CPU copy of the atlas
+	}
+
+	return size;
+}
+
+size_t Font::gpuSize() const
+{
+	return m_texture ? m_texture->gpuSize() : 0;
+}
+
+// -----------------------------------------
+
+void Font::loadBMFont()
+{
+	std::string file = m_path + ".fnt";
+	std::string image = m_path + ".png";
+
+	std::string font(FileSystem::the().read(file).string());
+	parseFont(font);
+
+	m_texture = Texture2D::create(image);
+	calculateTextureCoordinates(static_cast<float>(m_texture->width()), static_cast<float>(m_texture->height()));
+}
+
+bool Font::loadBinary()
+{
+	auto file = FileSystem::the().read(m_path + ".ifnt");
+	if (!file.valid() || file.size() < sizeof(FontHeader)) {
+		return false;
+	}
+
+	const FontHeader& header = file.span<FontHeader>(0, 1).front();
+	FontHeader current;
+	if (header.magic != current.magic || header.version != current.version
+	    || header.symbolStride != current.symbolStride || header.kerningStride != current.kerningStride) {
+		ruc::warn("Font precompiled file is outdated, parsing text instead: '{}'", m_path);
+		return false;
+	}
+
+	m_file = file;
+	m_size = static_cast<unsigned char>(header.size);
+	m_lineSpacing = header.lineSpacing;
+	m_symbols = file.span<Symbol>(header.symbolOffset, header.symbolCount);
+	m_kernings = file.span<Kerning>(header.kerningOffset, header.kerningCount);
+
+	auto atlas = file.span<uint8_t>(header.atlasOffset, header.atlasSize);
+	if (header.atlasEmbedded) {
+		m_texture = Texture2D::create(m_path + ".png", atlas);
+	}
+	else {
+		std::string directory = m_path.substr(0, m_path.find_last_of('/') + 1);
+		m_texture = Texture2D::create(directory + std::string(atlas.begin(), atlas.end()));
+	}
+
+	return true;
+}
+
+bool Font::cook(std::string_view path, bool embedAtlas)
+{
+	Font font(path);
+	std::string image = font.m_path + ".png";
+	font.parseFont(ruc::File(font.m_path + ".fnt").data());
+
+	// Texture coordinates only need the image size, which is read from the file header
+	std::string imageData = ruc::File(image).data();
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	auto imageBytes = reinterpret_cast<const unsigned char*>(imageData.data());
+	if (!stbi_info_from_memory(imageBytes, static_cast<int>(imageData.size()), &width, &height, &channels)) {
+		ruc::error("Font could not read atlas: '{}'", image);
+		return false;
+	}
+	font.calculateTextureCoordinates(static_cast<float>(width), static_cast<float>(height));
+
+	std::string atlas = embedAtlas ? imageData : image.substr(image.find_last_of('/') + 1);
+
+	auto align = [](uint32_t offset, uint32_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); };
+
+	FontHeader header;
+	header.size = font.m_size;
+	header.lineSpacing = font.m_lineSpacing;
+	header.symbolCount = static_cast<uint32_t>(font.m_symbolStorage.size());
+	header.symbolOffset = align(sizeof(FontHeader), alignof(Symbol));
+	header.kerningCount = static_cast<uint32_t>(font.m_kerningStorage.size());
+	header.kerningOffset = align(header.symbolOffset + header.symbolCount * sizeof(Symbol), alignof(Kerning));
+	header.atlasOffset = header.kerningOffset + header.kerningCount * sizeof(Kerning);
+	header.atlasSize = static_cast<uint32_t>(atlas.size());
+	header.atlasEmbedded = embedAtlas;
+
+	std::vector<char> data(header.atlasOffset + header.atlasSize, 0);
+	std::memcpy(data.data(), &header, sizeof(FontHeader));
+	std::memcpy(data.data() + header.symbolOffset, font.m_symbolStorage.data(), header.symbolCount * sizeof(Symbol));
+	std::memcpy(data.data() + header.kerningOffset, font.m_kerningStorage.data(), header.kerningCount * sizeof(Kerning));
+	std::memcpy(data.data() + header.atlasOffset, atlas.data(), atlas.size());
+
+	std::string output = font.m_path + ".ifnt";
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	if (!file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+		ruc::error("Font could not write: '{}'", output);
+		return false;
+	}
+
+	ruc::info("Font cooked: '{}', {} symbols, {} kernings", output, header.symbolCount, header.kerningCount);
+	return true;
+}
+
+void Font::loadTrueType()
+{
+	m_file = FileSystem::the().read(m_path);
+	VERIFY(m_file.valid(), "failed to load font: '{}'", m_path);
+
+	auto data = m_file.data();
+	m_info = std::make_unique<stbtt_fontinfo>();
+	VERIFY(stbtt_InitFont(m_info.get(), data, stbtt_GetFontOffsetForIndex(data, 0)), "invalid font: '{}'", m_path);
+
+	int ascent = 0;
+	int descent = 0;
+	int lineGap = 0;
+	stbtt_GetFontVMetrics(m_info.get(), &ascent, &descent, &lineGap);
+
+	m_scale = stbtt_ScaleForPixelHeight(m_info.get(), static_cast<float>(sdfPixelHeight));
+	m_ascent = ascent * m_scale;
+	m_size = sdfPixelHeight;
+	m_lineSpacing = static_cast<uint32_t>((ascent - descent + lineGap) * m_scale);
+
+	m_atlas = std::make_unique<GlyphAtlas>(atlasSize, atlasSize);
+	m_texture = m_atlas->texture();
+}
+
+bool Font::rasterize(Symbol& symbol)
+{
+	int width = 0;
+	int height = 0;
+	int offsetX = 0;
+	int offsetY = 0;
+	unsigned char* bitmap = stbtt_GetCodepointSDF(
+		m_info.get(), m_scale, static_cast<int>(symbol.id),
+		sdfPadding,          // Pixels around the glyph the distance field extends to
+		128,                 // Value of the glyph edge
+		128.0f / sdfPadding, // Value change per pixel of distance
+		&width, &height, &offsetX, &offsetY);
+
+	// Empty symbols (like space) produce no bitmap
+	if (bitmap == nullptr) {
+		symbol.size = { 0.0f, 0.0f };
+		return true;
+	}
+
+	const AtlasRect* rect = m_atlas->insert(symbol.id, width, height, bitmap);
+	stbtt_FreeSDF(bitmap, nullptr);
+
+	// Atlas is full of glyphs that are used this frame
+	if (rect == nullptr) {
+		return false;
+	}
+
+	// The offset is relative to the baseline, the layout measures from the top of the line
+	symbol.position = { rect->x, rect->y };
+	symbol.size = glm::vec2(glm::ivec2(width, height));
+	symbol.offset = glm::vec2(glm::ivec2(offsetX, offsetY)) + glm::vec2(0.0f, m_ascent);
+
+	// Rows are stored top to bottom, so the top of the glyph has the lowest v
+	float atlasWidth = static_cast<float>(m_atlas->width());
+	float atlasHeight = static_cast<float>(m_atlas->height());
+	symbol.textureMin = { rect->x / atlasWidth, (rect->y + rect->height) / atlasHeight };
+	symbol.textureMax = { (rect->x + rect->width) / atlasWidth, rect->y / atlasHeight };
+
+	return true;
 }
 
 // TODO: Move this to ruc
@@ -77,27 +371,36 @@ void Font::parseFont(const std::string& font)
 		// ---------------------------------
 
 		if (action.compare("char") == 0) {
-			auto id = convert<char>(findValue("id", columns));
+			auto id = convert<uint32_t>(findValue("id", columns));
 			auto width = convert<uint32_t>(findValue("width", columns));
 			auto height = convert<uint32_t>(findValue("height", columns));
+			glm::uvec2 size = {
+				width == 0 ? 0 : width - m_padding[Padding::Left] - m_padding[Padding::Right],
+				height == 0 ? 0 : height - m_padding[Padding::Top] - m_padding[Padding::Bottom],
+			};
+			glm::ivec2 offset = {
+				convert<int32_t>(findValue("xoffset", columns)) + static_cast<int32_t>(m_padding[Padding::Left]),
+				convert<int32_t>(findValue("yoffset", columns)) + static_cast<int32_t>(m_padding[Padding::Top]),
+			};
+			uint32_t advance = convert<uint32_t>(findValue("xadvance", columns)) - m_padding[Padding::Left] - m_padding[Padding::Right];
+
+			// Store the metrics as floats, the layout code works in floats
 			Symbol symbol = {
 				.id = id,
 				.position = {
 					convert<uint32_t>(findValue("x", columns)) + m_padding[Padding::Left],
 					convert<uint32_t>(findValue("y", columns)) + m_padding[Padding::Top],
 				},
-				.size = {
-					width == 0 ? 0 : width - m_padding[Padding::Left] - m_padding[Padding::Right],
-					height == 0 ? 0 : height - m_padding[Padding::Top] - m_padding[Padding::Bottom],
-				},
-				.offset = {
-					convert<int32_t>(findValue("xoffset", columns)) + m_padding[Padding::Left],
-					convert<int32_t>(findValue("yoffset", columns)) + m_padding[Padding::Top],
-				},
-				.advance = convert<uint32_t>(findValue("xadvance", columns)) - m_padding[Padding::Left] - m_padding[Padding::Right]
+				.size = glm::vec2(size),
+				.offset = glm::vec2(offset),
+				.advance = static_cast<float>(advance),
+				.defined = true,
 			};
 
-			m_symbolList.emplace(id, std::make_shared<Symbol>(symbol));
+			if (id >= m_symbolStorage.size()) {
+				m_symbolStorage.resize(id + 1);
+			}
+			m_symbolStorage[id] = symbol;
 			continue;
 		}
 
@@ -105,19 +408,41 @@ void Font::parseFont(const std::string& font)
 		// ---------------------------------
 
 		if (action.compare("kerning") == 0) {
-			unsigned char first = convert<unsigned char>(findValue("first", columns));
-			unsigned char second = convert<unsigned char>(findValue("second", columns));
-			char amount = convert<char>(findValue("amount", columns));
-
-			// Add the kerning of the previous symbol to this symbol
-			if (m_symbolList.find(second) != m_symbolList.end()) {
-				auto symbol = m_symbolList.at(second);
-				symbol->kernings.emplace(first, amount);
-			}
+			auto first = convert<uint32_t>(findValue("first", columns));
+			auto second = convert<uint32_t>(findValue("second", columns));
+			auto amount = convert<int32_t>(findValue("amount", columns));
+
+			m_kerningStorage.push_back({
+				.pair = (static_cast<uint64_t>(first) << 32) | second,
+				.amount = static_cast<float>(amount),
+			});
 
 			continue;
 		}
 	}
+
+	// Sort once, so kerning lookups can use a binary search
+	std::sort(m_kerningStorage.begin(), m_kerningStorage.end(), [](const Kerning& a, const Kerning& b) {
+		return a.pair < b.pair;
+	});
+
+	m_symbols = m_symbolStorage;
+	m_kernings = m_kerningStorage;
+}
+
+void Font::calculateTextureCoordinates(float textureWidth, float textureHeight)
+{
+	// The texture is flipped vertically on load, so the y-axis starts at the bottom
+	for (auto& symbol : m_symbolStorage) {
+		symbol.textureMin = {
+			symbol.position.x / textureWidth,
+			(textureHeight - symbol.position.y - symbol.size.y) / textureHeight,
+		};
+		symbol.textureMax = {
+			(symbol.position.x + symbol.size.x) / textureWidth,
+			(textureHeight - symbol.position.y) / textureHeight,
+		};
+	}
 }
 
 std::string Font::findAction(const std::string& line) const
@@ -7,43 +7,87 @@
 #pragma once
 
 #include <array>   // std::array
-#include <cstdint> // int32_t, uint32_t
+#include <cstdint> // int32_t, uint32_t, uint64_t
 #include <memory>  // std::shared_ptr
-#include <string>  // std::string
+#include <span>
+#include <string> // std::string
 #include <string_view>
-#include <unordered_map> // std::unordered_map
-#include <vector>        // std::vector
+#include <unordered_map>
+#include <vector> // std::vector
 
-#include "glm/ext/vector_int2.hpp"  // glm::ivec2
-#include "glm/ext/vector_uint2.hpp" // glm::uvec2
+#include "glm/ext/vector_float2.hpp" // glm::vec2
+#include "glm/ext/vector_int2.hpp"   // glm::ivec2
+#include "glm/ext/vector_uint2.hpp"  // glm::uvec2
 #include "ruc/format/format.h"
 
 #include "inferno/asset/asset-manager.h"
+#include "inferno/io/file-system.h"
 
 #define PADDING 3
 
+struct stbtt_fontinfo;
+
 namespace Inferno {
 
+class GlyphAtlas;
 class Texture;
 
 struct Symbol {
-	char id;                                          // Symbol
-	glm::uvec2 position;                              // Position
-	glm::uvec2 size;                                  // Width/height
-	glm::ivec2 offset;                                // Offset from baseline to left / top of glyph
-	uint32_t advance;                                 // Amount to advance to next glyph
-	std::unordered_map<unsigned char, char> kernings; // Kernings for symbols that come before this one
+	uint32_t id { 0 };             // Codepoint
+	glm::uvec2 position { 0 };     // Position in the texture, in pixels
+	glm::vec2 size { 0.0f };       // Width/height
+	glm::vec2 offset { 0.0f };     // Offset from baseline to left / top of glyph
+	float advance { 0.0f };        // Amount to advance to next glyph
+	glm::vec2 textureMin { 0.0f }; // Normalized texture coordinates, bottom left
+	glm::vec2 textureMax { 0.0f }; // Normalized texture coordinates, top right
+	bool defined { false };        // Symbol is part of the font
+};
+
+struct Kerning {
+	uint64_t pair { 0 }; // Previous codepoint in the upper, current in the lower 32 bits
+	float amount { 0.0f };
+};
+
+// Precompiled font (.ifnt), the symbol and kerning tables are stored exactly as
+// they are in memory, so they are used straight from the mapped file
+struct FontHeader {
+	static constexpr const uint32_t magicValue = 0x544e4649; // "IFNT"
+	static constexpr const uint32_t currentVersion = 1;
+
+	uint32_t magic { magicValue };
+	uint32_t version { currentVersion };
+	uint32_t symbolStride { sizeof(Symbol) }; // Files from a build with a different layout are rejected
+	uint32_t kerningStride { sizeof(Kerning) };
+	uint32_t size { 0 };
+	uint32_t lineSpacing { 0 };
+	uint32_t symbolCount { 0 }; // Indexed by codepoint
+	uint32_t symbolOffset { 0 };
+	uint32_t kerningCount { 0 }; // Sorted on pair
+	uint32_t kerningOffset { 0 };
+	uint32_t atlasOffset { 0 }; // PNG image, or its file name next to the font
+	uint32_t atlasSize { 0 };
+	uint32_t atlasEmbedded { 0 };
 };
 
 // -------------------------------------
 
+// Loads either a pre-baked BMFont (path without extension, .ifnt or .fnt + .png)
+// or a TrueType/OpenType font (.ttf/.otf), whose glyphs are rasterized as signed
+// distance fields into a glyph atlas the first time they are requested
 class Font final : public Asset {
 public:
-	virtual ~Font() {}
+	static constexpr const uint32_t sdfPixelHeight = 48; // Glyph height in the atlas
+	static constexpr const uint32_t sdfPadding = 6;      // Distance field spread, in pixels
+	static constexpr const uint32_t atlasSize = 1024;
+
+	virtual ~Font();
 
 	// Factory function
 	static std::shared_ptr<Font> create(std::string_view path);
 
+	// Convert a BMFont to the precompiled format, written to path + ".ifnt"
+	static bool cook(std::string_view path, bool embedAtlas = false);
+
 	enum Padding {
 		Top = 0,
 		Right,
@@ -55,16 +99,35 @@ public:
 	inline uint32_t lineSpacing() const { return m_lineSpacing; }
 	inline std::shared_ptr<Texture> texture() const { return m_texture; }
 
-	inline std::shared_ptr<Symbol> get(unsigned char c) const { return m_symbolList.at(c); }
-	inline std::shared_ptr<Symbol> operator[](unsigned char c) const { return m_symbolList.at(c); }
+	// Returns nullptr if the font has no symbol for this codepoint
+	const Symbol* get(uint32_t codepoint);
+	inline const Symbol* operator[](uint32_t codepoint) { return get(codepoint); }
+
+	float kerning(uint32_t previous, uint32_t current) const;
+
+	// Changes when glyphs are evicted from the atlas
+	uint32_t generation() const;
+	// Returns true if one of the glyphs has been evicted from the atlas after the
+	// given generation, which invalidates the texture coordinates taken from it
+	bool evicted(std::span<const uint32_t> codepoints, uint32_t generation) const;
+	// Mark the glyphs as used this frame, for text that is drawn without get()
+	void touch(std::span<const uint32_t> codepoints);
+	// Upload the glyphs rasterized this frame
+	virtual void upload() override;
+
+	virtual size_t cpuSize() const override;
+	virtual size_t gpuSize() const override;
 
 private:
-	Font(std::string_view path)
-		: Asset(path)
-	{
-	}
+	Font(std::string_view path);
+
+	void loadBMFont();
+	bool loadBinary();
+	void loadTrueType();
+	bool rasterize(Symbol& symbol);
 
 	void parseFont(const std::string& font);
+	void calculateTextureCoordinates(float textureWidth, float textureHeight);
 	std::string findAction(const std::string& line) const;
 	std::vector<std::string> findColumns(const std::string& line) const;
 	std::string findValue(const std::string& key, const std::vector<std::string>& columns) const;
@@ -76,7 +139,20 @@ private:
 	uint32_t m_lineSpacing = { 0 };
 	std::array<uint32_t, 4> m_padding = { 0 };
 	std::shared_ptr<Texture> m_texture;
-	std::unordered_map<unsigned char, std::shared_ptr<Symbol>> m_symbolList;
+	std::span<const Symbol> m_symbols;   // Indexed by codepoint
+	std::span<const Kerning> m_kernings; // Sorted on pair
+
+	// Backing memory of the tables, parsed from text or mapped from a binary file
+	std::vector<Symbol> m_symbolStorage;
+	std::vector<Kerning> m_kerningStorage;
+	FileData m_file; // Precompiled font, or the TrueType font data
+
+	// TrueType
+	float m_scale { 0.0f }; // Font units to atlas pixels
+	float m_ascent { 0.0f };
+	std::unique_ptr<stbtt_fontinfo> m_info;
+	std::unique_ptr<GlyphAtlas> m_atlas;
+	std::unordered_map<uint32_t, Symbol> m_glyphs; // Rasterized on demand, pointers stay valid
 };
 
 // -----------------------------------------
@@ -97,6 +173,3 @@ struct ruc::format::Formatter<glm::ivec2> : Formatter<std::vector<int32_t>> {
 // Font f = fm.load("path/to/font");
 // Font f2("path/to/font");
 // Symbol c = f['a'];
-
-// Look into using signed distance fields for texture map generation ? anti-aliasing for text
-// https://youtu.be/d8cfgcJR9Tk
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::copy_n, std::fill_n, std::max, std::min
+#include <cstdint>   // int32_t, uint32_t
+
+#include "glad/glad.h"
+#include "ruc/meta/assert.h"
+
+#include "inferno/asset/glyph-atlas.h"
+#include "inferno/asset/texture.h"
+
+namespace Inferno {
+
+// Empty space kept between glyphs, so linear filtering does not bleed into neighbours
+static constexpr const uint32_t gutter = 1;
+
+GlyphAtlas::GlyphAtlas(uint32_t width, uint32_t height)
+	: m_width(width)
+	, m_height(height)
+	, m_pixels(width * height, 0)
+{
+	m_texture = Texture2D::create("glyph-atlas", width, height, GL_R8, GL_RED);
+
+	// The font shader reads the distance from the alpha channel
+	int32_t swizzle[4] = { GL_ONE, GL_ONE, GL_ONE, GL_RED };
+	glTextureParameteriv(m_texture->id(), GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	// Clear the storage, it is undefined until the first upload
+	m_dirty = { 0, 0, width, height };
+	upload();
+}
+
+const AtlasRect* GlyphAtlas::find(uint32_t codepoint)
+{
+	auto it = m_glyphs.find(codepoint);
+	if (it == m_glyphs.end()) {
+		return nullptr;
+	}
+
+	Glyph& glyph = it->second;
+	glyph.lastUsed = m_frame;
+	m_lru.splice(m_lru.begin(), m_lru, glyph.position);
+
+	return &glyph.rect;
+}
+
+const AtlasRect* GlyphAtlas::insert(uint32_t codepoint, uint32_t width, uint32_t height, const unsigned char* pixels)
+{
+	VERIFY(!m_glyphs.contains(codepoint), "glyph already in atlas: {}", codepoint);
+
+	AtlasRect slot;
+	if (!allocate(width + gutter, height + gutter, slot) && !evict(width + gutter, height + gutter, slot)) {
+		return nullptr;
+	}
+
+	// Copy the bitmap into the CPU copy of the atlas, clearing what an evicted glyph left behind
+	for (uint32_t row = 0; row < slot.height; ++row) {
+		std::fill_n(m_pixels.data() + (slot.y + row) * m_width + slot.x, slot.width, 0);
+	}
+	for (uint32_t row = 0; row < height; ++row) {
+		std::copy_n(pixels + row * width, width, m_pixels.data() + (slot.y + row) * m_width + slot.x);
+	}
+
+	// Grow the dirty rect to include the glyph
+	if (m_dirty.width == 0) {
+		m_dirty = slot;
+	}
+	else {
+		uint32_t right = std::max(m_dirty.x + m_dirty.width, slot.x + slot.width);
+		uint32_t bottom = std::max(m_dirty.y + m_dirty.height, slot.y + slot.height);
+		m_dirty.x = std::min(m_dirty.x, slot.x);
+		m_dirty.y = std::min(m_dirty.y, slot.y);
+		m_dirty.width = right - m_dirty.x;
+		m_dirty.height = bottom - m_dirty.y;
+	}
+
+	m_lru.push_front(codepoint);
+	Glyph& glyph = m_glyphs[codepoint];
+	glyph.rect = { slot.x, slot.y, width, height };
+	glyph.slot = slot;
+	glyph.position = m_lru.begin();
+	glyph.lastUsed = m_frame;
+
+	return &glyph.rect;
+}
+
+bool GlyphAtlas::evicted(uint32_t codepoint, uint32_t generation) const
+{
+	auto it = m_evictions.find(codepoint);
+	return it != m_evictions.end() && it->second > generation;
+}
+
+void GlyphAtlas::upload()
+{
+	if (m_dirty.width > 0 && m_dirty.height > 0) {
+		const unsigned char* data = m_pixels.data() + m_dirty.y * m_width + m_dirty.x;
+		m_texture->update(m_dirty.x, m_dirty.y, m_dirty.width, m_dirty.height, m_width, data);
+		m_dirty = {};
+	}
+
+	m_frame++;
+}
+
+// -----------------------------------------
+
+bool GlyphAtlas::allocate(uint32_t width, uint32_t height, AtlasRect& slot)
+{
+	if (width > m_width || height > m_height) {
+		return false;
+	}
+
+	// Pick the lowest shelf the glyph fits on, without wasting too much height
+	Shelf* best = nullptr;
+	for (auto& shelf : m_shelves) {
+		if (shelf.height < height || shelf.height > height * 3 / 2 || shelf.x + width > m_width) {
+			continue;
+		}
+		if (best == nullptr || shelf.height < best->height) {
+			best = &shelf;
+		}
+	}
+
+	// Open a new shelf
+	if (best == nullptr) {
+		if (m_shelvesHeight + height > m_height) {
+			return false;
+		}
+		m_shelves.push_back({ .y = m_shelvesHeight, .height = height, .x = 0 });
+		m_shelvesHeight += height;
+		best = &m_shelves.back();
+	}
+
+	slot = { best->x, best->y, width, best->height };
+	best->x += width;
+
+	return true;
+}
+
+bool GlyphAtlas::evict(uint32_t width, uint32_t height, AtlasRect& slot)
+{
+	// Walk from the least recently used glyph, glyphs used this frame are still being drawn
+	for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+		auto glyph = m_glyphs.find(*it);
+		if (glyph->second.lastUsed == m_frame) {
+			break;
+		}
+		if (glyph->second.slot.width < width || glyph->second.slot.height < height) {
+			continue;
+		}
+
+		slot = glyph->second.slot;
+		m_generation++;
+		m_evictions[glyph->first] = m_generation;
+		m_lru.erase(glyph->second.position);
+		m_glyphs.erase(glyph);
+
+		return true;
+	}
+
+	return false;
+}
+
+} // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+GlyphAtlas atlas(1024, 1024);
+const AtlasRect* rect = atlas.find(codepoint);
+if (!rect) {
+	rect = atlas.insert(codepoint, width, height, bitmap);
+}
+atlas.upload(); // Once per frame
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint32_t, uint64_t
+#include <list>
+#include <memory> // std::shared_ptr
+#include <unordered_map>
+#include <vector>
+
+namespace Inferno {
+
+class Texture2D;
+
+struct AtlasRect {
+	uint32_t x { 0 };
+	uint32_t y { 0 };
+	uint32_t width { 0 };
+	uint32_t height { 0 };
+};
+
+// Fixed-size single channel texture that glyphs are rasterized into on demand.
+// Glyphs are packed on shelves, once the atlas is full the least recently used
+// glyph that is big enough is replaced. Writes go to a CPU copy of the atlas and
+// are uploaded once per frame, as a single rectangle.
+class GlyphAtlas final {
+public:
+	GlyphAtlas(uint32_t width, uint32_t height);
+	~GlyphAtlas() = default;
+
+	// Returns the glyph rect and marks it as used, or nullptr if it is not in the atlas
+	const AtlasRect* find(uint32_t codepoint);
+	// Copy a glyph bitmap into the atlas, returns nullptr if there is no room left
+	const AtlasRect* insert(uint32_t codepoint, uint32_t width, uint32_t height, const unsigned char* pixels);
+
+	// Upload the changes of this frame
+	void upload();
+
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+	// Changes whenever a glyph is evicted
+	uint32_t generation() const { return m_generation; }
+	// Returns true if the glyph has been evicted after the given generation, which
+	// invalidates texture coordinates that were taken from it back then
+	bool evicted(uint32_t codepoint, uint32_t generation) const;
+	std::shared_ptr<Texture2D> texture() const { return m_texture; }
+
+private:
+	struct Shelf {
+		uint32_t y { 0 };
+		uint32_t height { 0 };
+		uint32_t x { 0 }; // Next free column
+	};
+
+	struct Glyph {
+		AtlasRect rect;                         // Area the glyph occupies
+		AtlasRect slot;                         // Area reserved for the glyph, reused on eviction
+		std::list<uint32_t>::iterator position; // Position in the LRU list
+		uint64_t lastUsed { 0 };
+	};
+
+	bool allocate(uint32_t width, uint32_t height, AtlasRect& slot);
+	bool evict(uint32_t width, uint32_t height, AtlasRect& slot);
+
+	uint32_t m_width { 0 };
+	uint32_t m_height { 0 };
+	uint32_t m_generation { 0 };
+	uint64_t m_frame { 1 };
+
+	std::vector<Shelf> m_shelves;
+	uint32_t m_shelvesHeight { 0 };
+
+	std::unordered_map<uint32_t, Glyph> m_glyphs;
+	std::list<uint32_t> m_lru; // Most recently used codepoint in front
+	std::unordered_map<uint32_t, uint32_t> m_evictions; // Codepoint -> generation it was last evicted in
+
+	std::vector<unsigned char> m_pixels;
+	AtlasRect m_dirty;
+	std::shared_ptr<Texture2D> m_texture;
+};
+
+} // namespace Inferno
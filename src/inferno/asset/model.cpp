@@ -4,95 +4,607 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <cstdint> // uint32_t
-#include <memory>  // std::shared_ptr
+#include <algorithm> // std::max, std::min
+#include <cstddef>   // size_t
+#include <cstdint>   // uint32_t
+#include <cstring>   // std::memcpy
+#include <fstream>   // std::ofstream
+#include <ios>       // std::ios, std::streamsize
+#include <memory>    // std::shared_ptr
+#include <string>    // std::to_string
+#include <unordered_map>
+#include <utility> // std::move
 
+#include "assimp/IOStream.hpp"
+#include "assimp/IOSystem.hpp"
 #include "assimp/Importer.hpp"
+#include "assimp/material.h"
 #include "assimp/mesh.h"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 #include "assimp/texture.h"
+#include "glm/common.hpp"               // glm::max, glm::min
+#include "glm/ext/matrix_float3x3.hpp"  // glm::mat3
+#include "glm/ext/matrix_float4x4.hpp"  // glm::mat4
+#include "glm/ext/matrix_transform.hpp" // glm::scale
+#include "glm/ext/vector_float4.hpp"    // glm::vec4
+#include "glm/geometric.hpp"            // glm::normalize
+#include "ruc/format/log.h"
+#include "ruc/json/json.h"
 
 #include "inferno/asset/model.h"
 #include "inferno/asset/texture.h"
+#include "inferno/io/file-system.h"
+#include "inferno/io/gltffile.h"
+#include "inferno/render/buffer.h"
+#include "inferno/render/renderer.h"
 
 namespace Inferno {
 
+// Lets assimp read the model, and the files it references, through the virtual file layer
+class ModelStream final : public Assimp::IOStream {
+public:
+	ModelStream(FileData file)
+		: m_file(std::move(file))
+	{
+	}
+
+	virtual size_t Read(void* buffer, size_t size, size_t count) override
+	{
+		if (size == 0) {
+			return 0;
+		}
+		count = std::min(count, (m_file.size() - m_position) / size);
+		std::memcpy(buffer, m_file.data() + m_position, size * count);
+		m_position += size * count;
+		return count;
+	}
+	virtual size_t Write(const void*, size_t, size_t) override { return 0; }
+	virtual aiReturn Seek(size_t offset, aiOrigin origin) override
+	{
+		size_t position = origin == aiOrigin_SET ? offset
+		                  : origin == aiOrigin_CUR ? m_position + offset
+		                                           : m_file.size() + offset;
+		if (position > m_file.size()) {
+			return aiReturn_FAILURE;
+		}
+		m_position = position;
+		return aiReturn_SUCCESS;
+	}
+	virtual size_t Tell() const override { return m_position; }
+	virtual size_t FileSize() const override { return m_file.size(); }
+	virtual void Flush() override {}
+
+private:
+	FileData m_file;
+	size_t m_position { 0 };
+};
+
+class ModelFileSystem final : public Assimp::IOSystem {
+public:
+	virtual bool Exists(const char* path) const override { return FileSystem::the().exists(path); }
+	virtual char getOsSeparator() const override { return '/'; }
+	virtual Assimp::IOStream* Open(const char* path, const char* mode) override
+	{
+		// Read-only
+		if (mode[0] != 'r') {
+			return nullptr;
+		}
+		auto file = FileSystem::the().read(path);
+		return file.valid() ? new ModelStream(std::move(file)) : nullptr;
+	}
+	virtual void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+// -----------------------------------------
+
 std::shared_ptr<Model> Model::create(std::string_view path)
+{
+	auto result = createAsync(path);
+
+	result->decode();
+	result->upload();
+	result->setReady();
+
+	return result;
+}
+
+std::shared_ptr<Model> Model::createAsync(std::string_view path)
 {
 	auto result = std::shared_ptr<Model>(new Model(path));
+	result->m_ready = false;
+
+	return result;
+}
+
+bool Model::cook(std::string_view path)
+{
+	Model model(path);
+	model.importSource();
+	model.calculateBounds();
+
+	std::string output = model.m_path + ".imesh";
+
+	// The parts are assets of their own, which the baked file has no room for. Only the
+	// header is written, so the model is not cooked again until its inputs change
+	if (!model.m_instancing.empty()) {
+		MeshHeader header;
+		header.sourceOnly = 1;
+		std::ofstream file(output, std::ios::binary | std::ios::trunc);
+		if (!file.write(reinterpret_cast<const char*>(&header), sizeof(MeshHeader))) {
+			ruc::error("Model could not write: '{}'", output);
+			return false;
+		}
+
+		ruc::warn("Model has instanced parts, loaded from its source instead: '{}'", path);
+		return true;
+	}
+
+	auto align = [](uint32_t offset) { return (offset + MeshHeader::alignment - 1) & ~(MeshHeader::alignment - 1); };
+
+	MeshHeader header;
+	header.boundsMin[0] = model.m_boundsMin.x;
+	header.boundsMin[1] = model.m_boundsMin.y;
+	header.boundsMin[2] = model.m_boundsMin.z;
+	header.boundsMax[0] = model.m_boundsMax.x;
+	header.boundsMax[1] = model.m_boundsMax.y;
+	header.boundsMax[2] = model.m_boundsMax.z;
+	header.submeshCount = static_cast<uint32_t>(model.m_submeshes.size());
+	header.submeshOffset = align(sizeof(MeshHeader));
+	header.vertexCount = model.m_vertexCount;
+	header.vertexOffset = align(header.submeshOffset + header.submeshCount * sizeof(Submesh));
+	header.elementCount = model.m_elementCount;
+	header.elementOffset = align(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+	header.materialCount = static_cast<uint32_t>(model.m_materials.size());
+	header.materialOffset = align(header.elementOffset + header.elementCount * sizeof(uint32_t));
+	header.textureCount = static_cast<uint32_t>(model.m_textures.size());
+	header.textureOffset = align(header.materialOffset + header.materialCount * sizeof(Material));
+
+	// Image files are cooked by their own build job, the textures only in the source are cooked here
+	std::vector<MeshTexture> textures(header.textureCount);
+	std::vector<std::vector<uint8_t>> cooked(header.textureCount);
+	uint32_t size = align(header.textureOffset + header.textureCount * sizeof(MeshTexture));
+	for (size_t i = 0; i < textures.size(); ++i) {
+		const auto& texture = model.m_textures[i];
+		if (texture->encoded().empty()) {
+			textures[i].pathOffset = size;
+			textures[i].pathSize = static_cast<uint32_t>(texture->path().size());
+			size = align(size + textures[i].pathSize);
+			continue;
+		}
+
+		cooked[i] = Texture2D::cook(texture->encoded());
+		if (cooked[i].empty()) {
+			ruc::error("Model could not cook embedded texture {}: '{}'", i, path);
+			return false;
+		}
+		textures[i].offset = size;
+		textures[i].size = static_cast<uint32_t>(cooked[i].size());
+		size = align(size + textures[i].size);
+	}
+
+	std::vector<char> data(size, 0);
+	std::memcpy(data.data(), &header, sizeof(MeshHeader));
+	std::memcpy(data.data() + header.submeshOffset, model.m_submeshes.data(), header.submeshCount * sizeof(Submesh));
+	std::memcpy(data.data() + header.vertexOffset, model.m_vertices.data(), header.vertexCount * sizeof(Vertex));
+	std::memcpy(data.data() + header.elementOffset, model.m_elements.data(), header.elementCount * sizeof(uint32_t));
+	std::memcpy(data.data() + header.materialOffset, model.m_materials.data(), header.materialCount * sizeof(Material));
+	std::memcpy(data.data() + header.textureOffset, textures.data(), header.textureCount * sizeof(MeshTexture));
+	for (size_t i = 0; i < textures.size(); ++i) {
+		std::memcpy(data.data() + textures[i].pathOffset, model.m_textures[i]->path().data(), textures[i].pathSize);
+		std::memcpy(data.data() + textures[i].offset, cooked[i].data(), textures[i].size);
+	}
+
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	if (!file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+		ruc::error("Model could not write: '{}'", output);
+		return false;
+	}
+
+	ruc::info("Model cooked: '{}', {} vertices, {} elements, {} submeshes, {} materials",
+	          output, header.vertexCount, header.elementCount, header.submeshCount, header.materialCount);
+	return true;
+}
+
+void Model::decode()
+{
+	// Prefer the baked version written by the cook step
+	if (decodeBaked()) {
+		return;
+	}
+
+	importSource();
+	calculateBounds();
+	decodeTextures();
+}
+
+void Model::upload()
+{
+	// The parts of a glTF model share its textures
+	for (auto& texture : m_textures) {
+		if (!texture->ready()) {
+			texture->upload();
+			texture->setReady();
+		}
+	}
+
+	// Instanced parts are assets of their own, that the scene places as entities
+	for (auto& part : m_parts) {
+		part->upload();
+		part->setReady();
+		AssetManager::the().add(part->path(), part);
+	}
+	m_parts.clear();
+
+	// Baked geometry is uploaded straight from the mapped file
+	if (m_file.valid()) {
+		if (m_residency != MeshResidency::CPU && !m_fileVertices.empty() && !m_fileElements.empty()) {
+			m_vertexArray = Renderer3D::createMesh(m_fileVertices, m_fileElements);
+			m_depthVertexArray = Renderer3D::createMeshDepth(m_fileVertices, m_vertexArray->indexBuffer());
+		}
+		if (m_residency != MeshResidency::GPU) {
+			m_vertices.assign(m_fileVertices.begin(), m_fileVertices.end());
+			m_elements.assign(m_fileElements.begin(), m_fileElements.end());
+		}
+
+		m_file = {};
+		m_fileVertices = {};
+		m_fileElements = {};
+		return;
+	}
+
+	if (m_residency != MeshResidency::CPU) {
+		uploadMesh();
+	}
+	if (m_residency == MeshResidency::GPU) {
+		m_vertices = {};
+		m_elements = {};
+	}
+}
+
+size_t Model::uploadSize() const
+{
+	size_t meshSize = m_vertexCount * (sizeof(Vertex) + sizeof(glm::vec3)) + m_elementCount * sizeof(uint32_t);
+	size_t partSize = 0;
+	for (const auto& part : m_parts) {
+		partSize += part->uploadSize();
+	}
+	size_t textureSize = 0;
+	for (const auto& texture : m_textures) {
+		textureSize += texture->uploadSize();
+	}
+	return textureSize + (m_residency != MeshResidency::CPU ? meshSize : 0) + partSize;
+}
+
+size_t Model::cpuSize() const
+{
+	// The baked file is mapped, it only takes memory for the pages that are read
+	return m_vertices.capacity() * sizeof(Vertex) + m_elements.capacity() * sizeof(uint32_t);
+}
+
+size_t Model::gpuSize() const
+{
+	// CPU meshes are copied into the batch buffers of the renderer when drawn
+	size_t meshSize = m_vertexArray ? m_vertexCount * (sizeof(Vertex) + sizeof(glm::vec3)) + m_elementCount * sizeof(uint32_t) : 0;
+	size_t textureSize = 0;
+	for (const auto& texture : m_textures) {
+		textureSize += texture->gpuSize();
+	}
+	return textureSize + meshSize;
+}
+
+size_t Model::sharedSize() const
+{
+	size_t result = 0;
+	for (const auto& texture : m_textures) {
+		result += texture->sharedSize();
+	}
+	return result;
+}
+
+void Model::setResidency(MeshResidency residency)
+{
+	// Not uploaded yet, upload() applies it
+	if (!ready()) {
+		m_residency = residency;
+		return;
+	}
+
+	if (m_vertices.empty() && m_vertexArray && residency != MeshResidency::GPU) {
+		downloadMesh();
+	}
+	if (!m_vertexArray && residency != MeshResidency::CPU) {
+		uploadMesh();
+	}
+
+	if (residency == MeshResidency::GPU) {
+		m_vertices = {};
+		m_elements = {};
+	}
+	if (residency == MeshResidency::CPU) {
+		m_vertexArray = nullptr;
+		m_depthVertexArray = nullptr;
+	}
+
+	m_residency = residency;
+}
+
+void Model::requestResidency(MeshResidency residency)
+{
+	m_residencyRequests |= 1 << static_cast<uint8_t>(residency);
+
+	bool single = (m_residencyRequests & (m_residencyRequests - 1)) == 0;
+	MeshResidency merged = single ? residency : MeshResidency::CPUAndGPU;
+	if (merged != m_residency) {
+		setResidency(merged);
+	}
+}
+
+// -----------------------------------------
+
+bool Model::decodeBaked()
+{
+	auto file = FileSystem::the().read(m_path.ends_with(".imesh") ? m_path : m_path + ".imesh");
+	if (!file.valid() || file.size() < sizeof(MeshHeader)) {
+		return false;
+	}
+
+	const MeshHeader& header = file.span<MeshHeader>(0, 1).front();
+	MeshHeader current;
+	if (header.magic != current.magic || header.version != current.version
+	    || header.vertexStride != current.vertexStride || header.submeshStride != current.submeshStride
+	    || header.materialStride != current.materialStride) {
+		ruc::warn("Model baked file is outdated, importing the source instead: '{}'", m_path);
+		return false;
+	}
+	if (header.sourceOnly) {
+		return false;
+	}
+
+	auto submeshes = file.span<Submesh>(header.submeshOffset, header.submeshCount);
+	m_submeshes.assign(submeshes.begin(), submeshes.end());
+	auto materials = file.span<Material>(header.materialOffset, header.materialCount);
+	m_materials.assign(materials.begin(), materials.end());
+
+	m_file = file;
+	m_fileVertices = file.span<Vertex>(header.vertexOffset, header.vertexCount);
+	m_fileElements = file.span<uint32_t>(header.elementOffset, header.elementCount);
+	m_vertexCount = header.vertexCount;
+	m_elementCount = header.elementCount;
+	m_boundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+	m_boundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+
+	// Decoded here on the loader thread, uploaded together with the model
+	for (const auto& texture : file.span<MeshTexture>(header.textureOffset, header.textureCount)) {
+		if (texture.pathSize > 0) {
+			m_textures.push_back(Texture2D::createAsync(file.string().substr(texture.pathOffset, texture.pathSize)));
+		}
+		else {
+			auto path = m_path + "#texture" + std::to_string(m_textures.size());
+			m_textures.push_back(Texture2D::createAsync(path, file.slice(texture.offset, texture.size)));
+		}
+		m_textures.back()->decode();
+	}
+
+	return true;
+}
+
+void Model::importSource()
+{
+	// Files that use glTF features the native reader doesnt support go through assimp
+	if ((m_path.ends_with(".gltf") || m_path.ends_with(".glb")) && decodeGltf()) {
+		return;
+	}
 
 	Assimp::Importer importer; // importer destructor uses RAII cleanup
 	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	importer.SetIOHandler(new ModelFileSystem); // Owned by the importer
 	const aiScene* scene = importer.ReadFile(
-		path.data(),
+		m_path.c_str(),
 		aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
 
 	VERIFY(scene != nullptr && (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) == 0 && scene->mRootNode != nullptr,
 	       "assimp loading file failed: {}", importer.GetErrorString());
 
-	processScene(result, scene);
-	processNode(result, scene->mRootNode, scene);
+	processScene(scene);
+	processNode(scene->mRootNode, scene);
+}
 
-	return result;
+void Model::decodeTextures()
+{
+	// Decoded here on the loader thread, uploaded together with the model
+	for (auto& texture : m_textures) {
+		texture->decode();
+	}
 }
 
-void Model::processScene(std::shared_ptr<Model> model, const aiScene* scene)
+void Model::processScene(const aiScene* scene)
 {
 	VERIFY(scene->HasMeshes(), "malformed model");
-	VERIFY(scene->mNumTextures < 2, "unsupported model type: {}/1", scene->mNumTextures);
 
-	if (scene->mNumTextures == 1) {
-		aiTexture* texture = scene->mTextures[0];
-		model->m_texture = Texture2D::create(texture);
+	// Materials that use the same image share its texture
+	std::unordered_map<std::string, int32_t> textures;
+	for (uint32_t i = 0; i < scene->mNumMaterials; ++i) {
+		processMaterial(scene->mMaterials[i], scene, textures);
+	}
+	if (m_materials.empty()) {
+		m_materials.push_back({});
+	}
+
+	// A single embedded texture that no material references is used by all of them
+	if (m_textures.empty() && scene->mNumTextures == 1) {
+		m_textures.push_back(Texture2D::createAsync(scene->mTextures[0]));
+		for (auto& material : m_materials) {
+			material.texture = 0;
+		}
 	}
 }
 
-void Model::processNode(std::shared_ptr<Model> model, aiNode* node, const aiScene* scene)
+void Model::processMaterial(aiMaterial* material, const aiScene* scene, std::unordered_map<std::string, int32_t>& textures)
+{
+	Material result;
+
+	aiColor4D color;
+	if (material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == aiReturn_SUCCESS) {
+		result.color = { color.r, color.g, color.b, color.a };
+	}
+
+	aiString path;
+	if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) != aiReturn_SUCCESS) {
+		m_materials.push_back(result);
+		return;
+	}
+
+	if (auto it = textures.find(path.C_Str()); it != textures.end()) {
+		result.texture = it->second;
+		m_materials.push_back(result);
+		return;
+	}
+
+	// Embedded in the model, or a file relative to it
+	std::shared_ptr<Texture2D> texture;
+	if (const aiTexture* embedded = scene->GetEmbeddedTexture(path.C_Str())) {
+		texture = Texture2D::createAsync(embedded);
+	}
+	else {
+		// Loaded through its cooked .ktx2, if there is one
+		std::string file = m_path.substr(0, m_path.find_last_of('/') + 1) + path.C_Str();
+		if (FileSystem::the().exists(file) || FileSystem::the().exists(file + ".ktx2")) {
+			texture = Texture2D::createAsync(file);
+		}
+		else {
+			ruc::warn("Model could not read texture: '{}'", file);
+		}
+	}
+
+	if (texture) {
+		result.texture = static_cast<int32_t>(m_textures.size());
+		m_textures.push_back(std::move(texture));
+		textures.emplace(path.C_Str(), result.texture);
+	}
+	m_materials.push_back(result);
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene)
 {
 	for (uint32_t i = 0; i < node->mNumMeshes; ++i) {
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		processMesh(model, mesh, scene, node->mTransformation);
+		processMesh(mesh, scene, node->mTransformation);
 	}
 
 	for (uint32_t i = 0; i < node->mNumChildren; ++i) {
-		processNode(model, node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene);
+	}
+}
+
+void Model::calculateBounds()
+{
+	if (!m_vertices.empty()) {
+		m_boundsMin = m_boundsMax = m_vertices[0].position;
+		for (const auto& vertex : m_vertices) {
+			m_boundsMin = glm::min(m_boundsMin, vertex.position);
+			m_boundsMax = glm::max(m_boundsMax, vertex.position);
+		}
+	}
+
+	m_vertexCount = m_vertices.size();
+	m_elementCount = m_elements.size();
+}
+
+void Model::addSubmesh(size_t vertexOffset, size_t elementOffset, uint32_t material)
+{
+	Submesh submesh;
+	submesh.vertexOffset = static_cast<uint32_t>(vertexOffset);
+	submesh.vertexCount = static_cast<uint32_t>(m_vertices.size() - vertexOffset);
+	submesh.elementOffset = static_cast<uint32_t>(elementOffset);
+	submesh.elementCount = static_cast<uint32_t>(m_elements.size() - elementOffset);
+	submesh.material = material;
+
+	if (submesh.vertexCount > 0) {
+		submesh.boundsMin = submesh.boundsMax = m_vertices[vertexOffset].position;
+		for (size_t i = vertexOffset; i < m_vertices.size(); ++i) {
+			submesh.boundsMin = glm::min(submesh.boundsMin, m_vertices[i].position);
+			submesh.boundsMax = glm::max(submesh.boundsMax, m_vertices[i].position);
+		}
+	}
+
+	m_submeshes.push_back(submesh);
+}
+
+void Model::generateNormals(size_t vertexOffset, size_t elementOffset)
+{
+	for (size_t i = vertexOffset; i < m_vertices.size(); ++i) {
+		m_vertices[i].normal = glm::vec3(0.0f);
+	}
+
+	// The cross product is as long as twice the area of the triangle
+	for (size_t i = elementOffset; i + 2 < m_elements.size(); i += 3) {
+		Vertex& a = m_vertices[m_elements[i]];
+		Vertex& b = m_vertices[m_elements[i + 1]];
+		Vertex& c = m_vertices[m_elements[i + 2]];
+		glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+		a.normal += normal;
+		b.normal += normal;
+		c.normal += normal;
+	}
+
+	for (size_t i = vertexOffset; i < m_vertices.size(); ++i) {
+		float length = glm::length(m_vertices[i].normal);
+		m_vertices[i].normal = length > 0.0f ? m_vertices[i].normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+}
+
+void Model::uploadMesh()
+{
+	if (m_vertices.empty() || m_elements.empty()) {
+		return;
 	}
+
+	m_vertexArray = Renderer3D::createMesh(m_vertices, m_elements);
+	m_depthVertexArray = Renderer3D::createMeshDepth(m_vertices, m_vertexArray->indexBuffer());
+}
+
+void Model::downloadMesh()
+{
+	m_vertices.resize(m_vertexCount);
+	m_elements.resize(m_elementCount);
+	m_vertexArray->at(0)->downloadData(m_vertices.data(), m_vertexCount * sizeof(Vertex));
+	m_vertexArray->indexBuffer()->downloadData(m_elements.data(), m_elementCount * sizeof(uint32_t));
 }
 
-void Model::processMesh(std::shared_ptr<Model> model, aiMesh* mesh, const aiScene* scene, aiMatrix4x4 parentTransform)
+void Model::processMesh(aiMesh* mesh, const aiScene* scene, aiMatrix4x4 parentTransform)
 {
 	VERIFY(mesh->HasPositions(), "malformed model");
 	VERIFY(mesh->HasNormals(), "malformed model");
 
 	// Pre-allocate memory
-	size_t startIndex = model->m_vertices.size();
-	model->m_vertices.resize(startIndex + mesh->mNumVertices);
+	size_t startIndex = m_vertices.size();
+	m_vertices.resize(startIndex + mesh->mNumVertices);
 
 	for (uint32_t i = 0; i < mesh->mNumVertices; ++i) {
 		aiVector3D v = parentTransform * mesh->mVertices[i];
-		model->m_vertices[startIndex + i].position = { v.x, v.y, v.z };
+		m_vertices[startIndex + i].position = { v.x, v.y, v.z };
 	}
 
 	// Size of vertices == size of normals
 	for (uint32_t i = 0; i < mesh->mNumVertices; ++i) {
-		aiVector3D normal = mesh->mNormals[startIndex + i];
-		model->m_vertices[startIndex + i].normal = { normal.x, normal.y, normal.z };
+		aiVector3D normal = mesh->mNormals[i];
+		m_vertices[startIndex + i].normal = { normal.x, normal.y, normal.z };
 	}
 
 	if (mesh->HasTextureCoords(0)) {
 		// Size of vertices == size of texture coordinates
 		for (uint32_t i = 0; i < mesh->mNumVertices; ++i) {
 			aiVector3D tc = mesh->mTextureCoords[0][i];
-			model->m_vertices[startIndex + i].textureCoordinates = { tc.x, tc.y };
+			m_vertices[startIndex + i].textureCoordinates = { tc.x, tc.y };
 		}
 	}
 	// TODO: position in the texture atlas
 
 	if (mesh->HasFaces()) {
 		// Pre-allocate memory
-		size_t startIndex2 = model->m_elements.size();
-		model->m_elements.resize(startIndex2 + (mesh->mNumFaces * 3)); // assuming triangles
+		size_t startIndex2 = m_elements.size();
+		m_elements.resize(startIndex2 + (mesh->mNumFaces * 3)); // assuming triangles
 
 		size_t offset = 0;
 		for (uint32_t i = 0; i < mesh->mNumFaces; ++i) {
@@ -101,10 +613,294 @@ void Model::processMesh(std::shared_ptr<Model> model, aiMesh* mesh, const aiScen
 			for (uint32_t j = 0; j < face.mNumIndices; ++j, ++offset) {
 				// Indices are referenced relative to vertices[0], if there are multiple meshes,
 				// then the indices need to be offset by the total amount of vertices
-				model->m_elements[startIndex2 + (i * 3) + j] = startIndex + face.mIndices[j];
+				m_elements[startIndex2 + (i * 3) + j] = startIndex + face.mIndices[j];
+			}
+		}
+
+		addSubmesh(startIndex, startIndex2, mesh->mMaterialIndex);
+	}
+}
+
+// -----------------------------------------
+
+static size_t jsonIndex(const ruc::Json& json)
+{
+	return static_cast<size_t>(json.asDouble());
+}
+
+// Translation * rotation * scale, rotation is a quaternion stored as x, y, z, w
+static glm::mat4 compose(const float* translation, const float* rotation, const float* scale)
+{
+	float x = rotation[0];
+	float y = rotation[1];
+	float z = rotation[2];
+	float w = rotation[3];
+
+	glm::mat4 result(1.0f);
+	result[0] = { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f };
+	result[1] = { 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f };
+	result[2] = { 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f };
+	result[3] = { translation[0], translation[1], translation[2], 1.0f };
+
+	return glm::scale(result, { scale[0], scale[1], scale[2] });
+}
+
+static glm::mat4 nodeTransform(const ruc::Json& node)
+{
+	if (node.exists("matrix")) {
+		// Column-major, like glm
+		const auto& values = node.at("matrix").asArray();
+		glm::mat4 result(1.0f);
+		for (size_t i = 0; i < 16; ++i) {
+			result[i / 4][i % 4] = static_cast<float>(values.at(i).asDouble());
+		}
+		return result;
+	}
+
+	float trs[10] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+	auto read = [&node](const char* name, float* values, size_t count) {
+		if (node.exists(name)) {
+			for (size_t i = 0; i < count; ++i) {
+				values[i] = static_cast<float>(node.at(name).at(i).asDouble());
 			}
 		}
+	};
+	read("translation", trs, 3);
+	read("rotation", trs + 3, 4);
+	read("scale", trs + 7, 3);
+
+	return compose(trs, trs + 3, trs + 7);
+}
+
+bool Model::decodeGltf()
+{
+	auto gltf = GltfFile::read(m_path);
+	if (!gltf || !gltf->json().exists("meshes")) {
+		ruc::warn("Model could not read glTF natively, importing through assimp: '{}'", m_path);
+		return false;
 	}
+
+	const auto& json = gltf->json();
+
+	processGltfMaterials(*gltf);
+
+	// Only the default scene is loaded, or every root node if there is none
+	if (json.exists("scenes")) {
+		size_t scene = json.exists("scene") ? jsonIndex(json.at("scene")) : 0;
+		const auto& nodes = json.at("scenes").at(scene).at("nodes").asArray();
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			processGltfNode(*gltf, jsonIndex(nodes.at(i)), glm::mat4(1.0f));
+		}
+	}
+	else if (json.exists("nodes")) {
+		// Root nodes are the ones that no node lists as a child
+		const auto& nodes = json.at("nodes").asArray();
+		std::vector<bool> child(nodes.size(), false);
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (nodes.at(i).exists("children")) {
+				const auto& children = nodes.at(i).at("children").asArray();
+				for (size_t j = 0; j < children.size(); ++j) {
+					child[jsonIndex(children.at(j))] = true;
+				}
+			}
+		}
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (!child[i]) {
+				processGltfNode(*gltf, i, glm::mat4(1.0f));
+			}
+		}
+	}
+
+	return true;
+}
+
+void Model::processGltfNode(const GltfFile& gltf, size_t node, const glm::mat4& parentTransform)
+{
+	const auto& json = gltf.json().at("nodes").at(node);
+	glm::mat4 transform = parentTransform * nodeTransform(json);
+
+	if (json.exists("mesh")) {
+		bool instanced = json.exists("extensions") && json.at("extensions").exists("EXT_mesh_gpu_instancing");
+		if (!instanced) {
+			processGltfMesh(gltf, jsonIndex(json.at("mesh")), transform);
+		}
+		else {
+			// The mesh is stored once, as a part that is placed for every instance
+			auto part = std::shared_ptr<Model>(new Model(m_path + "#" + std::to_string(node)));
+			part->m_materials = m_materials;
+			part->m_textures = m_textures;
+			part->processGltfMesh(gltf, jsonIndex(json.at("mesh")), glm::mat4(1.0f));
+			part->calculateBounds();
+
+			const auto& attributes = json.at("extensions").at("EXT_mesh_gpu_instancing").at("attributes");
+			auto accessor = [&](const char* name) {
+				return attributes.exists(name) ? gltf.accessor(jsonIndex(attributes.at(name))) : GltfAccessor {};
+			};
+			GltfAccessor translations = accessor("TRANSLATION");
+			GltfAccessor rotations = accessor("ROTATION");
+			GltfAccessor scales = accessor("SCALE");
+
+			ModelInstancing instancing { part->path(), {} };
+			uint32_t count = std::max({ translations.count, rotations.count, scales.count });
+			for (uint32_t i = 0; i < count; ++i) {
+				float trs[10] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+				if (i < translations.count) {
+					translations.read(i, trs, 3);
+				}
+				if (i < rotations.count) {
+					rotations.read(i, trs + 3, 4);
+				}
+				if (i < scales.count) {
+					scales.read(i, trs + 7, 3);
+				}
+				// Instances are placed relative to the node
+				instancing.transforms.push_back(transform * compose(trs, trs + 3, trs + 7));
+			}
+
+			m_instancing.push_back(std::move(instancing));
+			m_parts.push_back(std::move(part));
+		}
+	}
+
+	if (json.exists("children")) {
+		const auto& children = json.at("children").asArray();
+		for (size_t i = 0; i < children.size(); ++i) {
+			processGltfNode(gltf, jsonIndex(children.at(i)), transform);
+		}
+	}
+}
+
+void Model::processGltfMesh(const GltfFile& gltf, size_t mesh, const glm::mat4& transform)
+{
+	glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(transform)));
+
+	const auto& primitives = gltf.json().at("meshes").at(mesh).at("primitives").asArray();
+	for (size_t i = 0; i < primitives.size(); ++i) {
+		const auto& primitive = primitives.at(i);
+
+		// Only triangle lists, the same as the assimp path that removes points and lines
+		if (primitive.exists("mode") && jsonIndex(primitive.at("mode")) != 4) {
+			continue;
+		}
+
+		const auto& attributes = primitive.at("attributes");
+		VERIFY(attributes.exists("POSITION"), "malformed model");
+
+		// Normals are optional, without them they are generated from the triangles
+		GltfAccessor positions = gltf.accessor(jsonIndex(attributes.at("POSITION")));
+		GltfAccessor normals = attributes.exists("NORMAL") ? gltf.accessor(jsonIndex(attributes.at("NORMAL"))) : GltfAccessor {};
+		VERIFY(normals.count == positions.count || normals.count == 0, "malformed model");
+
+		// Converted straight into the vertex layout of the renderer
+		size_t startIndex = m_vertices.size();
+		m_vertices.resize(startIndex + positions.count);
+		for (uint32_t j = 0; j < positions.count; ++j) {
+			Vertex& vertex = m_vertices[startIndex + j];
+
+			float values[3];
+			positions.read(j, values, 3);
+			vertex.position = glm::vec3(transform * glm::vec4(values[0], values[1], values[2], 1.0f));
+			if (normals.count > 0) {
+				normals.read(j, values, 3);
+				// Same fallback as generateNormals(), a zero-length normal can't be normalized
+				glm::vec3 normal = normalMatrix * glm::vec3(values[0], values[1], values[2]);
+				float length = glm::length(normal);
+				vertex.normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+		}
+
+		if (attributes.exists("TEXCOORD_0")) {
+			GltfAccessor textureCoordinates = gltf.accessor(jsonIndex(attributes.at("TEXCOORD_0")));
+			for (uint32_t j = 0; j < std::min(textureCoordinates.count, positions.count); ++j) {
+				float values[2];
+				textureCoordinates.read(j, values, 2);
+				// glTF has its origin at the top, textures are loaded with the bottom row first
+				m_vertices[startIndex + j].textureCoordinates = { values[0], 1.0f - values[1] };
+			}
+		}
+
+		// Indices are referenced relative to vertices[0], if there are multiple primitives,
+		// then the indices need to be offset by the total amount of vertices
+		size_t startElement = m_elements.size();
+		if (primitive.exists("indices")) {
+			GltfAccessor indices = gltf.accessor(jsonIndex(primitive.at("indices")));
+			m_elements.resize(startElement + indices.count);
+			for (uint32_t j = 0; j < indices.count; ++j) {
+				m_elements[startElement + j] = startIndex + indices.index(j);
+			}
+		}
+		else {
+			m_elements.resize(startElement + positions.count);
+			for (uint32_t j = 0; j < positions.count; ++j) {
+				m_elements[startElement + j] = startIndex + j;
+			}
+		}
+
+		if (normals.count == 0) {
+			generateNormals(startIndex, startElement);
+		}
+
+		// The last material is the default one
+		size_t material = primitive.exists("material") ? jsonIndex(primitive.at("material")) : m_materials.size() - 1;
+		addSubmesh(startIndex, startElement, static_cast<uint32_t>(material));
+	}
+}
+
+void Model::processGltfMaterials(const GltfFile& gltf)
+{
+	const auto& json = gltf.json();
+
+	// Images that are used by multiple materials are decoded once, on their image index
+	std::unordered_map<size_t, int32_t> images;
+	auto texture = [&](size_t image) -> int32_t {
+		if (auto it = images.find(image); it != images.end()) {
+			return it->second;
+		}
+
+		const auto& imageJson = json.at("images").at(image);
+		std::shared_ptr<Texture2D> result;
+		if (imageJson.exists("bufferView")) {
+			result = Texture2D::createAsync(m_path + "#image" + std::to_string(image), gltf.bufferView(jsonIndex(imageJson.at("bufferView"))));
+		}
+		else {
+			// Loaded through its cooked .ktx2, if there is one
+			std::string path = gltf.directory() + imageJson.at("uri").asString();
+			if (!FileSystem::the().exists(path) && !FileSystem::the().exists(path + ".ktx2")) {
+				ruc::warn("Model could not read texture: '{}'", path);
+				return images[image] = -1;
+			}
+			result = Texture2D::createAsync(path);
+		}
+
+		m_textures.push_back(std::move(result));
+		return images[image] = static_cast<int32_t>(m_textures.size() - 1);
+	};
+
+	size_t count = json.exists("materials") ? json.at("materials").asArray().size() : 0;
+	for (size_t i = 0; i < count; ++i) {
+		Material material;
+
+		const auto& materialJson = json.at("materials").at(i);
+		if (materialJson.exists("pbrMetallicRoughness")) {
+			const auto& pbr = materialJson.at("pbrMetallicRoughness");
+			if (pbr.exists("baseColorFactor")) {
+				for (size_t c = 0; c < 4; ++c) {
+					material.color[c] = static_cast<float>(pbr.at("baseColorFactor").at(c).asDouble());
+				}
+			}
+			if (pbr.exists("baseColorTexture")) {
+				const auto& textureJson = json.at("textures").at(jsonIndex(pbr.at("baseColorTexture").at("index")));
+				if (textureJson.exists("source")) {
+					material.texture = texture(jsonIndex(textureJson.at("source")));
+				}
+			}
+		}
+
+		m_materials.push_back(material);
+	}
+
+	// Default material of glTF, for the primitives without one
+	m_materials.push_back({});
 }
 
 } // namespace Inferno
@@ -6,19 +6,101 @@
 
 #pragma once
 
-#include <cstdint> // uint32_t
+#include <cstddef> // size_t
+#include <cstdint> // int32_t, uint8_t, uint32_t
 #include <memory>
 #include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "assimp/scene.h"
+#include "glm/ext/matrix_float4x4.hpp" // glm::mat4
+#include "glm/ext/vector_float3.hpp"   // glm::vec3
+#include "glm/ext/vector_float4.hpp"   // glm::vec4
+#include "glm/geometric.hpp"           // glm::length
 
 #include "inferno/asset/asset-manager.h"
+#include "inferno/io/file-system.h"
 #include "inferno/render/renderer.h"
 
 namespace Inferno {
 
+class GltfFile;
 class Texture2D;
+class VertexArray;
+
+// Where the geometry of a model is kept
+enum class MeshResidency : uint8_t {
+	GPU,       // Drawn from its own buffers, the CPU copy is freed after upload
+	CPUAndGPU, // Drawn from its own buffers, the CPU copy is kept for reading
+	CPU,       // Copied into the batch every frame, for meshes that change
+};
+
+// Surface of a submesh
+struct Material {
+	glm::vec4 color { 1.0f }; // Base color, multiplied with the texture
+	int32_t texture { -1 };   // Into the textures of the model, -1 if it has none
+};
+
+// Part of the merged vertices and elements that came from one mesh of the source
+// file, drawn and culled on its own. The elements index into all the vertices
+struct Submesh {
+	uint32_t vertexOffset { 0 };
+	uint32_t vertexCount { 0 };
+	uint32_t elementOffset { 0 };
+	uint32_t elementCount { 0 };
+	uint32_t material { 0 };      // Into the materials of the model
+	glm::vec3 boundsMin { 0.0f }; // In model space
+	glm::vec3 boundsMax { 0.0f };
+
+	// Bounding sphere around the vertices, in model space
+	glm::vec3 center() const { return (boundsMin + boundsMax) * 0.5f; }
+	float radius() const { return glm::length(boundsMax - boundsMin) * 0.5f; }
+};
+
+// Texture of a baked model. Image files are referenced by path, and loaded through
+// their own cooked .ktx2. Images that only exist inside the source are embedded, cooked
+struct MeshTexture {
+	uint32_t pathOffset { 0 };
+	uint32_t pathSize { 0 }; // 0 if the texture is embedded
+	uint32_t offset { 0 };   // Embedded KTX2 file
+	uint32_t size { 0 };
+};
+
+// Baked model (.imesh), the vertices and elements are stored in the final layout
+// of the renderer, so they are uploaded straight from the mapped file
+struct MeshHeader {
+	static constexpr const uint32_t magicValue = 0x48534d49; // "IMSH"
+	static constexpr const uint32_t currentVersion = 4;
+	static constexpr const uint32_t alignment = 16; // Of every array in the file
+
+	uint32_t magic { magicValue };
+	uint32_t version { currentVersion };
+	uint32_t vertexStride { sizeof(Vertex) }; // Files from a build with a different layout are rejected
+	uint32_t submeshStride { sizeof(Submesh) };
+	uint32_t materialStride { sizeof(Material) };
+	float boundsMin[3] { 0.0f, 0.0f, 0.0f };
+	float boundsMax[3] { 0.0f, 0.0f, 0.0f };
+	uint32_t submeshCount { 0 };
+	uint32_t submeshOffset { 0 };
+	uint32_t vertexCount { 0 };
+	uint32_t vertexOffset { 0 };
+	uint32_t elementCount { 0 };
+	uint32_t elementOffset { 0 };
+	uint32_t materialCount { 0 };
+	uint32_t materialOffset { 0 };
+	uint32_t textureCount { 0 };
+	uint32_t textureOffset { 0 }; // MeshTexture of every texture, the paths and KTX2 files follow
+	uint32_t sourceOnly { 0 };    // Header without data, the model is loaded from its source
+};
+
+// Copies of a part of the model, placed by the glTF EXT_mesh_gpu_instancing extension
+struct ModelInstancing {
+	std::string path;                  // Of the part, it can be loaded once the model is ready
+	std::vector<glm::mat4> transforms; // In model space
+};
 
 class Model final : public Asset {
 public:
@@ -26,10 +108,41 @@ public:
 
 	// Factory function
 	static std::shared_ptr<Model> create(std::string_view path);
-
+	// Pending model, that is not ready until decode() and upload() have run
+	static std::shared_ptr<Model> createAsync(std::string_view path);
+
+	// Import a model once and write it in the baked format, to path + ".imesh"
+	static bool cook(std::string_view path);
+
+	virtual void decode() override;
+	virtual void upload() override;
+	virtual size_t uploadSize() const override;
+	virtual size_t cpuSize() const override;
+	virtual size_t gpuSize() const override;
+	virtual size_t sharedSize() const override;
+
+	// Main thread, moves the geometry between the CPU and GPU as needed
+	void setResidency(MeshResidency residency);
+	MeshResidency residency() const { return m_residency; }
+	// Main thread, called once per user of the model when it is loaded. When the users
+	// disagree, the geometry is kept on both sides, as CPUAndGPU serves every draw
+	void requestResidency(MeshResidency residency);
+
+	// Empty if the CPU copy was freed
 	std::span<const Vertex> vertices() const { return m_vertices; }
 	std::span<const uint32_t> elements() const { return m_elements; }
-	std::shared_ptr<Texture2D> texture() const { return m_texture; }
+	// nullptr if the model is drawn through the batch
+	std::shared_ptr<VertexArray> vertexArray() const { return m_vertexArray; }
+	// Positions only, sharing the elements of vertexArray()
+	std::shared_ptr<VertexArray> depthVertexArray() const { return m_depthVertexArray; }
+	std::span<const Submesh> submeshes() const { return m_submeshes; }
+	std::span<const Material> materials() const { return m_materials; }
+	// nullptr if the material has no texture
+	Texture2D* texture(const Material& material) const { return material.texture >= 0 ? m_textures[material.texture].get() : nullptr; }
+	std::span<const ModelInstancing> instancing() const { return m_instancing; }
+	// Bounding sphere around the vertices, in model space
+	glm::vec3 center() const { return (m_boundsMin + m_boundsMax) * 0.5f; }
+	float radius() const { return glm::length(m_boundsMax - m_boundsMin) * 0.5f; }
 
 private:
 	Model(std::string_view path)
@@ -37,17 +150,54 @@ private:
 	{
 	}
 
-	static void processScene(std::shared_ptr<Model> model, const aiScene* scene);
-	static void processNode(std::shared_ptr<Model> model, aiNode* node, const aiScene* scene);
-	static void processMesh(std::shared_ptr<Model> model, aiMesh* mesh, const aiScene* scene, aiMatrix4x4 parentTransform = aiMatrix4x4());
+	// Returns false if there is no baked file that can be used as is
+	bool decodeBaked();
+	void importSource();
+	void decodeTextures();
+
+	void processScene(const aiScene* scene);
+	void processMaterial(aiMaterial* material, const aiScene* scene, std::unordered_map<std::string, int32_t>& textures);
+	void processNode(aiNode* node, const aiScene* scene);
+	void processMesh(aiMesh* mesh, const aiScene* scene, aiMatrix4x4 parentTransform = aiMatrix4x4());
+
+	// Native glTF 2.0, read straight out of the mapped file instead of through assimp.
+	// Returns false if the file can't be read this way, before anything is decoded
+	bool decodeGltf();
+	void processGltfNode(const GltfFile& gltf, size_t node, const glm::mat4& parentTransform);
+	void processGltfMesh(const GltfFile& gltf, size_t mesh, const glm::mat4& transform);
+	void processGltfMaterials(const GltfFile& gltf);
+	void calculateBounds();
+	void addSubmesh(size_t vertexOffset, size_t elementOffset, uint32_t material);
+	// Smooth normals of the vertices from vertexOffset on, weighted by the area of their triangles
+	void generateNormals(size_t vertexOffset, size_t elementOffset);
+
+	void uploadMesh();
+	void downloadMesh();
 
 	virtual bool isModel() const override { return true; }
 
 private:
+	MeshResidency m_residency { MeshResidency::GPU };
+	uint8_t m_residencyRequests { 0 }; // Bit per requested MeshResidency
 	std::vector<Vertex> m_vertices;
 	std::vector<uint32_t> m_elements;
-	// Some file formats embed their texture
-	std::shared_ptr<Texture2D> m_texture;
+	std::vector<Submesh> m_submeshes;
+	std::shared_ptr<VertexArray> m_vertexArray;
+	std::shared_ptr<VertexArray> m_depthVertexArray;
+	uint32_t m_vertexCount { 0 };
+	uint32_t m_elementCount { 0 };
+	// Baked vertices and elements, pointing into the file until upload()
+	FileData m_file;
+	std::span<const Vertex> m_fileVertices;
+	std::span<const uint32_t> m_fileElements;
+	// Kept when the CPU copy is freed, for culling
+	glm::vec3 m_boundsMin { 0.0f };
+	glm::vec3 m_boundsMax { 0.0f };
+	std::vector<Material> m_materials;
+	std::vector<std::shared_ptr<Texture2D>> m_textures; // Shared with the parts
+
+	std::vector<ModelInstancing> m_instancing;
+	std::vector<std::shared_ptr<Model>> m_parts; // Until upload()
 };
 
 // clang-format off
@@ -8,11 +8,11 @@
 
 #include "glad/glad.h"
 #include "glm/gtc/type_ptr.hpp" // glm::value_ptr
-#include "ruc/file.h"
 #include "ruc/format/log.h"
 #include "ruc/meta/assert.h"
 
 #include "inferno/asset/shader.h"
+#include "inferno/io/file-system.h"
 
 namespace Inferno {
 
@@ -22,8 +22,20 @@ std::shared_ptr<Shader> Shader::create(std::string_view path)
 
 	// Get file contents
 	auto stringPath = std::string(path);
-	std::string vertexSrc = ruc::File(stringPath + ".vert").data();
-	std::string fragmentSrc = ruc::File(stringPath + ".frag").data();
+
+	// Compute shader, a single stage program
+	if (FileSystem::the().exists(stringPath + ".comp")) {
+		std::string computeSrc(FileSystem::the().read(stringPath + ".comp").string());
+		uint32_t computeID = result->compileShader(GL_COMPUTE_SHADER, computeSrc.c_str());
+		if (computeID > 0) {
+			result->m_id = result->linkShader(computeID);
+		}
+
+		return result;
+	}
+
+	std::string vertexSrc(FileSystem::the().read(stringPath + ".vert").string());
+	std::string fragmentSrc(FileSystem::the().read(stringPath + ".frag").string());
 
 	// Compile shaders
 	uint32_t vertexID = result->compileShader(GL_VERTEX_SHADER, vertexSrc.c_str());
@@ -178,6 +190,25 @@ uint32_t Shader::linkShader(uint32_t vertex, uint32_t fragment) const
 	return 0;
 }
 
+uint32_t Shader::linkShader(uint32_t compute) const
+{
+	// Create new shader program
+	uint32_t shaderProgram = glCreateProgram();
+	glAttachShader(shaderProgram, compute);
+	glLinkProgram(shaderProgram);
+	// Clear resources
+	glDeleteShader(compute);
+
+	// Check linking status
+	if (checkStatus(shaderProgram, true) == GL_TRUE) {
+		return shaderProgram;
+	}
+
+	// On fail
+	glDeleteProgram(shaderProgram);
+	return 0;
+}
+
 int32_t Shader::checkStatus(uint32_t check, bool isProgram) const
 {
 	int32_t success;
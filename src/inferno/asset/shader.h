@@ -20,7 +20,7 @@ class Shader : public Asset {
 public:
 	virtual ~Shader();
 
-	// Factory function
+	// Factory function, path + ".comp" or path + ".vert" and path + ".frag"
 	static std::shared_ptr<Shader> create(std::string_view path);
 
 	uint32_t findUniformLocation(std::string_view name);
@@ -43,6 +43,7 @@ public:
 protected:
 	uint32_t compileShader(int32_t type, const char* shaderSource) const;
 	uint32_t linkShader(uint32_t vertex, uint32_t fragment) const;
+	uint32_t linkShader(uint32_t compute) const;
 	int32_t checkStatus(uint32_t check, bool isProgram = false) const;
 
 private:
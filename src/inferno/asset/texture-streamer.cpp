@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::max, std::sort
+#include <cstdint>   // uint32_t, uint64_t
+#include <cstring>   // std::memcpy
+#include <memory>    // std::make_unique
+#include <mutex>     // std::lock_guard
+#include <utility>   // std::move
+#include <vector>
+
+#include "ruc/format/log.h"
+
+#include "inferno/asset/texture-streamer.h"
+#include "inferno/asset/texture.h"
+#include "inferno/render/upload-ring.h"
+#include "inferno/util/thread-pool.h"
+
+namespace Inferno {
+
+TextureStreamer::TextureStreamer(s)
+{
+	m_threadPool = std::make_unique<ThreadPool>(threadCount);
+
+	ruc::info("TextureStreamer initialized");
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Wait for the running reads
+	m_threadPool.reset();
+}
+
+uint64_t TextureStreamer::add(Texture2D* texture)
+{
+	uint64_t id = m_nextId++;
+	m_textures.emplace(id, texture);
+
+	return id;
+}
+
+void TextureStreamer::remove(uint64_t id)
+{
+	// A read that is still running is thrown away when it finishes
+	m_textures.erase(id);
+}
+
+void TextureStreamer::update()
+{
+	std::vector<Read> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		finished.swap(m_finished);
+	}
+
+	for (auto& read : finished) {
+		m_reads--;
+
+		auto it = m_textures.find(read.id);
+		if (it == m_textures.end()) {
+			UploadRing::the().cancel(read.staging);
+			continue;
+		}
+
+		it->second->m_reading = false;
+		if (read.staging.valid()) {
+			UploadRing::the().bind();
+			it->second->uploadLevel(read.level, read.staging.pointer(), read.staging.size);
+			UploadRing::the().unbind();
+			UploadRing::the().submit(read.staging);
+		}
+		else {
+			it->second->uploadLevel(read.level, read.data.data(), read.data.size());
+		}
+	}
+
+	struct Request {
+		uint64_t id { 0 };
+		Texture2D* texture { nullptr };
+		float priority { 0.0f };
+	};
+	std::vector<Request> requests;
+
+	for (auto [id, texture] : m_textures) {
+		texture->m_hiddenFrames = texture->m_drawnSize > 0.0f ? 0 : texture->m_hiddenFrames + 1;
+
+		if (!texture->m_reading && texture->m_wantedLevel < texture->m_residentLevel) {
+			// How many times larger it is drawn than the level it is sampled from
+			const auto& level = texture->m_levels[texture->m_residentLevel];
+			float priority = texture->m_drawnSize / std::max(level.width, level.height);
+			requests.push_back({ id, texture, priority });
+		}
+		else if (!texture->m_reading && texture->m_hiddenFrames > dropDelay && texture->m_storageLevel < texture->tailLevel()) {
+			texture->reallocate(texture->tailLevel());
+		}
+
+		// Gathered again while rendering the next frame
+		texture->m_wantedLevel = UINT32_MAX;
+		texture->m_drawnSize = 0.0f;
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+		return a.priority > b.priority;
+	});
+
+	// One level at a time per texture, so every texture gets sharper step by step
+	for (const auto& request : requests) {
+		if (m_reads >= maxReads) {
+			break;
+		}
+		read(request.id, request.texture, request.texture->m_residentLevel - 1);
+	}
+}
+
+// -----------------------------------------
+
+void TextureStreamer::read(uint64_t id, Texture2D* texture, uint32_t level)
+{
+	// The large levels were dropped, allocate the whole mip chain again
+	if (level < texture->m_storageLevel) {
+		texture->reallocate(0);
+	}
+
+	texture->m_reading = true;
+	m_reads++;
+
+	// The copy of the file keeps its memory alive, if the texture is destroyed during the read
+	m_threadPool->enqueue([this, id, level, file = texture->m_file, data = texture->m_levels[level].data]() {
+		// Touching the memory is what pulls a mapped file in from disk
+		Read read { id, level, UploadRing::the().allocate(static_cast<uint32_t>(data.size())), {} };
+		if (read.staging.valid()) {
+			std::memcpy(read.staging.data, data.data(), data.size());
+		}
+		else {
+			read.data.assign(data.begin(), data.end());
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_finished.push_back(std::move(read));
+	});
+}
+
+} // namespace Inferno
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint8_t, uint32_t, uint64_t
+#include <memory>  // std::unique_ptr
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "ruc/singleton.h"
+
+#include "inferno/render/upload-ring.h"
+
+namespace Inferno {
+
+class Texture2D;
+class ThreadPool;
+
+// Loads the large mip levels of cooked textures in the background, the ones that
+// are drawn largest on screen first, and drops them again once out of view
+class TextureStreamer final : public ruc::Singleton<TextureStreamer> {
+public:
+	static constexpr uint32_t threadCount = 2;
+	static constexpr uint32_t maxReads = 4;    // Levels read from disk at the same time
+	static constexpr uint32_t dropDelay = 300; // Frames a texture is not drawn, before its large levels are dropped
+
+	TextureStreamer(s);
+	virtual ~TextureStreamer();
+
+	// Returns the ID that the texture is streamed under
+	uint64_t add(Texture2D* texture);
+	void remove(uint64_t id);
+
+	// Uploads the levels that finished reading, starts reading the most needed
+	// levels and drops the levels of the textures that are out of view
+	void update();
+
+private:
+	struct Read {
+		uint64_t id { 0 };
+		uint32_t level { 0 };
+		UploadRange staging;
+		std::vector<uint8_t> data; // If the upload ring had no room
+	};
+
+	void read(uint64_t id, Texture2D* texture, uint32_t level);
+
+	uint64_t m_nextId { 1 };
+	uint32_t m_reads { 0 };
+	std::unordered_map<uint64_t, Texture2D*> m_textures;
+
+	std::mutex m_mutex;
+	std::vector<Read> m_finished;
+
+	std::unique_ptr<ThreadPool> m_threadPool;
+};
+
+} // namespace Inferno
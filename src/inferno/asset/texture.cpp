@@ -4,22 +4,112 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <climits> // UINT_MAX
-#include <cstdint> // uint8_t, uint32_t
-#include <memory>  // std::shared_ptr
+#include <algorithm> // std::max, std::min
+#include <bit>       // std::bit_width
+#include <climits>   // UINT_MAX
+#include <cstdint>   // uint8_t, uint32_t
+#include <cstring>   // std::memcpy
+#include <memory>    // std::shared_ptr
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility> // std::exchange, std::move
+#include <vector>
 
 #include "assimp/texture.h"
 #include "glad/glad.h"
+#include "ruc/format/log.h"
 #include "ruc/meta/assert.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
+#include "inferno/asset/shader.h"
+#include "inferno/asset/texture-streamer.h"
 #include "inferno/asset/texture.h"
+#include "inferno/io/bcn.h"
+#include "inferno/io/file-system.h"
+#include "inferno/io/ktx2.h"
+#include "inferno/render/upload-ring.h"
+#include "inferno/util/hash.h"
+
+// Part of every desktop driver, but not of the core profile
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83f0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83f3
+#endif
 
 namespace Inferno {
 
+static uint32_t compressedFormat(uint32_t vkFormat)
+{
+	switch (vkFormat) {
+	case KTX2::BC1_RGB_UNORM:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case KTX2::BC3_UNORM:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case KTX2::BC5_UNORM:
+		return GL_COMPRESSED_RG_RGTC2;
+	case KTX2::BC7_UNORM:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default:
+		return 0;
+	};
+}
+
+// RGBA pixels without any transparency
+static bool opaque(std::span<const uint8_t> pixels)
+{
+	for (size_t i = 3; i < pixels.size(); i += 4) {
+		if (pixels[i] != 255) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Mip chain of an RGBA image, every level is a box filtered half of the one before it
+static std::vector<std::vector<uint8_t>> mipChain(BCn::Format format, std::vector<uint8_t> level, uint32_t width, uint32_t height, size_t& uncompressedSize)
+{
+	std::vector<std::vector<uint8_t>> levels;
+	while (true) {
+		levels.push_back(BCn::encode(format, level.data(), width, height));
+		uncompressedSize += level.size();
+		if (width == 1 && height == 1) {
+			break;
+		}
+
+		uint32_t nextWidth = std::max(1u, width / 2);
+		uint32_t nextHeight = std::max(1u, height / 2);
+		std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+		for (uint32_t y = 0; y < nextHeight; ++y) {
+			for (uint32_t x = 0; x < nextWidth; ++x) {
+				uint32_t x0 = std::min(x * 2, width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				uint32_t y0 = std::min(y * 2, height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t c = 0; c < 4; ++c) {
+					uint32_t sum = level[(y0 * width + x0) * 4 + c] + level[(y0 * width + x1) * 4 + c]
+					               + level[(y1 * width + x0) * 4 + c] + level[(y1 * width + x1) * 4 + c];
+					next[(y * nextWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		level = std::move(next);
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	return levels;
+}
+
+// -----------------------------------------
+
 Texture::~Texture()
 {
 	glDeleteTextures(1, &m_id);
@@ -87,9 +177,77 @@ void Texture::init(uint32_t width, uint32_t height, uint32_t internalFormat, uin
 	m_dataType = dataType;
 }
 
+uint32_t Texture::bytesPerPixel() const
+{
+	switch (m_internalFormat) {
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+		return 2;
+	case GL_RGB8:
+		return 3;
+	case GL_RGBA16F:
+		return 8;
+	case GL_RGB32F:
+		return 12;
+	case GL_RGBA32F:
+		return 16;
+	default: // GL_RGBA8, GL_DEPTH24_STENCIL8, ..
+		return 4;
+	};
+}
+
+size_t Texture::gpuSize() const
+{
+	return static_cast<size_t>(m_width) * m_height * bytesPerPixel();
+}
+
 // -----------------------------------------
 
+std::unordered_map<uint64_t, std::weak_ptr<Texture2D>> Texture2D::s_contents;
+
+Texture2D::~Texture2D()
+{
+	// Destroyed before it was uploaded
+	if (m_pixels) {
+		stbi_image_free(m_pixels);
+	}
+	if (m_staging.valid()) {
+		UploadRing::the().cancel(m_staging);
+	}
+
+	if (m_streamId != 0) {
+		TextureStreamer::the().remove(m_streamId);
+	}
+
+	if (auto it = s_contents.find(m_contentHash); it != s_contents.end() && it->second.expired()) {
+		s_contents.erase(it);
+	}
+}
+
 std::shared_ptr<Texture2D> Texture2D::create(std::string_view path)
+{
+	auto result = createAsync(path);
+
+	result->decode();
+	result->upload();
+	result->setReady();
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::create(const aiTexture* texture)
+{
+	auto result = createAsync(texture);
+
+	result->decode();
+	result->upload();
+	result->setReady();
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::create(std::string_view path, std::span<const uint8_t> encoded)
 {
 	auto result = std::shared_ptr<Texture2D>(new Texture2D(path));
 
@@ -98,10 +256,10 @@ std::shared_ptr<Texture2D> Texture2D::create(std::string_view path)
 	int channels = 0;
 	unsigned char* data = nullptr;
 
-	// Load image data
+	// Decode image data
 	stbi_set_flip_vertically_on_load(1);
-	data = stbi_load(path.data(), &width, &height, &channels, STBI_default);
-	VERIFY(data, "failed to load image: '{}'", path);
+	data = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, STBI_default);
+	VERIFY(data, "failed to decode image: '{}'", path);
 
 	result->init(width, height, channels);
 	result->createImpl(data);
@@ -112,34 +270,242 @@ std::shared_ptr<Texture2D> Texture2D::create(std::string_view path)
 	return result;
 }
 
-std::shared_ptr<Texture2D> Texture2D::create(aiTexture* texture)
+std::shared_ptr<Texture2D> Texture2D::create(
+	std::string_view path,
+	uint32_t width, uint32_t height, uint32_t internalFormat, uint32_t dataFormat)
+{
+	auto result = std::shared_ptr<Texture2D>(new Texture2D(path));
+
+	result->init(width, height, internalFormat, dataFormat, GL_UNSIGNED_BYTE);
+	result->createStorageImpl();
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::createAsync(std::string_view path)
+{
+	auto result = std::shared_ptr<Texture2D>(new Texture2D(path));
+	result->m_ready = false;
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::createAsync(const aiTexture* texture)
 {
 	auto result = std::shared_ptr<Texture2D>(new Texture2D(texture->mFilename.C_Str()));
+	result->m_ready = false;
+
+	// Height 0 is compression, byte length stored in width variable
+	bool isCompressed = texture->mHeight == 0;
+	if (!isCompressed) {
+		// ARGB888
+		// TODO: imprement format hints? `archFormatHint'
+		VERIFY_NOT_REACHED();
+	}
+
+	// The scene that owns the data is gone by the time the texture is decoded
+	auto data = reinterpret_cast<const uint8_t*>(texture->pcData);
+	result->m_encoded.assign(data, data + texture->mWidth);
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::createAsync(std::string_view path, std::span<const uint8_t> encoded)
+{
+	auto result = std::shared_ptr<Texture2D>(new Texture2D(path));
+	result->m_ready = false;
+	result->m_encoded.assign(encoded.begin(), encoded.end());
+
+	return result;
+}
+
+std::shared_ptr<Texture2D> Texture2D::createAsync(std::string_view path, FileData cooked)
+{
+	auto result = std::shared_ptr<Texture2D>(new Texture2D(path));
+	result->m_ready = false;
+	result->m_file = std::move(cooked);
+
+	return result;
+}
+
+bool Texture2D::cook(std::string_view path, std::optional<BCn::Format> format)
+{
+	std::string input(path);
+
+	// Same orientation as decode()
+	stbi_set_flip_vertically_on_load_thread(1);
+	int imageWidth = 0;
+	int imageHeight = 0;
+	int channels = 0;
+	unsigned char* pixels = stbi_load(input.c_str(), &imageWidth, &imageHeight, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		ruc::error("Texture could not read: '{}'", input);
+		return false;
+	}
+
+	uint32_t width = static_cast<uint32_t>(imageWidth);
+	uint32_t height = static_cast<uint32_t>(imageHeight);
+	std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
+
+	if (!format) {
+		format = opaque(level) ? BCn::Format::BC1 : BCn::Format::BC7;
+	}
+
+	size_t uncompressedSize = 0;
+	auto levels = mipChain(*format, std::move(level), width, height, uncompressedSize);
+
+	std::string output = input + ".ktx2";
+	if (!KTX2::write(output, *format, static_cast<uint32_t>(imageWidth), static_cast<uint32_t>(imageHeight), 1, levels)) {
+		return false;
+	}
 
-	int width = static_cast<int>(texture->mWidth);
-	int height = static_cast<int>(texture->mHeight);
+	size_t compressedSize = 0;
+	for (const auto& compressed : levels) {
+		compressedSize += compressed.size();
+	}
+	ruc::info("Texture cooked: '{}', {}x{}, {} levels, {} -> {} bytes",
+	          output, imageWidth, imageHeight, levels.size(), uncompressedSize, compressedSize);
+	return true;
+}
+
+std::vector<uint8_t> Texture2D::cook(std::span<const uint8_t> encoded, std::optional<BCn::Format> format)
+{
+	// Same orientation as decode()
+	stbi_set_flip_vertically_on_load_thread(1);
+	int imageWidth = 0;
+	int imageHeight = 0;
 	int channels = 0;
-	unsigned char* data = reinterpret_cast<unsigned char*>(texture->pcData);
-	bool isCompressed = height == 0; // height 0 is compression, byte length stored in width variable
+	unsigned char* pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &imageWidth, &imageHeight, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		return {};
+	}
+
+	uint32_t width = static_cast<uint32_t>(imageWidth);
+	uint32_t height = static_cast<uint32_t>(imageHeight);
+	std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
 
-	if (isCompressed) {
-		stbi_set_flip_vertically_on_load(0);
-		data = stbi_load_from_memory(data, width, &width, &height, &channels, STBI_default);
+	if (!format) {
+		format = opaque(level) ? BCn::Format::BC1 : BCn::Format::BC7;
+	}
+
+	size_t uncompressedSize = 0;
+	auto levels = mipChain(*format, std::move(level), width, height, uncompressedSize);
+	return KTX2::encode(*format, width, height, 1, levels);
+}
+
+void Texture2D::decode()
+{
+	// Cooked file in memory, embedded in another asset
+	if (m_file.valid()) {
+		bool decoded = decodeCompressed(std::exchange(m_file, {}));
+		VERIFY(decoded, "failed to decode cooked image: '{}'", m_path);
+		return;
+	}
+
+	// Prefer the block-compressed version written by the cook step
+	if (m_encoded.empty() && decodeCompressed(FileSystem::the().read(m_path.ends_with(".ktx2") ? m_path : m_path + ".ktx2"))) {
+		return;
+	}
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+
+	// Load image data, the flip setting is per thread as decoding runs on the loader threads
+	if (m_encoded.empty()) {
+		auto file = FileSystem::the().read(m_path);
+		VERIFY(file.valid(), "failed to load image: '{}'", m_path);
+		stbi_set_flip_vertically_on_load_thread(1);
+		m_pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, STBI_default);
+		VERIFY(m_pixels, "failed to decode image: '{}'", m_path);
 	}
 	else {
-		channels = 4; // ARGB888
-		// TODO: imprement format hints? `archFormatHint'
-		VERIFY_NOT_REACHED();
+		// Same orientation as an image file, the texture coordinates of models have their origin at the bottom
+		stbi_set_flip_vertically_on_load_thread(1);
+		m_pixels = stbi_load_from_memory(m_encoded.data(), static_cast<int>(m_encoded.size()), &width, &height, &channels, STBI_default);
+		VERIFY(m_pixels, "failed to decode image: '{}'", m_path);
+		m_encoded = {};
 	}
 
-	result->init(width, height, channels);
-	result->createImpl(data);
+	init(width, height, channels);
+	m_uploadSize = static_cast<size_t>(width) * height * channels;
 
-	return result;
+	// Identical pixels of the same size are shared on the GPU
+	uint64_t seed = static_cast<uint64_t>(width) << 32 | static_cast<uint64_t>(height) << 8 | channels;
+	m_contentHash = hashBytes({ m_pixels, m_uploadSize }, seed);
+
+	// Move the pixels into the upload ring, so the upload doesnt copy out of client memory
+	m_staging = UploadRing::the().allocate(m_uploadSize);
+	if (m_staging.valid()) {
+		std::memcpy(m_staging.data, m_pixels, m_uploadSize);
+		stbi_image_free(m_pixels);
+		m_pixels = nullptr;
+	}
+}
+
+void Texture2D::upload()
+{
+	if (share()) {
+		return;
+	}
+
+	if (!m_levels.empty()) {
+		createCompressedImpl();
+
+		// Clean resources, the file is kept for streaming the larger levels
+		if (m_streamId == 0) {
+			m_levels.clear();
+			m_file = {};
+		}
+	}
+	else if (m_staging.valid()) {
+		UploadRing::the().bind();
+		createImpl(m_staging.pointer());
+		UploadRing::the().unbind();
+		UploadRing::the().submit(m_staging);
+		m_staging = {};
+	}
+	else {
+		createImpl(m_pixels);
+
+		// Clean resources
+		stbi_image_free(m_pixels);
+		m_pixels = nullptr;
+	}
+
+	if (m_contentHash != 0) {
+		s_contents[m_contentHash] = weak_from_this();
+	}
+}
+
+size_t Texture2D::gpuSize() const
+{
+	if (m_shared) {
+		return 0;
+	}
+
+	if (m_compressedSize > 0) {
+		return m_compressedSize;
+	}
+
+	// A full mipmap chain adds a third
+	return m_mipmapped ? Texture::gpuSize() * 4 / 3 : Texture::gpuSize();
+}
+
+size_t Texture2D::sharedSize() const
+{
+	return m_shared ? m_shared->gpuSize() : 0;
 }
 
 void Texture2D::bind(uint32_t unit) const
 {
+	if (m_shared) {
+		m_shared->bind(unit);
+		return;
+	}
+
 	// Set active unit
 	glActiveTexture(GL_TEXTURE0 + unit);
 
@@ -151,58 +517,456 @@ void Texture2D::bind(uint32_t unit) const
 
 void Texture2D::unbind() const
 {
+	if (m_shared) {
+		m_shared->unbind();
+		return;
+	}
+
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Texture2D::createImpl(unsigned char* data)
+void Texture2D::createImpl(const void* data)
 {
 	m_id = UINT_MAX;
 
 	// Create texture object
-	glGenTextures(1, &m_id);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
 
-	// Bind texture object
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	// Allocate the whole mip chain, the smaller levels are generated from the image
+	glTextureStorage2D(
+		m_id,
+		std::bit_width(std::max(m_width, m_height)), // Mipmap levels
+		m_internalFormat,                            // Texture format
+		m_width, m_height);                          // Image width/height
 
 	// Set unpacking of pixel data to byte-alignment,
 	// this prevents alignment issues when using a single byte for color
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	// Generate texture
-	glTexImage2D(
-		GL_TEXTURE_2D,     // Texture target
+	// Upload the image, out of the upload ring if that is bound
+	glTextureSubImage2D(
+		m_id,
 		0,                 // Midmap level, base starts at level 0
-		m_internalFormat,  // Texture format
+		0, 0,              // Offset
 		m_width, m_height, // Image width/height
-		0,                 // Always 0 (legacy)
 		m_dataFormat,      // Texture source format
 		m_dataType,        // Texture source datatype
 		data);             // Image data
 
 	// Set the texture wrapping / filtering options
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // Magnify
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // Minify
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);      // X
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);      // Y
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // Magnify
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // Minify
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_REPEAT);      // X
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_REPEAT);      // Y
 
 	// Automatically generate all mipmap levels
-	glGenerateMipmap(GL_TEXTURE_2D);
+	glGenerateTextureMipmap(m_id);
+	m_mipmapped = true;
+}
 
-	// Unbind texture object
-	glBindTexture(GL_TEXTURE_2D, 0);
+bool Texture2D::decodeCompressed(FileData file)
+{
+	KTX2::Image image;
+	if (!file.valid() || !KTX2::parse(file.bytes(), image)) {
+		return false;
+	}
+
+	uint32_t internalFormat = compressedFormat(image.vkFormat);
+	if (internalFormat == 0) {
+		ruc::warn("Texture unsupported KTX2 format {}, decoding the image instead: '{}'", image.vkFormat, m_path);
+		return false;
+	}
+	if (image.faceCount != 1) {
+		return false;
+	}
+
+	init(image.width, image.height, internalFormat, GL_RGBA, GL_UNSIGNED_BYTE);
+	// The file holds the size and format, and every level
+	m_contentHash = hashBytes(file.bytes());
+	m_file = std::move(file);
+	m_levels = std::move(image.levels);
+
+	// Only the small levels are uploaded up front
+	m_uploadSize = 0;
+	for (size_t i = tailLevel(); i < m_levels.size(); ++i) {
+		m_uploadSize += m_levels[i].data.size();
+	}
+
+	// Copy them into the upload ring one after another, this also reads them in from disk
+	m_staging = UploadRing::the().allocate(m_uploadSize);
+	if (m_staging.valid()) {
+		size_t offset = 0;
+		for (size_t i = tailLevel(); i < m_levels.size(); ++i) {
+			std::memcpy(m_staging.data + offset, m_levels[i].data.data(), m_levels[i].data.size());
+			offset += m_levels[i].data.size();
+		}
+	}
+
+	return true;
+}
+
+void Texture2D::createCompressedImpl()
+{
+	m_id = UINT_MAX;
+
+	// Create texture object
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
+
+	// Allocate the whole mip chain, which is then filled in without any conversion
+	glTextureStorage2D(
+		m_id,
+		static_cast<GLsizei>(m_levels.size()), // Mipmap levels
+		m_internalFormat,                      // Texture format, compressed
+		m_width, m_height);                    // Image width/height
+
+	// Set the texture wrapping / filtering options, same as the uncompressed textures
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	m_compressedSize = 0;
+	for (const auto& level : m_levels) {
+		m_compressedSize += level.data.size();
+	}
+
+	// Upload the mip tail, smallest first, the larger levels are streamed in when needed
+	m_storageLevel = 0;
+	m_residentLevel = static_cast<uint32_t>(m_levels.size());
+	if (m_staging.valid()) {
+		UploadRing::the().bind();
+	}
+	uint32_t offset = static_cast<uint32_t>(m_uploadSize);
+	for (uint32_t level = static_cast<uint32_t>(m_levels.size()); level-- > tailLevel();) {
+		const auto& data = m_levels[level].data;
+		offset -= static_cast<uint32_t>(data.size());
+		uploadLevel(level, m_staging.valid() ? m_staging.pointer(offset) : data.data(), data.size());
+	}
+	if (m_staging.valid()) {
+		UploadRing::the().unbind();
+		UploadRing::the().submit(m_staging);
+		m_staging = {};
+	}
+
+	if (m_residentLevel > 0) {
+		m_streamId = TextureStreamer::the().add(this);
+	}
+}
+
+uint32_t Texture2D::tailLevel() const
+{
+	uint32_t level = 0;
+	while (level + 1 < m_levels.size() && std::max(m_levels[level].width, m_levels[level].height) > streamTailSize) {
+		level++;
+	}
+
+	return level;
+}
+
+void Texture2D::uploadLevel(uint32_t level, const void* data, size_t size)
+{
+	VERIFY(level >= m_storageLevel && level < m_levels.size(), "texture level out of storage: {}", level);
+
+	glCompressedTextureSubImage2D(
+		m_id,
+		static_cast<GLint>(level - m_storageLevel),
+		0, 0, m_levels[level].width, m_levels[level].height,
+		m_internalFormat,
+		static_cast<GLsizei>(size),
+		data);
+
+	// Levels arrive from small to large, sample the largest one that has arrived
+	m_residentLevel = std::min(m_residentLevel, level);
+	glTextureParameteri(m_id, GL_TEXTURE_BASE_LEVEL, m_residentLevel - m_storageLevel);
+}
+
+void Texture2D::reallocate(uint32_t storageLevel)
+{
+	uint32_t id = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &id);
+	glTextureStorage2D(
+		id,
+		static_cast<GLsizei>(m_levels.size() - storageLevel),
+		m_internalFormat,
+		m_levels[storageLevel].width, m_levels[storageLevel].height);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Copy the resident levels that fit, on the GPU
+	uint32_t residentLevel = std::max(m_residentLevel, storageLevel);
+	for (uint32_t level = residentLevel; level < m_levels.size(); ++level) {
+		glCopyImageSubData(
+			m_id, GL_TEXTURE_2D, static_cast<GLint>(level - m_storageLevel), 0, 0, 0,
+			id, GL_TEXTURE_2D, static_cast<GLint>(level - storageLevel), 0, 0, 0,
+			m_levels[level].width, m_levels[level].height, 1);
+	}
+	glDeleteTextures(1, &m_id);
+
+	m_id = id;
+	m_storageLevel = storageLevel;
+	m_residentLevel = residentLevel;
+	glTextureParameteri(m_id, GL_TEXTURE_BASE_LEVEL, m_residentLevel - m_storageLevel);
+
+	m_compressedSize = 0;
+	for (size_t i = m_storageLevel; i < m_levels.size(); ++i) {
+		m_compressedSize += m_levels[i].data.size();
+	}
+}
+
+void Texture2D::requestSize(float pixels)
+{
+	if (m_shared) {
+		m_shared->requestSize(pixels);
+		return;
+	}
+
+	if (m_streamId == 0) {
+		return;
+	}
+
+	// Smallest level that is still drawn at no more than one texel per pixel
+	uint32_t level = 0;
+	while (level + 1 < m_levels.size() && std::max(m_levels[level + 1].width, m_levels[level + 1].height) >= pixels) {
+		level++;
+	}
+
+	m_wantedLevel = std::min(m_wantedLevel, level);
+	m_drawnSize = std::max(m_drawnSize, pixels);
+}
+
+bool Texture2D::share()
+{
+	auto it = s_contents.find(m_contentHash);
+	if (m_contentHash == 0 || it == s_contents.end()) {
+		return false;
+	}
+
+	auto texture = it->second.lock();
+	if (!texture) {
+		s_contents.erase(it);
+		return false;
+	}
+	m_shared = texture;
+
+	// Clean resources, nothing is uploaded
+	if (m_pixels) {
+		stbi_image_free(m_pixels);
+		m_pixels = nullptr;
+	}
+	if (m_staging.valid()) {
+		UploadRing::the().cancel(m_staging);
+		m_staging = {};
+	}
+	m_levels.clear();
+	m_file = {};
+
+	ruc::info("Texture shares the GPU texture of '{}', {:.2f} MiB saved: '{}'",
+	          texture->path(), texture->gpuSize() / 1024.0f / 1024.0f, m_path);
+
+	return true;
+}
+
+void Texture2D::createStorageImpl()
+{
+	m_id = UINT_MAX;
+
+	// Create texture object
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
+
+	// Allocate immutable storage, the contents are filled in with update()
+	glTextureStorage2D(
+		m_id,
+		1,                  // Mipmap levels
+		m_internalFormat,   // Texture format, must be sized
+		m_width, m_height); // Image width/height
+
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Texture2D::update(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t rowLength, const void* data)
+{
+	// Read a sub-rectangle out of a larger buffer, without repacking it first
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+
+	glTextureSubImage2D(m_id, 0, x, y, width, height, m_dataFormat, m_dataType, data);
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 // -----------------------------------------
 
+static constexpr const char* cubemapFaces[6] { "-px", "-nx", "-py", "-ny", "-pz", "-nz" };
+
+TextureCubemap::~TextureCubemap()
+{
+	// Destroyed before it was uploaded
+	for (auto* face : m_faces) {
+		if (face) {
+			stbi_image_free(face);
+		}
+	}
+	if (m_equirectangular) {
+		stbi_image_free(m_equirectangular);
+	}
+	if (m_staging.valid()) {
+		UploadRing::the().cancel(m_staging);
+	}
+}
+
 std::shared_ptr<TextureCubemap> TextureCubemap::create(std::string_view path)
 {
-	auto result = std::shared_ptr<TextureCubemap>(new TextureCubemap(path));
+	auto result = createAsync(path);
+	result->m_synchronous = true;
 
-	result->createImpl();
+	result->decode();
+	result->upload();
+	result->setReady();
 
 	return result;
 }
 
+std::shared_ptr<TextureCubemap> TextureCubemap::createAsync(std::string_view path)
+{
+	auto result = std::shared_ptr<TextureCubemap>(new TextureCubemap(path));
+	result->m_ready = false;
+
+	return result;
+}
+
+bool TextureCubemap::cook(std::string_view path, std::optional<BCn::Format> format)
+{
+	std::string input(path);
+	size_t dotIndex = input.find_last_of('.');
+
+	// Same orientation as decode()
+	stbi_set_flip_vertically_on_load_thread(0);
+	std::vector<uint8_t> faces[6];
+	int width = 0;
+	int height = 0;
+	for (size_t i = 0; i < 6; ++i) {
+		std::string facePath = input.substr(0, dotIndex) + cubemapFaces[i] + input.substr(dotIndex);
+		int faceWidth = 0;
+		int faceHeight = 0;
+		int channels = 0;
+		unsigned char* pixels = stbi_load(facePath.c_str(), &faceWidth, &faceHeight, &channels, STBI_rgb_alpha);
+		if (!pixels) {
+			ruc::error("Texture could not read: '{}'", facePath);
+			return false;
+		}
+
+		faces[i].assign(pixels, pixels + static_cast<size_t>(faceWidth) * faceHeight * 4);
+		stbi_image_free(pixels);
+
+		if (i > 0 && (faceWidth != width || faceHeight != height)) {
+			ruc::error("Texture cubemap faces differ in size: '{}'", facePath);
+			return false;
+		}
+		width = faceWidth;
+		height = faceHeight;
+	}
+
+	if (!format) {
+		bool opaqueFaces = true;
+		for (const auto& face : faces) {
+			opaqueFaces &= opaque(face);
+		}
+		format = opaqueFaces ? BCn::Format::BC1 : BCn::Format::BC7;
+	}
+
+	// Every level holds the six faces one after another
+	size_t uncompressedSize = 0;
+	std::vector<std::vector<uint8_t>> levels;
+	for (auto& face : faces) {
+		auto chain = mipChain(*format, std::move(face), static_cast<uint32_t>(width), static_cast<uint32_t>(height), uncompressedSize);
+		levels.resize(chain.size());
+		for (size_t level = 0; level < chain.size(); ++level) {
+			levels[level].insert(levels[level].end(), chain[level].begin(), chain[level].end());
+		}
+	}
+
+	std::string output = input + ".ktx2";
+	if (!KTX2::write(output, *format, static_cast<uint32_t>(width), static_cast<uint32_t>(height), 6, levels)) {
+		return false;
+	}
+
+	size_t compressedSize = 0;
+	for (const auto& compressed : levels) {
+		compressedSize += compressed.size();
+	}
+	ruc::info("Texture cooked: '{}', 6x {}x{}, {} levels, {} -> {} bytes",
+	          output, width, height, levels.size(), uncompressedSize, compressedSize);
+	return true;
+}
+
+void TextureCubemap::decode()
+{
+	// Prefer the block-compressed version written by the cook step
+	if (decodeCompressed()) {
+		return;
+	}
+
+	if (m_path.ends_with(".hdr")) {
+		decodeEquirectangular();
+		return;
+	}
+
+	decodeFaces();
+}
+
+void TextureCubemap::upload()
+{
+	if (!m_levels.empty()) {
+		createCompressedImpl();
+
+		// Clean resources
+		m_levels.clear();
+		m_file = {};
+		return;
+	}
+
+	if (m_equirectangularWidth > 0) {
+		createEquirectangularImpl();
+		return;
+	}
+
+	if (m_staging.valid()) {
+		UploadRing::the().bind();
+		createImpl();
+		UploadRing::the().unbind();
+		UploadRing::the().submit(m_staging);
+		m_staging = {};
+		return;
+	}
+
+	// The faces failed to decode, the cubemap stays empty
+	if (m_width > 0) {
+		createImpl();
+	}
+
+	// Clean resources
+	for (auto*& face : m_faces) {
+		stbi_image_free(face);
+		face = nullptr;
+	}
+}
+
+size_t TextureCubemap::gpuSize() const
+{
+	if (m_compressedSize > 0) {
+		return m_compressedSize;
+	}
+
+	// A full mipmap chain adds a third
+	return Texture::gpuSize() * 6 * 4 / 3;
+}
+
 void TextureCubemap::bind(uint32_t unit) const
 {
 	// Set active unit
@@ -219,64 +983,285 @@ void TextureCubemap::unbind() const
 	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
-void TextureCubemap::createImpl()
+bool TextureCubemap::decodeCompressed()
 {
-	m_id = UINT_MAX;
+	auto file = FileSystem::the().read(m_path.ends_with(".ktx2") ? m_path : m_path + ".ktx2");
+	KTX2::Image image;
+	if (!file.valid() || !KTX2::parse(file.bytes(), image)) {
+		return false;
+	}
 
-	// Create texture object
-	glGenTextures(1, &m_id);
+	uint32_t internalFormat = compressedFormat(image.vkFormat);
+	if (internalFormat == 0 || image.faceCount != 6) {
+		ruc::warn("Texture unsupported KTX2 cubemap, decoding the faces instead: '{}'", m_path);
+		return false;
+	}
 
-	// Bind texture object
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	init(image.width, image.height, internalFormat, GL_RGBA, GL_UNSIGNED_BYTE);
+	m_file = std::move(file);
+	m_levels = std::move(image.levels);
 
-	// Set unpacking of pixel data to byte-alignment,
-	// this prevents alignment issues when using a single byte for color
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Copy every level into the upload ring one after another, this also reads them in from disk
+	m_uploadSize = 0;
+	for (const auto& level : m_levels) {
+		m_uploadSize += level.data.size();
+	}
+	m_staging = UploadRing::the().allocate(m_uploadSize);
+	if (m_staging.valid()) {
+		size_t offset = 0;
+		for (const auto& level : m_levels) {
+			std::memcpy(m_staging.data + offset, level.data.data(), level.data.size());
+			offset += level.data.size();
+		}
+	}
 
-	stbi_set_flip_vertically_on_load(0);
+	return true;
+}
 
-	static constexpr const char* cubemapPaths[6] { "-px", "-nx", "-py", "-ny", "-pz", "-nz" };
-	size_t dotIndex = m_path.find_last_of('.');
-	std::string path = m_path.substr(0, dotIndex);
-	std::string extension = m_path.substr(dotIndex);
+void TextureCubemap::decodeEquirectangular()
+{
+	auto file = FileSystem::the().read(m_path);
+	VERIFY(file.valid(), "failed to load image: '{}'", m_path);
 
+	// Bottom row first, so the latitude grows with the texture coordinate
+	stbi_set_flip_vertically_on_load_thread(1);
 	int width = 0;
 	int height = 0;
 	int channels = 0;
-	unsigned char* data = nullptr;
+	m_equirectangular = stbi_loadf_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb);
+	VERIFY(m_equirectangular, "failed to decode image: '{}'", m_path);
+
+	m_equirectangularWidth = static_cast<uint32_t>(width);
+	m_equirectangularHeight = static_cast<uint32_t>(height);
+	m_uploadSize = static_cast<size_t>(width) * height * 3 * sizeof(float);
+
+	// A face covers a quarter of the width, 90 degrees
+	uint32_t faceSize = std::max(1u, m_equirectangularWidth / 4);
+	init(faceSize, faceSize, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+
+	// Move the image into the upload ring, so the upload doesnt copy out of client memory
+	m_staging = UploadRing::the().allocate(m_uploadSize);
+	if (m_staging.valid()) {
+		std::memcpy(m_staging.data, m_equirectangular, m_uploadSize);
+		stbi_image_free(m_equirectangular);
+		m_equirectangular = nullptr;
+	}
+}
+
+void TextureCubemap::decodeFaces()
+{
+	if (m_synchronous) {
+		for (size_t i = 0; i < 6; ++i) {
+			decodeFace(i);
+		}
+		finishFaces();
+		return;
+	}
+
+	// The faces are independent, each is decoded in a task of its own on the loader
+	// threads. Nothing waits on them, the last one to finish queues the upload
+	m_decodeDeferred = true;
+	m_facesRemaining.store(6, std::memory_order_relaxed);
+	auto self = shared_from_this();
 	for (size_t i = 0; i < 6; ++i) {
-		std::string facePath = path + cubemapPaths[i] + extension;
+		AssetManager::the().enqueue([self, i]() {
+			self->decodeFace(i);
+			if (self->m_facesRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				self->finishFaces();
+				AssetManager::the().queueUpload(self);
+			}
+		});
+	}
+}
+
+void TextureCubemap::decodeFace(size_t i)
+{
+	size_t dotIndex = m_path.find_last_of('.');
+	std::string facePath = m_path.substr(0, dotIndex) + cubemapFaces[i] + m_path.substr(dotIndex);
 
-		// Load image data
-		data = stbi_load(facePath.c_str(), &width, &height, &channels, STBI_default);
-		VERIFY(data, "failed to load image: '{}'", facePath.c_str());
+	// The flip setting is per thread
+	stbi_set_flip_vertically_on_load_thread(0);
 
-		init(width, height, channels);
+	// Load image data
+	auto file = FileSystem::the().read(facePath);
+	if (!file.valid()) {
+		ruc::error("Texture could not read: '{}'", facePath);
+		return;
+	}
 
-		// Generate texture face
-		glTexImage2D(
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, // Texture target
-			0,                                  // Midmap level, base starts at level 0
-			m_internalFormat,                   // Internal format
-			m_width, m_height,                  // Image width/height
-			0,                                  // Always 0 (legacy)
-			m_dataFormat,                       // Texture source format
-			m_dataType,                         // Texture source datatype
-			data);                              // Image data
+	auto& [width, height, channels] = m_faceSizes[i];
+	m_faces[i] = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, STBI_default);
+	if (!m_faces[i]) {
+		ruc::error("Texture could not decode: '{}'", facePath);
+	}
+}
 
-		// Clean resources
-		stbi_image_free(data);
+bool TextureCubemap::finishFaces()
+{
+	for (size_t i = 0; i < 6; ++i) {
+		if (!m_faces[i]) {
+			ruc::error("Texture cubemap is missing faces, left empty: '{}'", m_path);
+			return false;
+		}
+		if (m_faceSizes[i] != m_faceSizes[0]) {
+			ruc::error("Texture cubemap faces differ in size, left empty: '{}'", m_path);
+			return false;
+		}
+	}
+
+	auto [width, height, channels] = m_faceSizes[0];
+	init(width, height, channels);
+	m_uploadSize = static_cast<size_t>(width) * height * channels * 6;
+
+	// Move the faces into the upload ring, so the upload doesnt copy out of client memory
+	m_staging = UploadRing::the().allocate(m_uploadSize);
+	if (m_staging.valid()) {
+		size_t faceSize = m_uploadSize / 6;
+		for (size_t i = 0; i < 6; ++i) {
+			std::memcpy(m_staging.data + i * faceSize, m_faces[i], faceSize);
+			stbi_image_free(m_faces[i]);
+			m_faces[i] = nullptr;
+		}
+	}
+
+	return true;
+}
+
+void TextureCubemap::createImpl()
+{
+	m_id = UINT_MAX;
+
+	// Create texture object
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_id);
+
+	// Allocate all 6 faces, with the whole mip chain
+	glTextureStorage2D(
+		m_id,
+		std::bit_width(std::max(m_width, m_height)), // Mipmap levels
+		m_internalFormat,                            // Internal format
+		m_width, m_height);                          // Image width/height
+
+	// Set unpacking of pixel data to byte-alignment,
+	// this prevents alignment issues when using a single byte for color
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	uint32_t faceSize = static_cast<uint32_t>(m_uploadSize / 6);
+	for (uint32_t i = 0; i < 6; ++i) {
+		// Upload texture face, out of the upload ring if that is bound
+		const void* data = m_staging.valid() ? m_staging.pointer(i * faceSize) : m_faces[i];
+		glTextureSubImage3D(
+			m_id,
+			0,                    // Midmap level, base starts at level 0
+			0, 0, i,              // Offset, the face is the layer
+			m_width, m_height, 1, // Image width/height
+			m_dataFormat,         // Texture source format
+			m_dataType,           // Texture source datatype
+			data);                // Image data
 	}
 
 	// Set the texture wrapping / filtering options
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);    // Magnify
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);    // Minify
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // X
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Y
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE); // Z
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);               // Magnify
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Minify
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);            // X
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);            // Y
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);            // Z
 
-	// Unbind texture object
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	// Automatically generate all mipmap levels
+	glGenerateTextureMipmap(m_id);
+}
+
+void TextureCubemap::createCompressedImpl()
+{
+	m_id = UINT_MAX;
+
+	// Create texture object
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_id);
+
+	// Allocate the whole mip chain, which is then filled in without any conversion
+	glTextureStorage2D(
+		m_id,
+		static_cast<GLsizei>(m_levels.size()), // Mipmap levels
+		m_internalFormat,                      // Texture format, compressed
+		m_width, m_height);                    // Image width/height
+
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	// Upload every level, the six faces of a level are the layers of one call
+	if (m_staging.valid()) {
+		UploadRing::the().bind();
+	}
+	m_compressedSize = 0;
+	for (uint32_t level = 0; level < m_levels.size(); ++level) {
+		const auto& data = m_levels[level].data;
+		glCompressedTextureSubImage3D(
+			m_id,
+			static_cast<GLint>(level),
+			0, 0, 0, m_levels[level].width, m_levels[level].height, 6,
+			m_internalFormat,
+			static_cast<GLsizei>(data.size()),
+			m_staging.valid() ? m_staging.pointer(static_cast<uint32_t>(m_compressedSize)) : data.data());
+		m_compressedSize += data.size();
+	}
+	if (m_staging.valid()) {
+		UploadRing::the().unbind();
+		UploadRing::the().submit(m_staging);
+		m_staging = {};
+	}
+}
+
+void TextureCubemap::createEquirectangularImpl()
+{
+	// Source image, only needed while the faces are drawn
+	uint32_t source = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &source);
+	glTextureStorage2D(source, 1, GL_RGB32F, m_equirectangularWidth, m_equirectangularHeight);
+	glTextureParameteri(source, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(source, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(source, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(source, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (m_staging.valid()) {
+		UploadRing::the().bind();
+		glTextureSubImage2D(source, 0, 0, 0, m_equirectangularWidth, m_equirectangularHeight, GL_RGB, GL_FLOAT, m_staging.pointer());
+		UploadRing::the().unbind();
+		UploadRing::the().submit(m_staging);
+		m_staging = {};
+	}
+	else {
+		glTextureSubImage2D(source, 0, 0, 0, m_equirectangularWidth, m_equirectangularHeight, GL_RGB, GL_FLOAT, m_equirectangular);
+		stbi_image_free(m_equirectangular);
+		m_equirectangular = nullptr;
+	}
+
+	m_id = UINT_MAX;
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_id);
+	glTextureStorage2D(m_id, std::bit_width(m_width), m_internalFormat, m_width, m_height);
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	// One invocation per texel of every face, in groups of 8x8
+	auto shader = AssetManager::the().load<Shader>("assets/glsl/equirectangular-to-cubemap");
+	shader->bind();
+	glBindTextureUnit(0, source);
+	glBindImageTexture(0, m_id, 0, GL_TRUE, 0, GL_WRITE_ONLY, m_internalFormat);
+	glDispatchCompute((m_width + 7) / 8, (m_height + 7) / 8, 6);
+	shader->unbind();
+
+	// The faces are sampled from here on, the smaller levels are generated from them
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	glGenerateTextureMipmap(m_id);
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, m_internalFormat);
+	glBindTextureUnit(0, 0);
+	glDeleteTextures(1, &source);
 }
 
 // -----------------------------------------
@@ -314,27 +1299,17 @@ void TextureFramebuffer::createImpl()
 	m_id = UINT_MAX;
 
 	// Create texture object
-	glGenTextures(1, &m_id);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
 
-	// Bind texture object
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	// Allocate immutable storage, the size and format can no longer change
+	glTextureStorage2D(
+		m_id,
+		1,                  // Mipmap levels
+		m_internalFormat,   // Texture format, must be sized
+		m_width, m_height); // Image width/height
 
-	// Generate texture
-	glTexImage2D(
-		GL_TEXTURE_2D,     // Texture target
-		0,                 // Midmap level, base starts at level 0
-		m_internalFormat,  // Texture format
-		m_width, m_height, // Image width/height
-		0,                 // Always 0 (legacy)
-		m_dataFormat,      // Texture source format
-		m_dataType,        // Texture source datatype
-		NULL);             // Image data
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	// Unbind texture object
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
 } // namespace Inferno
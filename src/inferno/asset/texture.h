@@ -6,13 +6,24 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef> // size_t
 #include <cstdint> // uint8_t, uint32_t
-#include <memory>  // std::shared_ptr
+#include <memory>  // std::enable_shared_from_this, std::shared_ptr, std::weak_ptr
+#include <optional>
+#include <span>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "glad/glad.h"
 
 #include "inferno/asset/asset-manager.h"
+#include "inferno/io/bcn.h"
+#include "inferno/io/file-system.h"
+#include "inferno/io/ktx2.h"
+#include "inferno/render/upload-ring.h"
 
 struct aiTexture;
 
@@ -37,6 +48,9 @@ public:
 	uint32_t internalFormat() const { return m_internalFormat; }
 	uint32_t dataFormat() const { return m_dataFormat; }
 	uint32_t dataType() const { return m_dataType; }
+	uint32_t bytesPerPixel() const;
+
+	virtual size_t gpuSize() const override;
 
 	virtual bool isTexture2D() const override { return false; }
 	virtual bool isTextureCubemap() const override { return false; }
@@ -62,37 +76,134 @@ private:
 
 // -------------------------------------
 
-class Texture2D final : public Texture {
+class Texture2D final
+	: public Texture
+	, public std::enable_shared_from_this<Texture2D> {
 public:
-	virtual ~Texture2D() = default;
+	virtual ~Texture2D();
 
 	// Factory function
 	static std::shared_ptr<Texture2D> create(std::string_view path);
-	static std::shared_ptr<Texture2D> create(aiTexture* texture);
+	static std::shared_ptr<Texture2D> create(const aiTexture* texture);
+	static std::shared_ptr<Texture2D> create(std::string_view path, std::span<const uint8_t> encoded); // Image file in memory
+	static std::shared_ptr<Texture2D> create(
+		std::string_view path,
+		uint32_t width, uint32_t height, uint32_t internalFormat, uint32_t dataFormat);
+
+	// Pending texture, that is not ready until decode() and upload() have run
+	static std::shared_ptr<Texture2D> createAsync(std::string_view path);
+	static std::shared_ptr<Texture2D> createAsync(const aiTexture* texture);
+	static std::shared_ptr<Texture2D> createAsync(std::string_view path, std::span<const uint8_t> encoded); // Image file in memory
+	static std::shared_ptr<Texture2D> createAsync(std::string_view path, FileData cooked);                  // KTX2 file in memory
+
+	// Block-compress an image with its mip chain, written to path + ".ktx2". Without a
+	// format, opaque images use BC1 and images with transparency BC7
+	static bool cook(std::string_view path, std::optional<BCn::Format> format = {});
+	// Block-compress an image file in memory, returns the KTX2 file or nothing if it can't be decoded
+	static std::vector<uint8_t> cook(std::span<const uint8_t> encoded, std::optional<BCn::Format> format = {});
+
+	virtual void decode() override;
+	virtual void upload() override;
+	virtual size_t uploadSize() const override { return m_uploadSize; }
+	// Image file in memory that the texture is decoded from, empty after decode()
+	std::span<const uint8_t> encoded() const { return m_encoded; }
+	virtual size_t gpuSize() const override;
+	virtual size_t sharedSize() const override;
 
 	virtual void bind(uint32_t unit = 0) const override;
 	virtual void unbind() const override;
 
+	// Upload a region of the texture, rowLength is the width of the source data in pixels
+	void update(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t rowLength, const void* data);
+
+	// Levels up to this size are uploaded with a cooked texture, the larger ones are streamed
+	static constexpr uint32_t streamTailSize = 128;
+
+	bool streamed() const { return m_shared ? m_shared->streamed() : m_streamId != 0; }
+	// Size the texture is drawn at on screen this frame, in pixels
+	void requestSize(float pixels);
+
 private:
+	friend class TextureStreamer;
+
 	Texture2D(std::string_view path)
 		: Texture(path)
 	{
 	}
 
-	void createImpl(unsigned char* data);
+	bool decodeCompressed(FileData file);
+	void createImpl(const void* data);
+	void createCompressedImpl();
+	void createStorageImpl();
+	// Use the GPU texture of an already uploaded texture with the same content
+	bool share();
+
+	uint32_t tailLevel() const;
+	// Data is an offset into the upload ring, if that is bound
+	void uploadLevel(uint32_t level, const void* data, size_t size);
+	// Move the levels from storageLevel on into a new texture object, to grow or shrink the mip chain
+	void reallocate(uint32_t storageLevel);
 
 	virtual bool isTexture2D() const override { return true; }
+
+private:
+	std::vector<uint8_t> m_encoded; // Image file to decode from, instead of the path
+	unsigned char* m_pixels { nullptr };
+	UploadRange m_staging;          // The decoded pixels, instead of m_pixels if the ring had room
+	size_t m_uploadSize { 0 };
+	bool m_mipmapped { false };
+
+	// Cooked block-compressed mip chain, pointing into the file. Set before decode()
+	// for a cooked file in memory
+	FileData m_file;
+	std::vector<KTX2::Level> m_levels;
+	size_t m_compressedSize { 0 };
+
+	// Hash of the decoded pixels, or of the file for cooked textures
+	uint64_t m_contentHash { 0 };
+	std::shared_ptr<Texture2D> m_shared;
+
+	// Uploaded textures on their content hash, main thread only
+	static std::unordered_map<uint64_t, std::weak_ptr<Texture2D>> s_contents;
+
+	// Streaming, in levels of the file. The GL texture holds the levels from the
+	// storage level on, sampling is clamped to the resident level
+	uint64_t m_streamId { 0 };
+	uint32_t m_storageLevel { 0 };
+	uint32_t m_residentLevel { 0 };
+	uint32_t m_wantedLevel { UINT32_MAX };
+	float m_drawnSize { 0.0f };
+	uint32_t m_hiddenFrames { 0 };
+	bool m_reading { false };
 };
 
 // -------------------------------------
 
-class TextureCubemap final : public Texture {
+class TextureCubemap final
+	: public Texture
+	, public std::enable_shared_from_this<TextureCubemap> {
 public:
-	virtual ~TextureCubemap() = default;
+	virtual ~TextureCubemap();
 
 	// Factory function
 	static std::shared_ptr<TextureCubemap> create(std::string_view path);
 
+	// Pending cubemap, that is not ready until decode() and upload() have run
+	static std::shared_ptr<TextureCubemap> createAsync(std::string_view path);
+
+	// Block-compress the six -px/-nx/.. face images with their mip chains, written to
+	// path + ".ktx2". Without a format, opaque faces use BC1 and transparent ones BC7
+	static bool cook(std::string_view path, std::optional<BCn::Format> format = {});
+
+	// Sources, tried in this order:
+	// - path + ".ktx2" or a .ktx2 path, block-compressed cubemap with its mip chain
+	// - .hdr path, equirectangular image that is projected onto the faces on the GPU
+	// - path with -px/-nx/.. before the extension, one image per face
+	virtual void decode() override;
+	virtual void upload() override;
+	virtual size_t uploadSize() const override { return m_uploadSize; }
+	virtual size_t gpuSize() const override;
+
 	virtual void bind(uint32_t unit = 0) const override;
 	virtual void unbind() const override;
 
@@ -102,9 +213,35 @@ private:
 	{
 	}
 
+	bool decodeCompressed();
+	void decodeEquirectangular();
+	void decodeFaces();
+	void decodeFace(size_t i);
+	// Runs after the last face is decoded, returns false if the faces can't form a cubemap
+	bool finishFaces();
 	void createImpl();
+	void createCompressedImpl();
+	void createEquirectangularImpl();
 
 	virtual bool isTextureCubemap() const override { return true; }
+
+private:
+	std::array<unsigned char*, 6> m_faces {};           // +X, -X, +Y, -Y, +Z, -Z, nullptr if it failed
+	std::array<std::array<int, 3>, 6> m_faceSizes {};   // Width, height and channels
+	std::atomic<uint32_t> m_facesRemaining { 0 };       // Face tasks that are still decoding
+	bool m_synchronous { false };                       // Decode the faces on the calling thread
+	UploadRange m_staging;                              // The faces one after another, if the ring had room
+	size_t m_uploadSize { 0 };
+
+	// Cooked block-compressed mip chain, pointing into the file
+	FileData m_file;
+	std::vector<KTX2::Level> m_levels;
+	size_t m_compressedSize { 0 };
+
+	// Equirectangular RGB image, instead of the faces
+	float* m_equirectangular { nullptr };
+	uint32_t m_equirectangularWidth { 0 };
+	uint32_t m_equirectangularHeight { 0 };
 };
 
 // -----------------------------------------
@@ -6,6 +6,7 @@
 
 #include "ruc/json/json.h"
 
+#include "inferno/asset/asset-manager.h"
 #include "inferno/asset/texture.h"
 #include "inferno/component/cubemap-component.h"
 #include "inferno/component/serialize.h" // not detected as used by clang-tidy
@@ -20,7 +21,7 @@ void fromJson(const ruc::Json& json, CubemapComponent& value)
 		json.at("color").getTo(value.color);
 	}
 	if (json.exists("texture") && json.at("texture").type() == ruc::Json::Type::String) {
-		value.texture = AssetManager::the().load<TextureCubemap>(json.at("texture").asString());
+		value.texture = AssetManager::the().loadHandle<TextureCubemap>(json.at("texture").asString());
 	}
 	if (json.exists("isLight")) {
 		json.at("isLight").getTo(value.isLight);
@@ -5,6 +5,9 @@
  */
 
 #include "inferno/component/model-component.h"
+
+#include "ruc/format/log.h"
+
 #include "inferno/asset/asset-manager.h"
 #include "inferno/asset/model.h"
 #include "inferno/asset/texture.h"
@@ -20,10 +23,29 @@ void fromJson(const ruc::Json& json, ModelComponent& value)
 		json.at("color").getTo(value.color);
 	}
 	if (json.exists("model") && json.at("model").type() == ruc::Json::Type::String) {
-		value.model = AssetManager::the().load<Model>(json.at("model").asString());
+		value.model = AssetManager::the().loadHandle<Model>(json.at("model").asString());
 	}
 	if (json.exists("texture") && json.at("texture").type() == ruc::Json::Type::String) {
-		value.texture = AssetManager::the().load<Texture2D>(json.at("texture").asString());
+		value.texture = AssetManager::the().loadHandle<Texture2D>(json.at("texture").asString());
+	}
+	if (json.exists("residency") && json.at("residency").type() == ruc::Json::Type::String) {
+		const auto& residency = json.at("residency").asString();
+		if (residency == "gpu") {
+			value.residency = MeshResidency::GPU;
+		}
+		else if (residency == "cpu+gpu") {
+			value.residency = MeshResidency::CPUAndGPU;
+		}
+		else if (residency == "cpu") {
+			value.residency = MeshResidency::CPU;
+		}
+		else {
+			ruc::warn("unknown model residency: {}", residency);
+		}
+	}
+
+	if (value.residency && value.model.valid()) {
+		AssetManager::the().load<Model>(value.model.id())->requestResidency(*value.residency);
 	}
 }
 
@@ -6,10 +6,11 @@
 
 #pragma once
 
-#include <memory> // std::shared_ptr
+#include <optional>
 
 #include "ruc/json/json.h"
 
+#include "inferno/asset/asset-manager.h"
 #include "inferno/asset/model.h"
 #include "inferno/asset/texture.h"
 
@@ -17,8 +18,10 @@ namespace Inferno {
 
 struct ModelComponent {
 	glm::vec4 color { 1.0f };
-	std::shared_ptr<Model> model;
-	std::shared_ptr<Texture2D> texture;
+	AssetHandle<Model> model;
+	AssetHandle<Texture2D> texture;
+	// Requested from the model when the component is loaded, see Model::requestResidency
+	std::optional<MeshResidency> residency;
 };
 
 void fromJson(const ruc::Json& json, ModelComponent& value);
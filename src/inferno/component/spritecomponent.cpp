@@ -21,7 +21,7 @@ void fromJson(const ruc::Json& json, SpriteComponent& value)
 		json.at("color").getTo(value.color);
 	}
 	if (json.exists("texture") && json.at("texture").type() == ruc::Json::Type::String) {
-		value.texture = AssetManager::the().load<Texture2D>(json.at("texture").asString());
+		value.texture = AssetManager::the().loadHandle<Texture2D>(json.at("texture").asString());
 	}
 }
 
@@ -6,18 +6,17 @@
 
 #pragma once
 
-#include <memory> // std::shared_ptr
-
 #include "glm/ext/vector_float4.hpp" // glm::vec4
 #include "ruc/json/json.h"
 
+#include "inferno/asset/asset-manager.h"
 #include "inferno/asset/texture.h"
 
 namespace Inferno {
 
 struct SpriteComponent {
 	glm::vec4 color { 1.0f };
-	std::shared_ptr<Texture> texture;
+	AssetHandle<Texture> texture;
 };
 
 void fromJson(const ruc::Json& json, SpriteComponent& value);
@@ -4,6 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm> // std::clamp
+#include <cmath>     // std::asin, std::atan2
+
+#include "glm/ext/matrix_float4x4.hpp" // glm::mat4
+#include "glm/ext/vector_float3.hpp"   // glm::vec3
+#include "glm/geometric.hpp"           // glm::length
+#include "glm/trigonometric.hpp"       // glm::degrees
 #include "ruc/format/format.h"
 #include "ruc/json/json.h"
 
@@ -27,6 +34,21 @@ void fromJson(const ruc::Json& json, TransformComponent& value)
 	}
 }
 
+void fromMatrix(const glm::mat4& matrix, TransformComponent& value)
+{
+	value.translate = glm::vec3(matrix[3]);
+	value.scale = { glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) };
+
+	// Rotation = Rx * Ry * Rz, the order that TransformSystem applies it in
+	glm::vec3 x = glm::vec3(matrix[0]) / value.scale.x;
+	glm::vec3 y = glm::vec3(matrix[1]) / value.scale.y;
+	glm::vec3 z = glm::vec3(matrix[2]) / value.scale.z;
+	value.rotate = glm::degrees(glm::vec3(
+		std::atan2(-z.y, z.z),
+		std::asin(std::clamp(z.x, -1.0f, 1.0f)),
+		std::atan2(-y.x, x.x)));
+}
+
 } // namespace Inferno
 
 void ruc::format::Formatter<Inferno::TransformComponent>::format(Builder& builder, Inferno::TransformComponent value) const
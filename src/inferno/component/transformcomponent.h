@@ -25,6 +25,8 @@ struct TransformComponent {
 };
 
 void fromJson(const ruc::Json& json, TransformComponent& value);
+// Split a matrix into translate, rotate and scale, shear is lost
+void fromMatrix(const glm::mat4& matrix, TransformComponent& value);
 
 } // namespace Inferno
 
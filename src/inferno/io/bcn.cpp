@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::clamp, std::max, std::min, std::swap
+#include <array>
+#include <cmath>  // std::lround, std::sqrt
+#include <limits> // std::numeric_limits
+
+#include "ruc/meta/assert.h"
+
+#include "inferno/io/bcn.h"
+
+namespace Inferno::BCn {
+
+using Block = std::array<std::array<uint8_t, 4>, 16>; // RGBA, row by row
+
+static Block fetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY)
+{
+	Block block;
+	for (uint32_t y = 0; y < 4; ++y) {
+		for (uint32_t x = 0; x < 4; ++x) {
+			uint32_t pixelX = std::min(blockX * 4 + x, width - 1);
+			uint32_t pixelY = std::min(blockY * 4 + y, height - 1);
+			const uint8_t* pixel = pixels + (static_cast<size_t>(pixelY) * width + pixelX) * 4;
+			block[y * 4 + x] = { pixel[0], pixel[1], pixel[2], pixel[3] };
+		}
+	}
+
+	return block;
+}
+
+// Line through the block colors that fits them best, the endpoints are picked on it
+static void fitLine(const Block& block, uint32_t channels, float* mean, float* axis)
+{
+	for (uint32_t c = 0; c < channels; ++c) {
+		mean[c] = 0.0f;
+		for (const auto& pixel : block) {
+			mean[c] += pixel[c];
+		}
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (const auto& pixel : block) {
+		for (uint32_t i = 0; i < channels; ++i) {
+			for (uint32_t j = 0; j < channels; ++j) {
+				covariance[i][j] += (pixel[i] - mean[i]) * (pixel[j] - mean[j]);
+			}
+		}
+	}
+
+	// Power iteration converges on the principal axis
+	for (uint32_t c = 0; c < channels; ++c) {
+		axis[c] = 1.0f;
+	}
+	for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t i = 0; i < channels; ++i) {
+			for (uint32_t j = 0; j < channels; ++j) {
+				next[i] += covariance[i][j] * axis[j];
+			}
+			length += next[i] * next[i];
+		}
+		if (length < std::numeric_limits<float>::epsilon()) {
+			break;
+		}
+		length = std::sqrt(length);
+		for (uint32_t c = 0; c < channels; ++c) {
+			axis[c] = next[c] / length;
+		}
+	}
+}
+
+static void projectRange(const Block& block, uint32_t channels, const float* mean, const float* axis, float& minimum, float& maximum)
+{
+	minimum = std::numeric_limits<float>::max();
+	maximum = std::numeric_limits<float>::lowest();
+	for (const auto& pixel : block) {
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; ++c) {
+			t += (pixel[c] - mean[c]) * axis[c];
+		}
+		minimum = std::min(minimum, t);
+		maximum = std::max(maximum, t);
+	}
+}
+
+static uint32_t nearest(const uint8_t* color, const uint8_t (*palette)[4], uint32_t paletteSize, uint32_t channels)
+{
+	uint32_t best = 0;
+	int32_t bestError = std::numeric_limits<int32_t>::max();
+	for (uint32_t i = 0; i < paletteSize; ++i) {
+		int32_t error = 0;
+		for (uint32_t c = 0; c < channels; ++c) {
+			int32_t difference = color[c] - palette[i][c];
+			error += difference * difference;
+		}
+		if (error < bestError) {
+			best = i;
+			bestError = error;
+		}
+	}
+
+	return best;
+}
+
+static void write(uint8_t* output, uint64_t value, uint32_t bytes)
+{
+	for (uint32_t i = 0; i < bytes; ++i) {
+		output[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+// -----------------------------------------
+
+static uint16_t pack565(const float* color)
+{
+	auto quantize = [](float value, uint32_t maximum) {
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 255.0f) * maximum / 255.0f));
+	};
+	return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+}
+
+static void unpack565(uint16_t value, uint8_t* color)
+{
+	uint8_t r = (value >> 11) & 0x1f;
+	uint8_t g = (value >> 5) & 0x3f;
+	uint8_t b = value & 0x1f;
+	color[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+	color[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+	color[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+	color[3] = 255;
+}
+
+// BC1 color block, always in the 4 color mode so it can also be used in BC3
+static void encodeColor(const Block& block, uint8_t* output)
+{
+	float mean[4];
+	float axis[4];
+	float minimum;
+	float maximum;
+	fitLine(block, 3, mean, axis);
+	projectRange(block, 3, mean, axis, minimum, maximum);
+
+	// Pull the endpoints in a bit, the extremes are rarely the best fit
+	float inset = (maximum - minimum) / 16.0f;
+	float endpoints[2][3];
+	for (uint32_t c = 0; c < 3; ++c) {
+		endpoints[0][c] = mean[c] + axis[c] * (maximum - inset);
+		endpoints[1][c] = mean[c] + axis[c] * (minimum + inset);
+	}
+
+	uint16_t color0 = pack565(endpoints[0]);
+	uint16_t color1 = pack565(endpoints[1]);
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		uint8_t palette[4][4];
+		unpack565(color0, palette[0]);
+		unpack565(color1, palette[1]);
+		for (uint32_t c = 0; c < 4; ++c) {
+			palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+			palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+		}
+		for (uint32_t i = 0; i < 16; ++i) {
+			indices |= nearest(block[i].data(), palette, 4, 3) << (i * 2);
+		}
+	}
+
+	write(output, color0, 2);
+	write(output + 2, color1, 2);
+	write(output + 4, indices, 4);
+}
+
+// BC4 single channel block, in the 8 value mode
+static void encodeChannel(const Block& block, uint32_t channel, uint8_t* output)
+{
+	uint8_t maximum = 0;
+	uint8_t minimum = 255;
+	for (const auto& pixel : block) {
+		maximum = std::max(maximum, pixel[channel]);
+		minimum = std::min(minimum, pixel[channel]);
+	}
+
+	uint64_t indices = 0;
+	if (maximum != minimum) {
+		int32_t range = maximum - minimum;
+		for (uint32_t i = 0; i < 16; ++i) {
+			// Step 0 is the maximum and step 7 the minimum, the in between values are index 2-7
+			int32_t step = ((maximum - block[i][channel]) * 7 + range / 2) / range;
+			uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+			indices |= index << (i * 3);
+		}
+	}
+
+	output[0] = maximum;
+	output[1] = minimum;
+	write(output + 2, indices, 6);
+}
+
+// BC7 mode 6, a single RGBA line with 7 bit endpoints, a p-bit each and 4 bit indices
+static void encodeBC7(const Block& block, uint8_t* output)
+{
+	static constexpr uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float mean[4];
+	float axis[4];
+	float minimum;
+	float maximum;
+	fitLine(block, 4, mean, axis);
+	projectRange(block, 4, mean, axis, minimum, maximum);
+
+	uint8_t endpoints[2][4]; // 7 bits
+	uint8_t pbits[2];
+	for (uint32_t e = 0; e < 2; ++e) {
+		float t = e == 0 ? minimum : maximum;
+
+		// Try both p-bits, which is the lowest bit of every channel
+		int32_t bestError = std::numeric_limits<int32_t>::max();
+		for (uint8_t pbit = 0; pbit < 2; ++pbit) {
+			uint8_t quantized[4];
+			int32_t error = 0;
+			for (uint32_t c = 0; c < 4; ++c) {
+				float value = std::clamp(mean[c] + axis[c] * t, 0.0f, 255.0f);
+				quantized[c] = static_cast<uint8_t>(std::clamp(std::lround((value - pbit) / 2.0f), 0l, 127l));
+				int32_t difference = static_cast<int32_t>(std::lround(value)) - ((quantized[c] << 1) | pbit);
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				bestError = error;
+				pbits[e] = pbit;
+				std::copy(quantized, quantized + 4, endpoints[e]);
+			}
+		}
+	}
+
+	uint8_t palette[16][4];
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			uint32_t e0 = (endpoints[0][c] << 1) | pbits[0];
+			uint32_t e1 = (endpoints[1][c] << 1) | pbits[1];
+			palette[i][c] = static_cast<uint8_t>(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+		}
+	}
+
+	uint8_t indices[16];
+	for (uint32_t i = 0; i < 16; ++i) {
+		indices[i] = static_cast<uint8_t>(nearest(block[i].data(), palette, 16, 4));
+	}
+
+	// The highest bit of the first index is implied to be 0, swap the endpoints to make it so
+	if (indices[0] & 8) {
+		std::swap(endpoints[0], endpoints[1]);
+		std::swap(pbits[0], pbits[1]);
+		for (auto& index : indices) {
+			index = 15 - index;
+		}
+	}
+
+	uint64_t bits[2] = {};
+	uint32_t position = 0;
+	auto append = [&](uint64_t value, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i, ++position) {
+			bits[position / 64] |= ((value >> i) & 1) << (position % 64);
+		}
+	};
+
+	append(1 << 6, 7); // Mode 6
+	for (uint32_t c = 0; c < 4; ++c) {
+		append(endpoints[0][c], 7);
+		append(endpoints[1][c], 7);
+	}
+	append(pbits[0], 1);
+	append(pbits[1], 1);
+	append(indices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i) {
+		append(indices[i], 4);
+	}
+	VERIFY(position == 128);
+
+	write(output, bits[0], 8);
+	write(output + 8, bits[1], 8);
+}
+
+// -----------------------------------------
+
+size_t blockSize(Format format)
+{
+	return format == Format::BC1 ? 8 : 16;
+}
+
+size_t size(Format format, uint32_t width, uint32_t height)
+{
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+std::vector<uint8_t> encode(Format format, const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> result(size(format, width, height));
+
+	uint8_t* output = result.data();
+	for (uint32_t blockY = 0; blockY < (height + 3) / 4; ++blockY) {
+		for (uint32_t blockX = 0; blockX < (width + 3) / 4; ++blockX) {
+			Block block = fetchBlock(pixels, width, height, blockX, blockY);
+
+			switch (format) {
+			case Format::BC1:
+				encodeColor(block, output);
+				break;
+			case Format::BC3:
+				encodeChannel(block, 3, output);
+				encodeColor(block, output + 8);
+				break;
+			case Format::BC5:
+				encodeChannel(block, 0, output);
+				encodeChannel(block, 1, output + 8);
+				break;
+			case Format::BC7:
+				encodeBC7(block, output);
+				break;
+			};
+
+			output += blockSize(format);
+		}
+	}
+
+	return result;
+}
+
+} // namespace Inferno::BCn
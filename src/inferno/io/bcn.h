@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
+#include <vector>
+
+// Block compression encoders, every 4x4 block of pixels is stored in 8 or 16 bytes
+// https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html#S3TC
+
+namespace Inferno::BCn {
+
+enum class Format : uint8_t {
+	BC1, // RGB, 4 bits per pixel
+	BC3, // RGBA, 8 bits per pixel
+	BC5, // RG, 8 bits per pixel, for normal maps
+	BC7, // RGBA, 8 bits per pixel, higher quality than BC3
+};
+
+size_t blockSize(Format format);
+size_t size(Format format, uint32_t width, uint32_t height);
+
+// Encode tightly packed RGBA8 pixels, partial blocks at the edges repeat the last row/column
+std::vector<uint8_t> encode(Format format, const uint8_t* pixels, uint32_t width, uint32_t height);
+
+} // namespace Inferno::BCn
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <memory> // std::shared_ptr
+#include <mutex>  // std::unique_lock
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <sys/stat.h> // stat
+#include <vector>
+
+#include "ruc/format/log.h"
+
+#include "inferno/io/file-system.h"
+#include "inferno/io/mapped-file.h"
+#include "inferno/io/pak.h"
+
+namespace Inferno {
+
+static thread_local std::vector<std::string>* s_reads = nullptr;
+
+FileSystem::FileSystem(s)
+{
+	if (auto archive = Pak::open(defaultArchive)) {
+		m_archives.push_back(archive);
+		ruc::info("FileSystem mounted '{}', {} files", defaultArchive, archive->size());
+	}
+}
+
+FileSystem::~FileSystem()
+{
+}
+
+bool FileSystem::mount(std::string_view path)
+{
+	auto archive = Pak::open(path);
+	if (!archive) {
+		ruc::warn("FileSystem could not mount: '{}'", path);
+		return false;
+	}
+
+	std::unique_lock lock(m_mutex);
+	m_archives.push_back(archive);
+	ruc::info("FileSystem mounted '{}', {} files", path, archive->size());
+
+	return true;
+}
+
+void FileSystem::unmountAll()
+{
+	std::unique_lock lock(m_mutex);
+	m_archives.clear();
+}
+
+bool FileSystem::exists(std::string_view path)
+{
+	{
+		std::shared_lock lock(m_mutex);
+		for (auto it = m_archives.rbegin(); it != m_archives.rend(); ++it) {
+			if ((*it)->find(path) != nullptr) {
+				return true;
+			}
+		}
+	}
+
+	struct stat status;
+	return stat(std::string(path).c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
+
+void FileSystem::recordReads(std::vector<std::string>* files)
+{
+	s_reads = files;
+}
+
+FileData FileSystem::read(std::string_view path)
+{
+	if (s_reads) {
+		s_reads->push_back(std::string(path));
+	}
+
+	{
+		std::shared_lock lock(m_mutex);
+		for (auto it = m_archives.rbegin(); it != m_archives.rend(); ++it) {
+			if (auto file = (*it)->read(path); file.valid()) {
+				return file;
+			}
+		}
+	}
+
+	auto file = MappedFile::create(path);
+	if (!file) {
+		return {};
+	}
+
+	return FileData({ file->data(), file->size() }, file);
+}
+
+} // namespace Inferno
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uintptr_t
+#include <memory>  // std::shared_ptr
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility> // std::move
+#include <vector>
+
+#include "ruc/meta/assert.h"
+#include "ruc/singleton.h"
+
+namespace Inferno {
+
+class Pak;
+
+// Contents of a file, mapped from disk or from an archive, or decompressed into
+// memory. The memory stays valid for as long as a copy of this object exists.
+class FileData {
+public:
+	FileData() = default;
+	FileData(std::span<const uint8_t> data, std::shared_ptr<const void> owner)
+		: m_data(data)
+		, m_owner(std::move(owner))
+	{
+	}
+
+	bool valid() const { return m_owner != nullptr; }
+	const uint8_t* data() const { return m_data.data(); }
+	size_t size() const { return m_data.size(); }
+	std::span<const uint8_t> bytes() const { return m_data; }
+	std::string_view string() const { return { reinterpret_cast<const char*>(m_data.data()), m_data.size() }; }
+	// Part of the file, that keeps the whole file alive
+	FileData slice(size_t offset, size_t size) const { return { m_data.subspan(offset, size), m_owner }; }
+
+	// Array of trivially copyable values, stored at offset bytes into the file
+	template<typename T>
+	std::span<const T> span(size_t offset, size_t count) const
+	{
+		VERIFY(offset + count * sizeof(T) <= m_data.size(), "file read out of bounds: {}/{}", offset + count * sizeof(T), m_data.size());
+		VERIFY(reinterpret_cast<uintptr_t>(m_data.data() + offset) % alignof(T) == 0, "file read is misaligned: {}", offset);
+		return { reinterpret_cast<const T*>(m_data.data() + offset), count };
+	}
+
+private:
+	std::span<const uint8_t> m_data;
+	std::shared_ptr<const void> m_owner;
+};
+
+// -----------------------------------------
+
+// Virtual file layer, files are looked up in the mounted archives first, the
+// most recently mounted one first, and then on disk
+class FileSystem final : public ruc::Singleton<FileSystem> {
+public:
+	// Mounted on startup, when it exists
+	static constexpr const char* defaultArchive = "assets.pak";
+
+	FileSystem(s);
+	virtual ~FileSystem();
+
+	bool mount(std::string_view path);
+	// Only read loose files from here on
+	void unmountAll();
+
+	bool exists(std::string_view path);
+	// Returns an invalid FileData if the file is not found
+	FileData read(std::string_view path);
+
+	// Append the paths that the calling thread reads to files, found or not, until
+	// it is called with nullptr. Used by the build to find the inputs of a conversion
+	void recordReads(std::vector<std::string>* files);
+
+private:
+	std::shared_mutex m_mutex;
+	std::vector<std::shared_ptr<Pak>> m_archives;
+};
+
+} // namespace Inferno
@@ -1,108 +1,287 @@
 /*
- * Copyright (C) 2022 Riyyi
+ * Copyright (C) 2022,2024 Riyyi
  *
  * SPDX-License-Identifier: MIT
  */
 
-#include <cstring> // strcmp ??
-#include <fstream> // std::ifstream
-#include <ios>     // std::ios
+#include <algorithm> // std::max, std::min
+#include <cstddef>   // size_t
+#include <cstdint>   // int8_t, int16_t, uint8_t, uint16_t, uint32_t
+#include <cstring>   // std::memcpy
+#include <iterator>  // std::size
+#include <memory>    // std::shared_ptr
+#include <span>
+#include <string>
+#include <string_view>
 
-#include "ruc/file.h"
+#include "ruc/format/log.h"
+#include "ruc/json/json.h"
 #include "ruc/meta/assert.h"
 
+#include "inferno/io/file-system.h"
 #include "inferno/io/gltffile.h"
-#include "inferno/util/json.h"
 
 namespace Inferno {
 
-std::pair<std::shared_ptr<char[]>, std::shared_ptr<char[]>> GltfFile::read(const std::string& path)
+static constexpr const uint32_t glbMagic = 0x46546c67;       // "glTF"
+static constexpr const uint32_t glbChunkJson = 0x4e4f534a;   // "JSON"
+static constexpr const uint32_t glbChunkBinary = 0x004e4942; // "BIN"
+
+template<typename T>
+static T load(const uint8_t* data)
 {
-	std::string extension = path.substr(path.find_first_of("."));
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+static uint32_t componentSize(uint32_t componentType)
+{
+	switch (componentType) {
+	case GltfAccessor::Byte:
+	case GltfAccessor::UnsignedByte:
+		return 1;
+	case GltfAccessor::Short:
+	case GltfAccessor::UnsignedShort:
+		return 2;
+	case GltfAccessor::UnsignedInt:
+	case GltfAccessor::Float:
+		return 4;
+	default:
+		VERIFY_NOT_REACHED();
+		return 0;
+	};
+}
 
-	if (extension.compare(".glb") == 0) {
-		return glb(path);
+static uint32_t componentCount(std::string_view type)
+{
+	constexpr std::string_view types[] = { "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4" };
+	constexpr uint32_t counts[] = { 1, 2, 3, 4, 4, 9, 16 };
+	for (size_t i = 0; i < std::size(types); ++i) {
+		if (types[i] == type) {
+			return counts[i];
+		}
 	}
-	else if (extension.compare(".gltf") == 0) {
-		return { ruc::File::raw(path), nullptr };
+
+	VERIFY_NOT_REACHED();
+	return 0;
+}
+
+// -----------------------------------------
+
+void GltfAccessor::read(uint32_t index, float* values, uint32_t size) const
+{
+	VERIFY(index < count, "gltf accessor read out of bounds: {}/{}", index, count);
+
+	const uint8_t* element = data + static_cast<size_t>(index) * stride;
+	for (uint32_t i = 0; i < std::min(size, components); ++i) {
+		switch (componentType) {
+		case Byte:
+			values[i] = load<int8_t>(element + i);
+			values[i] = normalized ? std::max(values[i] / 127.0f, -1.0f) : values[i];
+			break;
+		case UnsignedByte:
+			values[i] = load<uint8_t>(element + i);
+			values[i] = normalized ? values[i] / 255.0f : values[i];
+			break;
+		case Short:
+			values[i] = load<int16_t>(element + i * 2);
+			values[i] = normalized ? std::max(values[i] / 32767.0f, -1.0f) : values[i];
+			break;
+		case UnsignedShort:
+			values[i] = load<uint16_t>(element + i * 2);
+			values[i] = normalized ? values[i] / 65535.0f : values[i];
+			break;
+		case UnsignedInt:
+			values[i] = static_cast<float>(load<uint32_t>(element + i * 4));
+			break;
+		case Float:
+			values[i] = load<float>(element + i * 4);
+			break;
+		default:
+			VERIFY_NOT_REACHED();
+		};
 	}
+}
+
+uint32_t GltfAccessor::index(uint32_t index) const
+{
+	VERIFY(index < count, "gltf accessor read out of bounds: {}/{}", index, count);
 
-	VERIFY(false, "GltfFile unknown file extension!");
-	return {};
+	const uint8_t* element = data + static_cast<size_t>(index) * stride;
+	switch (componentType) {
+	case UnsignedByte:
+		return load<uint8_t>(element);
+	case UnsignedShort:
+		return load<uint16_t>(element);
+	case UnsignedInt:
+		return load<uint32_t>(element);
+	default:
+		VERIFY_NOT_REACHED();
+		return 0;
+	};
 }
 
-std::pair<std::shared_ptr<char[]>, std::shared_ptr<char[]>> GltfFile::glb(const std::string& path)
+// -----------------------------------------
+
+std::shared_ptr<GltfFile> GltfFile::read(std::string_view path)
 {
-	// Create input stream object and open file
-	std::ifstream glb(path, std::ios::in | std::ios::binary);
-	VERIFY(glb.is_open(), "GltfFile could not open '{}'", path);
+	auto result = std::shared_ptr<GltfFile>(new GltfFile);
 
-	constexpr uint32_t size = 4;
-	constexpr uint32_t header = 12;
-	constexpr uint32_t json = 27; // Minimum valid glTF has an asset property with version specifier
+	// The file stays mapped, the accessors point into it
+	result->m_file = FileSystem::the().read(path);
+	if (!result->m_file.valid()) {
+		ruc::error("GltfFile could not read: '{}'", path);
+		return nullptr;
+	}
+
+	size_t slash = path.find_last_of('/');
+	result->m_directory = slash != std::string_view::npos ? std::string(path.substr(0, slash + 1)) : "";
+
+	if (path.ends_with(".glb")) {
+		if (!result->glb()) {
+			ruc::error("GltfFile invalid binary container: '{}'", path);
+			return nullptr;
+		}
+	}
+	else {
+		result->m_json = ruc::Json::parse(result->m_file.string());
+	}
 
-	// Get the actual length of the file
-	uint32_t length = static_cast<uint32_t>(ruc::File::length(path, glb));
-	VERIFY(length > header + json, "GltfFile too small to be valid '{}'", path);
+	if (result->m_json.type() != ruc::Json::Type::Object || !result->m_json.exists("asset")) {
+		ruc::error("GltfFile malformed: '{}'", path);
+		return nullptr;
+	}
 
-	// Read header
+	// External buffers are mapped as well, the first buffer of a .glb is its binary chunk
+	if (result->m_json.exists("buffers")) {
+		const auto& buffers = result->m_json.at("buffers").asArray();
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			const auto& buffer = buffers.at(i);
+			if (!buffer.exists("uri")) {
+				if (i != 0 || !result->m_binaryChunk.valid()) {
+					ruc::error("GltfFile buffer without data: {}, '{}'", i, path);
+					return nullptr;
+				}
+				result->m_buffers.push_back(result->m_binaryChunk);
+				continue;
+			}
 
-	char magic[size];
-	char version[size];
-	char fileLength[size];
+			const auto& uri = buffer.at("uri").asString();
+			if (uri.starts_with("data:")) {
+				ruc::warn("GltfFile embedded base64 buffers are not supported: '{}'", path);
+				return nullptr;
+			}
+			result->m_buffers.push_back(FileSystem::the().read(result->m_directory + uri));
+			if (!result->m_buffers.back().valid()) {
+				ruc::error("GltfFile could not read buffer: '{}'", uri);
+				return nullptr;
+			}
+		}
+	}
 
-	glb.read(magic, size);
-	glb.seekg(size * 1);
-	glb.read(version, size);
-	glb.seekg(size * 2);
-	glb.read(fileLength, size);
+	// Checked up front, so accessor() only has to handle the supported ones
+	if (result->m_json.exists("accessors")) {
+		const auto& accessors = result->m_json.at("accessors").asArray();
+		for (size_t i = 0; i < accessors.size(); ++i) {
+			if (accessors.at(i).exists("sparse") || !accessors.at(i).exists("bufferView")) {
+				ruc::warn("GltfFile sparse accessors and accessors without a buffer view are not supported: '{}'", path);
+				return nullptr;
+			}
+		}
+	}
 
-	// Validate header
+	return result;
+}
 
-	uint32_t magicInt = *reinterpret_cast<uint32_t*>(magic);
-	VERIFY(magicInt == 0x46546c67, "Gltf invalid header magic '{}'", magic);
+std::span<const uint8_t> GltfFile::bufferView(size_t index) const
+{
+	const auto& view = m_json.at("bufferViews").at(index);
+	size_t buffer = static_cast<size_t>(view.at("buffer").asDouble());
+	size_t offset = view.exists("byteOffset") ? static_cast<size_t>(view.at("byteOffset").asDouble()) : 0;
+	size_t length = static_cast<size_t>(view.at("byteLength").asDouble());
 
-	uint32_t versionInt = *reinterpret_cast<uint32_t*>(version);
-	VERIFY(versionInt == 2, "Gltf unsupported version '{}'", versionInt);
+	VERIFY(buffer < m_buffers.size(), "GltfFile buffer out of bounds: {}/{}", buffer, m_buffers.size());
+	VERIFY(offset + length <= m_buffers[buffer].size(), "GltfFile buffer view out of bounds: {}/{}", offset + length, m_buffers[buffer].size());
+	return m_buffers[buffer].bytes().subspan(offset, length);
+}
 
-	uint32_t fileLengthInt = *reinterpret_cast<uint32_t*>(fileLength);
-	VERIFY(fileLengthInt == static_cast<uint32_t>(length), "Gltf file and reported byte size mismatch '{}' '{}'", length, fileLengthInt);
+GltfAccessor GltfFile::accessor(size_t index) const
+{
+	const auto& json = m_json.at("accessors").at(index);
+	VERIFY(!json.exists("sparse") && json.exists("bufferView"), "GltfFile unsupported accessor: {}", index);
 
-	// Read JSON data
-	auto jsonChunk = readChunk(glb, header, 0x4e4f534a);
-	VERIFY(jsonChunk.second >= json, "Gltf file invalid JSON content length '{}'", jsonChunk.second);
+	GltfAccessor result;
+	result.count = static_cast<uint32_t>(json.at("count").asDouble());
+	result.components = componentCount(json.at("type").asString());
+	result.componentType = static_cast<uint32_t>(json.at("componentType").asDouble());
+	result.normalized = json.exists("normalized") && json.at("normalized").asBool();
 
-	// Read binary data
-	auto binaryChunk = readChunk(glb, header + size * 2 + jsonChunk.second, 0x004e4942);
+	// Elements are tightly packed, unless the buffer view has a stride
+	size_t viewIndex = static_cast<size_t>(json.at("bufferView").asDouble());
+	const auto& view = m_json.at("bufferViews").at(viewIndex);
+	uint32_t elementSize = result.components * componentSize(result.componentType);
+	result.stride = view.exists("byteStride") ? static_cast<uint32_t>(view.at("byteStride").asDouble()) : elementSize;
 
-	glb.close();
+	auto data = bufferView(viewIndex);
+	size_t offset = json.exists("byteOffset") ? static_cast<size_t>(json.at("byteOffset").asDouble()) : 0;
+	if (result.count > 0) {
+		size_t end = offset + static_cast<size_t>(result.count - 1) * result.stride + elementSize;
+		VERIFY(end <= data.size(), "GltfFile accessor out of bounds: {}/{}", end, data.size());
+	}
+	result.data = data.data() + offset;
 
-	return { jsonChunk.first, binaryChunk.first };
+	return result;
 }
 
-std::pair<std::shared_ptr<char[]>, uint32_t> GltfFile::readChunk(std::ifstream& ifstream, uint32_t offset, uint32_t type)
+// -----------------------------------------
+
+bool GltfFile::glb()
 {
-	constexpr uint32_t size = 4;
+	constexpr uint32_t header = 12;
+	constexpr uint32_t chunkHeader = 8;
+
+	auto data = m_file.bytes();
+	if (data.size() < header + chunkHeader) {
+		return false;
+	}
 
-	char chunkLength[size];
-	char chunkType[size];
+	// Validate header
+	if (load<uint32_t>(data.data()) != glbMagic) {
+		return false;
+	}
+	uint32_t version = load<uint32_t>(data.data() + 4);
+	if (version != 2) {
+		return false;
+	}
+	uint32_t length = load<uint32_t>(data.data() + 8);
+	if (length > data.size()) {
+		return false;
+	}
 
-	ifstream.seekg(offset);
-	ifstream.read(chunkLength, size);
-	ifstream.seekg(offset + size * 1);
-	ifstream.read(chunkType, size);
+	// Chunks follow each other, the JSON chunk comes first and the binary chunk is optional
+	size_t offset = header;
+	while (offset + chunkHeader <= length) {
+		uint32_t chunkLength = load<uint32_t>(data.data() + offset);
+		uint32_t chunkType = load<uint32_t>(data.data() + offset + 4);
+		offset += chunkHeader;
+		if (offset + chunkLength > length) {
+			return false;
+		}
 
-	uint32_t chunkTypeInt = *reinterpret_cast<uint32_t*>(chunkType);
-	VERIFY(chunkTypeInt == type, "Gltf invalid chunk type '{}' != '{:#08x}'", chunkType, type);
+		auto chunk = m_file.slice(offset, chunkLength);
+		if (chunkType == glbChunkJson && m_json.type() == ruc::Json::Type::Null) {
+			// Parsed straight out of the mapped file
+			m_json = ruc::Json::parse(chunk.string());
+		}
+		else if (chunkType == glbChunkBinary && !m_binaryChunk.valid()) {
+			m_binaryChunk = chunk;
+		}
 
-	uint32_t chunkLengthInt = *reinterpret_cast<uint32_t*>(chunkLength);
-	// Allocate memory filled with zeros
-	std::shared_ptr<char[]> chunkData(new char[chunkLengthInt + 1]);
-	ifstream.seekg(offset + size * 2);
-	ifstream.read(chunkData.get(), chunkLengthInt);
-	chunkData.get()[chunkLengthInt] = '\0';
+		offset += chunkLength;
+	}
 
-	return { chunkData, chunkLengthInt };
+	return m_json.type() == ruc::Json::Type::Object;
 }
 
 } // namespace Inferno
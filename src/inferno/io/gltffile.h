@@ -1,25 +1,91 @@
 /*
- * Copyright (C) 2022 Riyyi
+ * Copyright (C) 2022,2024 Riyyi
  *
  * SPDX-License-Identifier: MIT
  */
 
 #pragma once
 
-#include <cstdint> // uint32_t
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
 #include <memory>  // std::shared_ptr
-#include <string>  // std::string
-#include <utility> // std::pair
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ruc/json/json.h"
+
+#include "inferno/io/file-system.h"
+
+// glTF 2.0 scene, as .gltf with its buffers next to it or as a single .glb
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html
 
 namespace Inferno {
 
-class GltfFile {
+// Typed view of a buffer, pointing into the file
+struct GltfAccessor {
+	enum ComponentType : uint32_t {
+		Byte = 5120,
+		UnsignedByte = 5121,
+		Short = 5122,
+		UnsignedShort = 5123,
+		UnsignedInt = 5125,
+		Float = 5126,
+	};
+
+	const uint8_t* data { nullptr }; // First element
+	uint32_t count { 0 };
+	uint32_t stride { 0 };     // Bytes from one element to the next
+	uint32_t components { 0 }; // SCALAR 1, VEC2 2, VEC3 3, VEC4 4, MAT4 16
+	uint32_t componentType { 0 };
+	bool normalized { false };
+
+	// Element converted to floats, at most size components are written
+	void read(uint32_t index, float* values, uint32_t size) const;
+	// Element of an index accessor
+	uint32_t index(uint32_t index) const;
+};
+
+class GltfFile final {
 public:
-	static std::pair<std::shared_ptr<char[]>, std::shared_ptr<char[]>> read(const std::string& path);
+	// Returns nullptr if the file could not be read, or uses features that are not
+	// supported: embedded base64 buffers, sparse accessors and accessors without a buffer view
+	static std::shared_ptr<GltfFile> read(std::string_view path);
+
+	const ruc::Json& json() const { return m_json; }
+	// Directory that the URIs of the file are relative to
+	const std::string& directory() const { return m_directory; }
+
+	std::span<const uint8_t> bufferView(size_t index) const;
+	GltfAccessor accessor(size_t index) const;
 
 private:
-	static std::pair<std::shared_ptr<char[]>, std::shared_ptr<char[]>> glb(const std::string& path);
-	static std::pair<std::shared_ptr<char[]>, uint32_t> readChunk(std::ifstream& ifstream, uint32_t offset, uint32_t type);
+	GltfFile() = default;
+
+	bool glb();
+
+private:
+	FileData m_file;
+	ruc::Json m_json;
+	std::string m_directory;
+
+	FileData m_binaryChunk; // Buffer 0 of a .glb
+	std::vector<FileData> m_buffers;
 };
 
 } // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+auto gltf = GltfFile::read("assets/gfx/model.glb");
+auto positions = gltf->accessor(static_cast<size_t>(primitive.at("attributes").at("POSITION").asDouble()));
+for (uint32_t i = 0; i < positions.count; ++i) {
+	float position[3];
+	positions.read(i, position, 3);
+}
+
+#endif
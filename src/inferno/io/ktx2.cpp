@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::max
+#include <cstring>   // std::memcmp, std::memcpy
+#include <fstream>   // std::ofstream
+#include <string>
+
+#include "ruc/format/log.h"
+
+#include "inferno/io/ktx2.h"
+
+namespace Inferno::KTX2 {
+
+static constexpr uint8_t identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+struct Header {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+// Data format descriptor, describes how the channels are laid out in a block
+static std::vector<uint32_t> createDescriptor(BCn::Format format)
+{
+	struct Sample {
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t channel;
+	};
+
+	// Color models and channel IDs from the Khronos data format specification
+	uint32_t colorModel = 0;
+	std::vector<Sample> samples;
+	switch (format) {
+	case BCn::Format::BC1:
+		colorModel = 128;
+		samples = { { 0, 64, 0 } };
+		break;
+	case BCn::Format::BC3:
+		colorModel = 130;
+		samples = { { 0, 64, 15 }, { 64, 64, 0 } };
+		break;
+	case BCn::Format::BC5:
+		colorModel = 132;
+		samples = { { 0, 64, 0 }, { 64, 64, 1 } };
+		break;
+	case BCn::Format::BC7:
+		colorModel = 134;
+		samples = { { 0, 128, 0 } };
+		break;
+	};
+
+	uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+	std::vector<uint32_t> words = {
+		4 + blockSize,                                 // Total size
+		0,                                             // Vendor ID, descriptor type
+		2 | (blockSize << 16),                         // Version, block size
+		colorModel | (1 << 8) | (1 << 16),             // BT.709 primaries, linear transfer
+		3 | (3 << 8),                                  // 4x4 texel block
+		static_cast<uint32_t>(BCn::blockSize(format)), // Bytes per plane
+		0,
+	};
+	for (const auto& sample : samples) {
+		words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+		words.push_back(0);          // Sample position
+		words.push_back(0);          // Lower
+		words.push_back(0xffffffff); // Upper
+	}
+
+	return words;
+}
+
+// -----------------------------------------
+
+uint32_t vkFormat(BCn::Format format)
+{
+	switch (format) {
+	case BCn::Format::BC1:
+		return BC1_RGB_UNORM;
+	case BCn::Format::BC3:
+		return BC3_UNORM;
+	case BCn::Format::BC5:
+		return BC5_UNORM;
+	case BCn::Format::BC7:
+		return BC7_UNORM;
+	};
+
+	return 0;
+}
+
+bool parse(std::span<const uint8_t> data, Image& image)
+{
+	if (data.size() < sizeof(Header) || std::memcmp(data.data(), identifier, sizeof(identifier)) != 0) {
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(Header));
+
+	// Only plain 2D images and cubemaps with their mip chain stored, without supercompression
+	if (header.pixelDepth > 0 || header.layerCount > 1 || header.levelCount == 0
+	    || header.supercompressionScheme != 0 || (header.faceCount != 1 && header.faceCount != 6)) {
+		return false;
+	}
+	if (sizeof(Header) + header.levelCount * sizeof(LevelIndex) > data.size()) {
+		return false;
+	}
+
+	image.vkFormat = header.vkFormat;
+	image.width = header.pixelWidth;
+	image.height = header.pixelHeight;
+	image.faceCount = header.faceCount;
+	image.levels.clear();
+
+	for (uint32_t i = 0; i < header.levelCount; ++i) {
+		LevelIndex index;
+		std::memcpy(&index, data.data() + sizeof(Header) + i * sizeof(LevelIndex), sizeof(LevelIndex));
+		if (index.byteOffset + index.byteLength > data.size()) {
+			return false;
+		}
+
+		image.levels.push_back({
+			.data = data.subspan(index.byteOffset, index.byteLength),
+			.width = std::max(1u, header.pixelWidth >> i),
+			.height = std::max(1u, header.pixelHeight >> i),
+		});
+	}
+
+	return true;
+}
+
+std::vector<uint8_t> encode(BCn::Format format, uint32_t width, uint32_t height, uint32_t faceCount, std::span<const std::vector<uint8_t>> levels)
+{
+	auto align = [](uint64_t offset, uint64_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); };
+
+	auto descriptor = createDescriptor(format);
+
+	Header header {};
+	std::memcpy(header.identifier, identifier, sizeof(identifier));
+	header.vkFormat = vkFormat(format);
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = faceCount;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levels.size() * sizeof(LevelIndex));
+	header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+	// The level data is stored smallest first, so a streamed file can start with the mip tail
+	std::vector<LevelIndex> indices(levels.size());
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	for (size_t i = levels.size(); i-- > 0;) {
+		offset = align(offset, 16);
+		indices[i] = { offset, levels[i].size(), levels[i].size() };
+		offset += levels[i].size();
+	}
+
+	std::vector<uint8_t> data(offset, 0);
+	std::memcpy(data.data(), &header, sizeof(Header));
+	std::memcpy(data.data() + sizeof(Header), indices.data(), indices.size() * sizeof(LevelIndex));
+	std::memcpy(data.data() + header.dfdByteOffset, descriptor.data(), header.dfdByteLength);
+	for (size_t i = 0; i < levels.size(); ++i) {
+		std::memcpy(data.data() + indices[i].byteOffset, levels[i].data(), levels[i].size());
+	}
+
+	return data;
+}
+
+bool write(std::string_view path, BCn::Format format, uint32_t width, uint32_t height, uint32_t faceCount, std::span<const std::vector<uint8_t>> levels)
+{
+	auto data = encode(format, width, height, faceCount, levels);
+
+	std::string output(path);
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+		ruc::error("KTX2 could not write: '{}'", output);
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace Inferno::KTX2
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint8_t, uint32_t
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "inferno/io/bcn.h"
+
+// Khronos texture container, for block-compressed images with their mip chain
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+
+namespace Inferno::KTX2 {
+
+// VkFormat values of the supported block-compressed formats
+enum VkFormat : uint32_t {
+	BC1_RGB_UNORM = 131,
+	BC3_UNORM = 137,
+	BC5_UNORM = 141,
+	BC7_UNORM = 145,
+};
+
+struct Level {
+	std::span<const uint8_t> data; // The faces of a cubemap follow each other
+	uint32_t width { 0 };
+	uint32_t height { 0 };
+};
+
+struct Image {
+	uint32_t vkFormat { 0 };
+	uint32_t width { 0 };
+	uint32_t height { 0 };
+	uint32_t faceCount { 1 };
+	std::vector<Level> levels; // Largest first
+};
+
+uint32_t vkFormat(BCn::Format format);
+
+// Returns false if the file is not a KTX2 file that can be used as is, the image
+// points into the file data
+bool parse(std::span<const uint8_t> data, Image& image);
+
+// Levels are ordered largest first, with the faces of a cubemap one after another
+std::vector<uint8_t> encode(BCn::Format format, uint32_t width, uint32_t height, uint32_t faceCount, std::span<const std::vector<uint8_t>> levels);
+// Encoded file written to path
+bool write(std::string_view path, BCn::Format format, uint32_t width, uint32_t height, uint32_t faceCount, std::span<const std::vector<uint8_t>> levels);
+
+} // namespace Inferno::KTX2
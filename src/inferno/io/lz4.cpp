@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::min
+#include <cstring>   // std::memcpy
+
+#include "inferno/io/lz4.h"
+
+namespace Inferno::LZ4 {
+
+static constexpr const size_t minMatch = 4;
+static constexpr const size_t lastLiterals = 5;  // The last bytes of a block are always literals
+static constexpr const size_t matchLimit = 12;   // The last match starts at least this far from the end
+static constexpr const size_t maxOffset = 65535;
+static constexpr const uint32_t hashLog = 12;
+
+static uint32_t read32(const uint8_t* data)
+{
+	uint32_t value;
+	std::memcpy(&value, data, sizeof(uint32_t));
+	return value;
+}
+
+static uint32_t hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - hashLog);
+}
+
+static void writeLength(std::vector<uint8_t>& output, size_t length)
+{
+	while (length >= 255) {
+		output.push_back(255);
+		length -= 255;
+	}
+	output.push_back(static_cast<uint8_t>(length));
+}
+
+static bool readLength(std::span<const uint8_t> source, size_t& index, size_t& length)
+{
+	uint8_t byte = 0;
+	do {
+		if (index >= source.size()) {
+			return false;
+		}
+		byte = source[index++];
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+// -----------------------------------------
+
+std::vector<uint8_t> compress(std::span<const uint8_t> source)
+{
+	std::vector<uint8_t> output;
+	output.reserve(source.size() + source.size() / 255 + 16);
+
+	const uint8_t* input = source.data();
+	size_t size = source.size();
+	size_t anchor = 0;
+
+	auto writeSequence = [&](size_t literalLength, size_t matchLength, size_t offset) {
+		uint8_t token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+		if (matchLength > 0) {
+			token |= static_cast<uint8_t>(std::min<size_t>(matchLength - minMatch, 15));
+		}
+		output.push_back(token);
+		if (literalLength >= 15) {
+			writeLength(output, literalLength - 15);
+		}
+		output.insert(output.end(), input + anchor, input + anchor + literalLength);
+
+		// The last sequence only has literals
+		if (matchLength == 0) {
+			return;
+		}
+		output.push_back(static_cast<uint8_t>(offset & 0xff));
+		output.push_back(static_cast<uint8_t>(offset >> 8));
+		if (matchLength - minMatch >= 15) {
+			writeLength(output, matchLength - minMatch - 15);
+		}
+	};
+
+	if (size > matchLimit) {
+		// Position + 1 of the last occurrence of each hashed 4-byte sequence, 0 is empty
+		std::vector<uint32_t> table(1 << hashLog, 0);
+
+		size_t position = 0;
+		while (position < size - matchLimit) {
+			uint32_t sequence = read32(input + position);
+			uint32_t& entry = table[hash(sequence)];
+			size_t candidate = entry;
+			entry = static_cast<uint32_t>(position + 1);
+
+			if (candidate == 0 || position - (candidate - 1) > maxOffset || read32(input + candidate - 1) != sequence) {
+				position++;
+				continue;
+			}
+			candidate--;
+
+			size_t matchLength = minMatch;
+			while (position + matchLength < size - lastLiterals && input[candidate + matchLength] == input[position + matchLength]) {
+				matchLength++;
+			}
+
+			writeSequence(position - anchor, matchLength, position - candidate);
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	writeSequence(size - anchor, 0, 0);
+
+	return output;
+}
+
+bool decompress(std::span<const uint8_t> source, std::span<uint8_t> destination)
+{
+	size_t in = 0;
+	size_t out = 0;
+
+	while (in < source.size()) {
+		uint8_t token = source[in++];
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(source, in, literalLength)) {
+			return false;
+		}
+		if (in + literalLength > source.size() || out + literalLength > destination.size()) {
+			return false;
+		}
+		if (literalLength > 0) {
+			std::memcpy(destination.data() + out, source.data() + in, literalLength);
+		}
+		in += literalLength;
+		out += literalLength;
+
+		// The last sequence ends after its literals
+		if (in == source.size()) {
+			break;
+		}
+
+		if (in + 2 > source.size()) {
+			return false;
+		}
+		size_t offset = source[in] | (source[in + 1] << 8);
+		in += 2;
+		if (offset == 0 || offset > out) {
+			return false;
+		}
+
+		size_t matchLength = token & 0x0f;
+		if (matchLength == 15 && !readLength(source, in, matchLength)) {
+			return false;
+		}
+		matchLength += minMatch;
+		if (out + matchLength > destination.size()) {
+			return false;
+		}
+
+		// The match may overlap the bytes it writes, so copy forward one byte at a time
+		uint8_t* match = destination.data() + out - offset;
+		for (size_t i = 0; i < matchLength; ++i) {
+			destination[out + i] = match[i];
+		}
+		out += matchLength;
+	}
+
+	return out == destination.size();
+}
+
+} // namespace Inferno::LZ4
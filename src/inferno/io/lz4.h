@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t
+#include <span>
+#include <vector>
+
+// LZ4 block format, without the frame around it
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+namespace Inferno::LZ4 {
+
+// Greedy single-pass compressor, the output is readable by any LZ4 block decoder
+std::vector<uint8_t> compress(std::span<const uint8_t> source);
+
+// Returns false if the block is malformed or does not decompress to exactly the destination size
+bool decompress(std::span<const uint8_t> source, std::span<uint8_t> destination);
+
+} // namespace Inferno::LZ4
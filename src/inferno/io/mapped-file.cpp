@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <fcntl.h>    // open
+#include <string>     // std::string
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+#include "inferno/io/mapped-file.h"
+
+namespace Inferno {
+
+MappedFile::~MappedFile()
+{
+	if (m_size > 0) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+}
+
+std::shared_ptr<MappedFile> MappedFile::create(std::string_view path)
+{
+	int fd = open(std::string(path).c_str(), O_RDONLY);
+	if (fd == -1) {
+		return nullptr;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) == -1) {
+		close(fd);
+		return nullptr;
+	}
+
+	// Empty files can not be mapped, but are valid files
+	if (status.st_size == 0) {
+		close(fd);
+		return std::shared_ptr<MappedFile>(new MappedFile(nullptr, 0));
+	}
+
+	size_t size = static_cast<size_t>(status.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+
+	return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const uint8_t*>(data), size));
+}
+
+} // namespace Inferno
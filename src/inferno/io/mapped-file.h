@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t
+#include <memory>  // std::shared_ptr
+#include <span>
+#include <string_view>
+
+#include "ruc/meta/assert.h"
+
+namespace Inferno {
+
+// Read-only view of a file, the operating system pages the contents in on first access
+class MappedFile final {
+public:
+	~MappedFile();
+
+	// Returns nullptr if the file could not be opened, an empty file has no data
+	static std::shared_ptr<MappedFile> create(std::string_view path);
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+	// Array of trivially copyable values, stored at offset bytes into the file
+	template<typename T>
+	std::span<const T> span(size_t offset, size_t count) const
+	{
+		VERIFY(offset + count * sizeof(T) <= m_size, "mapped file read out of bounds: {}/{}", offset + count * sizeof(T), m_size);
+		VERIFY(offset % alignof(T) == 0, "mapped file read is misaligned: {}", offset);
+		return { reinterpret_cast<const T*>(m_data + offset), count };
+	}
+
+private:
+	MappedFile(const uint8_t* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+	{
+	}
+
+	const uint8_t* m_data { nullptr };
+	size_t m_size { 0 };
+};
+
+} // namespace Inferno
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::lower_bound, std::sort
+#include <cstring>   // std::memcpy
+#include <fstream>   // std::ifstream, std::ofstream
+#include <iterator>  // std::istreambuf_iterator
+#include <vector>
+
+#include "ruc/format/log.h"
+
+#include "inferno/io/lz4.h"
+#include "inferno/io/mapped-file.h"
+#include "inferno/io/pak.h"
+
+namespace Inferno {
+
+std::shared_ptr<Pak> Pak::open(std::string_view path)
+{
+	auto file = MappedFile::create(path);
+	if (!file || file->size() < sizeof(PakHeader)) {
+		return nullptr;
+	}
+
+	const PakHeader& header = file->span<PakHeader>(0, 1).front();
+	PakHeader current;
+	if (header.magic != current.magic || header.version != current.version) {
+		ruc::warn("Pak invalid or outdated archive: '{}'", path);
+		return nullptr;
+	}
+	if (header.indexOffset + header.entryCount * sizeof(PakEntry) > file->size() || header.namesOffset > file->size()) {
+		ruc::warn("Pak truncated archive: '{}'", path);
+		return nullptr;
+	}
+
+	auto result = std::shared_ptr<Pak>(new Pak(file));
+	result->m_entries = file->span<PakEntry>(header.indexOffset, header.entryCount);
+	result->m_names = { reinterpret_cast<const char*>(file->data() + header.namesOffset), file->size() - header.namesOffset };
+
+	for (const auto& entry : result->m_entries) {
+		if (entry.offset + entry.size > file->size() || entry.nameOffset + entry.nameLength > result->m_names.size()) {
+			ruc::warn("Pak corrupt index: '{}'", path);
+			return nullptr;
+		}
+	}
+
+	return result;
+}
+
+bool Pak::write(std::string_view path, std::span<const std::string> files, bool compress)
+{
+	auto align = [](uint64_t offset, uint64_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); };
+
+	std::vector<uint8_t> data(sizeof(PakHeader), 0);
+	std::vector<PakEntry> entries;
+	std::string names;
+	size_t compressedCount = 0;
+
+	for (const auto& file : files) {
+		std::ifstream stream(file, std::ios::binary);
+		if (!stream) {
+			ruc::error("Pak could not read: '{}'", file);
+			return false;
+		}
+		std::vector<uint8_t> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+		PakEntry entry;
+		std::string_view name = normalize(file);
+		entry.hash = hash(name);
+		entry.originalSize = static_cast<uint32_t>(contents.size());
+		entry.nameOffset = static_cast<uint32_t>(names.size());
+		entry.nameLength = static_cast<uint32_t>(name.size());
+		names.append(name);
+
+		if (compress) {
+			auto compressed = LZ4::compress(contents);
+			if (compressed.size() < contents.size()) {
+				contents = std::move(compressed);
+				entry.flags |= PakEntry::compressed;
+				compressedCount++;
+			}
+		}
+
+		entry.offset = align(data.size(), alignment);
+		entry.size = static_cast<uint32_t>(contents.size());
+		data.resize(entry.offset);
+		data.insert(data.end(), contents.begin(), contents.end());
+
+		entries.push_back(entry);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const PakEntry& a, const PakEntry& b) {
+		return a.hash < b.hash;
+	});
+
+	PakHeader header;
+	header.entryCount = static_cast<uint32_t>(entries.size());
+	header.indexOffset = align(data.size(), alignof(PakEntry));
+	header.namesOffset = header.indexOffset + entries.size() * sizeof(PakEntry);
+
+	data.resize(header.namesOffset + names.size(), 0);
+	std::memcpy(data.data(), &header, sizeof(PakHeader));
+	std::memcpy(data.data() + header.indexOffset, entries.data(), entries.size() * sizeof(PakEntry));
+	std::memcpy(data.data() + header.namesOffset, names.data(), names.size());
+
+	std::string output(path);
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+		ruc::error("Pak could not write: '{}'", output);
+		return false;
+	}
+
+	ruc::info("Pak written: '{}', {} files, {} compressed, {} bytes", output, entries.size(), compressedCount, data.size());
+	return true;
+}
+
+uint64_t Pak::hash(std::string_view path)
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (char character : path) {
+		hash ^= static_cast<uint8_t>(character);
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+const PakEntry* Pak::find(std::string_view path) const
+{
+	path = normalize(path);
+	uint64_t key = hash(path);
+
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, [](const PakEntry& entry, uint64_t key) {
+		return entry.hash < key;
+	});
+
+	// Compare the paths, in case two of them have the same hash
+	for (; it != m_entries.end() && it->hash == key; ++it) {
+		if (m_names.substr(it->nameOffset, it->nameLength) == path) {
+			return &*it;
+		}
+	}
+
+	return nullptr;
+}
+
+FileData Pak::read(std::string_view path) const
+{
+	const PakEntry* entry = find(path);
+	if (entry == nullptr) {
+		return {};
+	}
+
+	auto stored = m_file->span<uint8_t>(entry->offset, entry->size);
+	if ((entry->flags & PakEntry::compressed) == 0) {
+		return FileData(stored, m_file);
+	}
+
+	auto decompressed = std::make_shared<std::vector<uint8_t>>(entry->originalSize);
+	if (!LZ4::decompress(stored, *decompressed)) {
+		ruc::error("Pak corrupt file: '{}'", path);
+		return {};
+	}
+
+	return FileData(*decompressed, decompressed);
+}
+
+// -----------------------------------------
+
+std::string_view Pak::normalize(std::string_view path)
+{
+	while (path.starts_with("./")) {
+		path.remove_prefix(2);
+	}
+
+	return path;
+}
+
+} // namespace Inferno
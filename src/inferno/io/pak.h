@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <memory>  // std::shared_ptr
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "inferno/io/file-system.h"
+
+namespace Inferno {
+
+class MappedFile;
+
+// Asset archive (.pak), a header followed by the file contents, the index
+// sorted on the hash of the path and the paths themselves
+struct PakHeader {
+	static constexpr const uint32_t magicValue = 0x4b415049; // "IPAK"
+	static constexpr const uint32_t currentVersion = 1;
+
+	uint32_t magic { magicValue };
+	uint32_t version { currentVersion };
+	uint32_t entryCount { 0 };
+	uint32_t reserved { 0 };
+	uint64_t indexOffset { 0 };
+	uint64_t namesOffset { 0 };
+};
+
+struct PakEntry {
+	static constexpr const uint32_t compressed = 1 << 0; // LZ4 block
+
+	uint64_t hash { 0 };
+	uint64_t offset { 0 };
+	uint32_t size { 0 };         // Stored size
+	uint32_t originalSize { 0 }; // Size after decompression
+	uint32_t nameOffset { 0 };
+	uint32_t nameLength { 0 };
+	uint32_t flags { 0 };
+	uint32_t reserved { 0 };
+};
+
+// -------------------------------------
+
+// Memory mapped archive, uncompressed files are read in place
+class Pak final {
+public:
+	// File contents start on this boundary, so tables in them can be used straight from the mapping
+	static constexpr const uint32_t alignment = 16;
+
+	// Returns nullptr if the file is missing or not a valid archive
+	static std::shared_ptr<Pak> open(std::string_view path);
+
+	// Pack the files under the paths they are read from, compressed files are only
+	// stored compressed when that makes them smaller
+	static bool write(std::string_view path, std::span<const std::string> files, bool compress);
+
+	static uint64_t hash(std::string_view path);
+
+	// Returns nullptr if the archive has no file with this path
+	const PakEntry* find(std::string_view path) const;
+	// Returns an invalid FileData if the archive has no file with this path
+	FileData read(std::string_view path) const;
+
+	size_t size() const { return m_entries.size(); }
+
+private:
+	Pak(std::shared_ptr<MappedFile> file)
+		: m_file(std::move(file))
+	{
+	}
+
+	static std::string_view normalize(std::string_view path);
+
+private:
+	std::shared_ptr<MappedFile> m_file;
+	std::span<const PakEntry> m_entries; // Sorted on hash
+	std::string_view m_names;
+};
+
+} // namespace Inferno
@@ -290,6 +290,11 @@ void VertexBuffer::uploadData(const void* data, uint32_t size)
 	unbind();
 }
 
+void VertexBuffer::downloadData(void* data, uint32_t size) const
+{
+	glGetNamedBufferSubData(m_id, 0, size, data);
+}
+
 // -----------------------------------------
 
 IndexBuffer::IndexBuffer(uint32_t* indices, size_t size)
@@ -330,6 +335,12 @@ void IndexBuffer::uploadData(const void* data, uint32_t size)
 	unbind();
 }
 
+void IndexBuffer::downloadData(void* data, uint32_t size) const
+{
+	// Without binding, that would change the element buffer of the bound vertex array
+	glGetNamedBufferSubData(m_id, 0, size, data);
+}
+
 // -----------------------------------------
 
 VertexArray::VertexArray()
@@ -353,7 +364,7 @@ void VertexArray::unbind() const
 	glBindVertexArray(0);
 }
 
-void VertexArray::addVertexBuffer(std::shared_ptr<VertexBuffer> vertexBuffer)
+void VertexArray::addVertexBuffer(std::shared_ptr<VertexBuffer> vertexBuffer, uint32_t divisor)
 {
 	const auto& layout = vertexBuffer->layout();
 	VERIFY(layout.elements().size(), "VertexBuffer has no layout");
@@ -422,6 +433,10 @@ void VertexArray::addVertexBuffer(std::shared_ptr<VertexBuffer> vertexBuffer)
 			VERIFY_NOT_REACHED();
 		};
 
+		if (divisor != 0) {
+			glVertexAttribDivisor(index, divisor);
+		}
+
 		index++;
 	}
 
@@ -103,6 +103,8 @@ public:
 	void unbind() const;
 
 	void uploadData(const void* data, uint32_t size);
+	// Read the data back from the GPU
+	void downloadData(void* data, uint32_t size) const;
 
 	const BufferLayout& layout() const { return m_layout; }
 
@@ -125,6 +127,8 @@ public:
 	void unbind() const;
 
 	void uploadData(const void* data, uint32_t size);
+	// Read the data back from the GPU
+	void downloadData(void* data, uint32_t size) const;
 
 	uint32_t count() const { return m_count; }
 
@@ -144,7 +148,8 @@ public:
 	void bind() const;
 	void unbind() const;
 
-	void addVertexBuffer(std::shared_ptr<VertexBuffer> vertexBuffer);
+	// Divisor 0 advances the attributes per vertex, 1 per instance
+	void addVertexBuffer(std::shared_ptr<VertexBuffer> vertexBuffer, uint32_t divisor = 0);
 	void setIndexBuffer(std::shared_ptr<IndexBuffer> indexBuffer);
 
 	std::shared_ptr<VertexBuffer> at(size_t i) const { return m_vertexBuffers.at(i); }
@@ -6,6 +6,8 @@
 
 #include <cstddef> // size_t
 #include <cstdint> // uint8_t, uint32_t
+#include <memory>  // std::shared_ptr
+#include <vector>
 
 #include "glad/glad.h"
 #include "ruc/meta/assert.h"
@@ -27,6 +29,43 @@ std::shared_ptr<Framebuffer> Framebuffer::create(const Properties& properties)
 	return result;
 }
 
+std::shared_ptr<Framebuffer> Framebuffer::create(const std::vector<std::shared_ptr<TextureFramebuffer>>& textures)
+{
+	VERIFY(textures.size() > 0, "cant create a framebuffer without attachments");
+
+	auto result = std::shared_ptr<Framebuffer>(new Framebuffer({
+		.width = textures.front()->width(),
+		.height = textures.front()->height(),
+	}));
+
+	result->m_textures = textures;
+	result->attachTextures();
+
+	return result;
+}
+
+std::shared_ptr<TextureFramebuffer> Framebuffer::createTexture(Type type, uint32_t width, uint32_t height)
+{
+	switch (type) {
+	case Type::RGB8:
+		return TextureFramebuffer::create("", width, height, GL_RGB8, GL_RGB);
+	case Type::RGBA8:
+		return TextureFramebuffer::create("", width, height, GL_RGBA8, GL_RGBA);
+	case Type::RGBA16F:
+		return TextureFramebuffer::create("", width, height, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+	case Type::RGBA32F:
+		return TextureFramebuffer::create("", width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+	case Type::Depth24Stencil8:
+		return TextureFramebuffer::create("", width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+	case Type::Depth32F:
+		return TextureFramebuffer::create("", width, height, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+	default:
+		VERIFY_NOT_REACHED();
+	}
+
+	return nullptr;
+}
+
 Framebuffer::~Framebuffer()
 {
 	if (m_renderToScreen) {
@@ -38,10 +77,11 @@ Framebuffer::~Framebuffer()
 
 void Framebuffer::copyBuffer(std::shared_ptr<Framebuffer> from, std::shared_ptr<Framebuffer> to, uint32_t bits, uint32_t filter)
 {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, from->m_id);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
-	glBlitFramebuffer(0, 0, from->m_width, from->m_height, 0, 0, to->m_width, to->m_height, bits, filter);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// The id of the default framebuffer is 0
+	glBlitNamedFramebuffer(from->m_id, to->m_id,
+	                       0, 0, from->m_width, from->m_height,
+	                       0, 0, to->m_width, to->m_height,
+	                       bits, filter);
 }
 
 // -----------------------------------------
@@ -58,8 +98,8 @@ void Framebuffer::unbind() const
 
 bool Framebuffer::check() const
 {
-	VERIFY(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
-	       "malformed framebuffer: {:#x}", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	VERIFY(glCheckNamedFramebufferStatus(m_id, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+	       "malformed framebuffer: {:#x}", glCheckNamedFramebufferStatus(m_id, GL_FRAMEBUFFER));
 	return true;
 }
 
@@ -83,77 +123,44 @@ void Framebuffer::createTextures()
 		return;
 	}
 
-	if (m_id) {
-		glDeleteFramebuffers(1, &m_id);
-		m_textures.clear();
-	}
-
-	m_id = UINT_MAX;
-	glGenFramebuffers(1, &m_id);
-
-	bind();
-
-	auto it = m_attachments.begin();
-	m_colorAttachmentCount = 0;
-
 	size_t size = m_attachments.size();
 	m_textures.resize(size);
 	for (size_t i = 0; i < size; ++i) {
-		TypeProperties type = *(it + i);
+		m_textures[i] = createTexture(m_attachments[i].type, m_width, m_height);
+	}
 
-		if (type.type == Type::RGB8) {
-			// Set color attachment 0 out of 32
-			m_textures[i] = TextureFramebuffer::create("", m_width, m_height, GL_RGB8, GL_RGB);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + m_colorAttachmentCount, GL_TEXTURE_2D, m_textures[i]->id(), 0);
-			m_colorAttachmentCount++;
-			continue;
-		}
+	attachTextures();
+}
 
-		if (type.type == Type::RGBA8) { // Color
-			// Set color attachment 0 out of 32
-			m_textures[i] = TextureFramebuffer::create("", m_width, m_height, GL_RGBA8, GL_RGBA);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + m_colorAttachmentCount, GL_TEXTURE_2D, m_textures[i]->id(), 0);
-			m_colorAttachmentCount++;
-			continue;
-		}
+void Framebuffer::attachTextures()
+{
+	if (m_id) {
+		glDeleteFramebuffers(1, &m_id);
+	}
 
-		if (type.type == Type::RGBA16F) {
-			// Set color attachment 0 out of 32
-			m_textures[i] = TextureFramebuffer::create("", m_width, m_height, GL_RGBA16F, GL_RGBA, GL_FLOAT);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + m_colorAttachmentCount, GL_TEXTURE_2D, m_textures[i]->id(), 0);
-			m_colorAttachmentCount++;
-			continue;
-		}
+	m_id = UINT_MAX;
+	glCreateFramebuffers(1, &m_id);
 
-		if (type.type == Type::RGBA32F) {
+	m_colorAttachmentCount = 0;
+	for (const auto& texture : m_textures) {
+		switch (texture->internalFormat()) {
+		// This combined texture is required for older GPUs
+		case GL_DEPTH24_STENCIL8:
+			glNamedFramebufferTexture(m_id, GL_DEPTH_STENCIL_ATTACHMENT, texture->id(), 0);
+			break;
+		case GL_DEPTH_COMPONENT32F:
+			glNamedFramebufferTexture(m_id, GL_DEPTH_ATTACHMENT, texture->id(), 0);
+			break;
+		default:
 			// Set color attachment 0 out of 32
-			m_textures[i] = TextureFramebuffer::create("", m_width, m_height, GL_RGBA32F, GL_RGBA, GL_FLOAT);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + m_colorAttachmentCount, GL_TEXTURE_2D, m_textures[i]->id(), 0);
+			glNamedFramebufferTexture(m_id, GL_COLOR_ATTACHMENT0 + m_colorAttachmentCount, texture->id(), 0);
 			m_colorAttachmentCount++;
-			continue;
-		}
-
-		// This combined texture is required for older GPUs
-		if (type.type == Type::Depth24Stencil8) { // Depth
-			m_textures[i] = (TextureFramebuffer::create(
-				"", m_width, m_height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8));
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_textures[i]->id(), 0);
-			continue;
-		}
-
-		if (type.type == Type::Depth32F) {
-			//  FIXME: This isnt a 32-bit float texture
-			m_textures[i] = (TextureFramebuffer::create(
-				"", m_width, m_height, GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT));
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_textures[i]->id(), 0);
-			continue;
+			break;
 		}
 	}
 
 	VERIFY(m_colorAttachmentCount <= 32, "maximum color attachments was exceeded: {}/32", m_colorAttachmentCount);
 	check();
-
-	unbind();
 }
 
 } // namespace Inferno
@@ -7,7 +7,7 @@
 #pragma once
 
 #include <cstddef> // size_t
-#include <cstdint> // uint8_t
+#include <cstdint> // uint8_t, uint32_t
 #include <initializer_list>
 #include <memory> // std::shared_ptr
 #include <vector>
@@ -62,6 +62,8 @@ public:
 
 	// Factory function
 	static std::shared_ptr<Framebuffer> create(const Properties& properties);
+	static std::shared_ptr<Framebuffer> create(const std::vector<std::shared_ptr<TextureFramebuffer>>& textures);
+	static std::shared_ptr<TextureFramebuffer> createTexture(Type type, uint32_t width, uint32_t height);
 	static void copyBuffer(std::shared_ptr<Framebuffer> from, std::shared_ptr<Framebuffer> to, uint32_t bits, uint32_t filter);
 
 	void bind() const;
@@ -89,6 +91,7 @@ private:
 	{
 	}
 	void createTextures();
+	void attachTextures();
 
 private:
 	bool m_renderToScreen { false };
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstdint> // int32_t, uint32_t
+
+#include "glad/glad.h"
+
+#include "inferno/render/gpu-query.h"
+
+namespace Inferno {
+
+GpuQuery::GpuQuery(uint32_t target)
+	: m_target(target)
+{
+	glCreateQueries(m_target, queryCount, m_ids.data());
+}
+
+GpuQuery::~GpuQuery()
+{
+	glDeleteQueries(queryCount, m_ids.data());
+}
+
+// -----------------------------------------
+
+void GpuQuery::begin()
+{
+	poll();
+
+	// Skip a measurement rather than waiting on the GPU
+	if (m_pending == queryCount) {
+		return;
+	}
+
+	glBeginQuery(m_target, m_ids[m_next]);
+	m_active = true;
+}
+
+void GpuQuery::end()
+{
+	if (!m_active) {
+		return;
+	}
+
+	glEndQuery(m_target);
+	m_active = false;
+
+	m_next = (m_next + 1) % queryCount;
+	m_pending++;
+}
+
+bool GpuQuery::poll()
+{
+	bool updated = false;
+
+	// Queries finish in the order they were issued, oldest first
+	while (m_pending > 0) {
+		uint32_t id = m_ids[(m_next + queryCount - m_pending) % queryCount];
+
+		int32_t available = 0;
+		glGetQueryObjectiv(id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+
+		glGetQueryObjectui64v(id, GL_QUERY_RESULT, &m_result);
+		m_pending--;
+		updated = true;
+	}
+
+	return updated;
+}
+
+} // namespace Inferno
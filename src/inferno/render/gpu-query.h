@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint> // uint32_t, uint64_t
+
+namespace Inferno {
+
+// Ring of OpenGL query objects, results are read back a few frames later so
+// the CPU never has to stall waiting on the GPU
+class GpuQuery final {
+public:
+	static constexpr const uint32_t queryCount = 4;
+
+	GpuQuery(uint32_t target); // GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ..
+	~GpuQuery();
+
+	void begin();
+	void end();
+
+	// Read back finished queries, returns true if there is a new result
+	bool poll();
+
+	uint64_t result() const { return m_result; }
+	double milliseconds() const { return m_result / 1000000.0; } // GL_TIME_ELAPSED is in nanoseconds
+
+private:
+	uint32_t m_target { 0 };
+	bool m_active { false };
+	uint32_t m_next { 0 };    // Index of the next query to begin
+	uint32_t m_pending { 0 }; // Amount of queries that are waiting on the GPU
+	uint64_t m_result { 0 };
+	std::array<uint32_t, queryCount> m_ids {};
+};
+
+} // namespace Inferno
@@ -4,8 +4,9 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <cstdint> // int32_t, uint32_t
+#include <cstdint> // int32_t, uint32_t, uintptr_t
 #include <memory>  // std::shared_ptr
+#include <span>
 
 #include "glad/glad.h"
 #include "ruc/format/log.h"
@@ -24,6 +25,9 @@ void RenderCommand::initialize()
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_BLEND);
 
+	// Filter across the edges of cubemap faces, the smaller mip levels show seams otherwise
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
 	ruc::info("RenderCommand initialized");
 }
 
@@ -42,10 +46,23 @@ void RenderCommand::clearColor(const glm::vec4& color)
 	glClearColor(color.r, color.g, color.b, color.a);
 }
 
-void RenderCommand::drawIndexed(std::shared_ptr<VertexArray> vertexArray, uint32_t indexCount)
+void RenderCommand::drawIndexed(std::shared_ptr<VertexArray> vertexArray, uint32_t indexCount, uint32_t indexOffset)
 {
 	uint32_t count = indexCount ? indexCount : vertexArray->indexBuffer()->count();
-	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+	// The offset into the bound index buffer is passed as the pointer, in bytes
+	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(static_cast<uintptr_t>(indexOffset) * sizeof(uint32_t)));
+}
+
+void RenderCommand::multiDrawIndexed(std::shared_ptr<VertexArray>, std::span<const int32_t> indexCounts, std::span<const void* const> indexOffsets)
+{
+	VERIFY(indexCounts.size() == indexOffsets.size(), "index ranges mismatch: {}/{}", indexCounts.size(), indexOffsets.size());
+	glMultiDrawElements(GL_TRIANGLES, indexCounts.data(), GL_UNSIGNED_INT, indexOffsets.data(), static_cast<GLsizei>(indexCounts.size()));
+}
+
+void RenderCommand::drawInstanced(std::shared_ptr<VertexArray>, uint32_t vertexCount, uint32_t instanceCount)
+{
+	// Vertices are generated from gl_VertexID, as a triangle strip
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, vertexCount, instanceCount);
 }
 
 void RenderCommand::setViewport(int32_t x, int32_t y, uint32_t width, uint32_t height)
@@ -59,6 +76,23 @@ void RenderCommand::setDepthTest(bool enabled)
 	enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
 }
 
+void RenderCommand::setDepthFunc(uint32_t function)
+{
+	// GL_LESS, GL_LEQUAL, GL_EQUAL, ..
+	glDepthFunc(function);
+}
+
+void RenderCommand::setDepthMask(bool enabled)
+{
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void RenderCommand::setColorMask(bool enabled)
+{
+	GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+	glColorMask(mask, mask, mask, mask);
+}
+
 void RenderCommand::setColorAttachmentCount(uint32_t count)
 {
 	static constexpr uint32_t colorAttachments[] = {
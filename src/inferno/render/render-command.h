@@ -8,6 +8,7 @@
 
 #include <cstdint> // int32_t, uint32_t
 #include <memory>  // std::shadred_ptr
+#include <span>
 
 #include "glm/ext/vector_float4.hpp" // glm::vec4
 
@@ -22,10 +23,16 @@ public:
 
 	static void clearBit(uint32_t bits);
 	static void clearColor(const glm::vec4& color);
-	static void drawIndexed(std::shared_ptr<VertexArray> vertexArray, uint32_t indexCount = 0);
+	static void drawIndexed(std::shared_ptr<VertexArray> vertexArray, uint32_t indexCount = 0, uint32_t indexOffset = 0);
+	// Draws all the index ranges in one call, the offsets are in bytes into the bound index buffer
+	static void multiDrawIndexed(std::shared_ptr<VertexArray> vertexArray, std::span<const int32_t> indexCounts, std::span<const void* const> indexOffsets);
+	static void drawInstanced(std::shared_ptr<VertexArray> vertexArray, uint32_t vertexCount, uint32_t instanceCount);
 
 	static void setViewport(int32_t x, int32_t y, uint32_t width, uint32_t height);
 	static void setDepthTest(bool enabled);
+	static void setDepthFunc(uint32_t function);
+	static void setDepthMask(bool enabled);
+	static void setColorMask(bool enabled);
 	static void setColorAttachmentCount(uint32_t count);
 
 	static bool depthTest();
@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::find, std::find_if, std::for_each, std::max, std::min
+#include <cstdint>   // uint32_t, UINT32_MAX
+#include <memory>    // std::shared_ptr
+#include <string_view>
+#include <tuple>   // std::tie
+#include <utility> // std::move
+#include <vector>
+
+#include "glad/glad.h"
+#include "ruc/meta/assert.h"
+
+#include "inferno/asset/texture.h"
+#include "inferno/render/framebuffer.h"
+#include "inferno/render/render-command.h"
+#include "inferno/render/render-graph.h"
+
+namespace Inferno {
+
+bool RenderTargetDescription::operator<(const RenderTargetDescription& other) const
+{
+	return std::tie(width, height, format) < std::tie(other.width, other.height, other.format);
+}
+
+// -----------------------------------------
+
+std::shared_ptr<TextureFramebuffer> RenderTargetPool::acquire(const RenderTargetDescription& description)
+{
+	auto it = std::find_if(m_targets.begin(), m_targets.end(), [&description](const Target& target) {
+		return !target.inUse && target.description == description;
+	});
+
+	if (it == m_targets.end()) {
+		m_targets.push_back({
+			.description = description,
+			.texture = Framebuffer::createTexture(description.format, description.width, description.height),
+		});
+		it = m_targets.end() - 1;
+	}
+
+	it->inUse = true;
+	it->lastUsed = m_frame;
+
+	return it->texture;
+}
+
+void RenderTargetPool::release(std::shared_ptr<TextureFramebuffer> texture)
+{
+	auto it = std::find_if(m_targets.begin(), m_targets.end(), [&texture](const Target& target) {
+		return target.texture == texture;
+	});
+	VERIFY(it != m_targets.end(), "render target was not acquired from this pool");
+
+	it->inUse = false;
+}
+
+std::shared_ptr<Framebuffer> RenderTargetPool::framebuffer(const std::vector<std::shared_ptr<TextureFramebuffer>>& textures)
+{
+	std::vector<uint32_t> key;
+	key.reserve(textures.size());
+	for (const auto& texture : textures) {
+		key.push_back(texture->id());
+	}
+
+	auto it = m_framebuffers.find(key);
+	if (it != m_framebuffers.end()) {
+		return it->second;
+	}
+
+	auto framebuffer = Framebuffer::create(textures);
+	m_framebuffers.emplace(std::move(key), framebuffer);
+
+	return framebuffer;
+}
+
+void RenderTargetPool::nextFrame()
+{
+	m_frame++;
+
+	// Release targets that havent been used for a while, e.g. the old size after a resize
+	std::vector<uint32_t> evicted;
+	std::erase_if(m_targets, [this, &evicted](const Target& target) {
+		if (target.inUse || m_frame - target.lastUsed <= maxUnusedFrames) {
+			return false;
+		}
+		evicted.push_back(target.texture->id());
+		return true;
+	});
+
+	if (evicted.empty()) {
+		return;
+	}
+
+	// Along with every framebuffer they are attached to
+	std::erase_if(m_framebuffers, [&evicted](const auto& framebuffer) {
+		return std::find_if(framebuffer.first.begin(), framebuffer.first.end(), [&evicted](uint32_t id) {
+			       return std::find(evicted.begin(), evicted.end(), id) != evicted.end();
+		       })
+		       != framebuffer.first.end();
+	});
+}
+
+// -----------------------------------------
+
+RenderGraph::Resource RenderGraph::Builder::create(std::string_view name, const RenderTargetDescription& description)
+{
+	VERIFY(description.width > 0 && description.height > 0, "render target '{}' has no size", name);
+	VERIFY(description.format != Framebuffer::Type::None, "render target '{}' has no format", name);
+
+	m_graph.m_resources.push_back({
+		.name = std::string(name),
+		.description = description,
+	});
+
+	return static_cast<Resource>(m_graph.m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::Builder::read(Resource resource)
+{
+	VERIFY(resource < m_graph.m_resources.size(), "invalid render graph resource: {}", resource);
+
+	m_graph.m_passes[m_pass].reads.push_back(resource);
+	m_graph.m_resources[resource].readCount++;
+
+	return resource;
+}
+
+RenderGraph::Resource RenderGraph::Builder::write(Resource resource, LoadOp loadOp)
+{
+	VERIFY(resource < m_graph.m_resources.size(), "invalid render graph resource: {}", resource);
+
+	m_graph.m_passes[m_pass].writes.push_back(resource);
+	m_graph.m_passes[m_pass].loadOps.push_back(loadOp);
+	m_graph.m_resources[resource].writers.push_back(m_pass);
+
+	return resource;
+}
+
+RenderGraph::Resource RenderGraph::Builder::readDepth(Resource resource)
+{
+	read(resource);
+	m_graph.m_passes[m_pass].depthReads.push_back(resource);
+
+	return resource;
+}
+
+void RenderGraph::Builder::setClearColor(const glm::vec4& clearColor)
+{
+	m_graph.m_passes[m_pass].clearColor = clearColor;
+}
+
+void RenderGraph::Builder::setSideEffect()
+{
+	m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+// -----------------------------------------
+
+void RenderGraph::reset(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+
+	m_passes.clear();
+	m_resources.clear();
+
+	if (!m_screen) {
+		m_screen = Framebuffer::create(Framebuffer::Properties { .renderToScreen = true });
+	}
+	m_screen->resize(width, height);
+
+	// The screen color is presented, so it always counts as being read
+	m_resources.push_back({
+		.name = "ScreenColor",
+		.description = { width, height, Framebuffer::Type::Color },
+		.imported = true,
+		.readCount = 1,
+	});
+	m_resources.push_back({
+		.name = "ScreenDepth",
+		.description = { width, height, Framebuffer::Type::Depth },
+		.imported = true,
+	});
+}
+
+void RenderGraph::addPass(std::string_view name, const SetupFunction& setup, const ExecuteFunction& execute)
+{
+	m_passes.push_back({
+		.name = std::string(name),
+		.execute = execute,
+	});
+
+	Builder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+	setup(builder);
+}
+
+void RenderGraph::addBlitPass(std::string_view name, Resource from, Resource to, uint32_t bits, uint32_t filter)
+{
+	addPass(
+		name,
+		[from, to](Builder& builder) {
+			builder.read(from);
+			builder.write(to, LoadOp::DontCare);
+		},
+		nullptr);
+
+	PassNode& pass = m_passes.back();
+	pass.blit = true;
+	pass.blitBits = bits;
+	pass.blitFilter = filter;
+}
+
+void RenderGraph::compile()
+{
+	cull();
+	allocate();
+}
+
+void RenderGraph::execute()
+{
+	for (uint32_t i = 0; i < m_passes.size(); ++i) {
+		const PassNode& pass = m_passes[i];
+		if (culled(pass)) {
+			continue;
+		}
+
+		if (pass.blit) {
+			executeBlit(pass);
+			continue;
+		}
+
+		beginPass(i);
+		pass.execute(*this);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	RenderCommand::setColorAttachmentCount(1);
+	RenderCommand::setViewport(0, 0, m_width, m_height);
+
+	// Hand the transient targets back for the next frame, aliased targets are released more than once
+	for (auto& resource : m_resources) {
+		if (resource.texture) {
+			m_pool.release(resource.texture);
+			resource.texture = nullptr;
+		}
+	}
+	m_pool.nextFrame();
+}
+
+std::shared_ptr<TextureFramebuffer> RenderGraph::texture(Resource resource) const
+{
+	VERIFY(resource < m_resources.size(), "invalid render graph resource: {}", resource);
+	VERIFY(!m_resources[resource].imported, "imported resource '{}' has no texture", m_resources[resource].name);
+
+	return m_resources[resource].texture;
+}
+
+const RenderTargetDescription& RenderGraph::description(Resource resource) const
+{
+	VERIFY(resource < m_resources.size(), "invalid render graph resource: {}", resource);
+
+	return m_resources[resource].description;
+}
+
+// -----------------------------------------
+
+void RenderGraph::cull()
+{
+	for (auto& pass : m_passes) {
+		pass.refCount = static_cast<uint32_t>(pass.writes.size());
+	}
+
+	std::vector<Resource> unreferenced;
+	auto cullPass = [this, &unreferenced](PassNode& pass) {
+		for (Resource resource : pass.reads) {
+			if (--m_resources[resource].readCount == 0) {
+				unreferenced.push_back(resource);
+			}
+		}
+	};
+
+	for (Resource i = 0; i < m_resources.size(); ++i) {
+		if (m_resources[i].readCount == 0) {
+			unreferenced.push_back(i);
+		}
+	}
+
+	// Passes that dont write anything, e.g. when there was nothing to draw
+	for (auto& pass : m_passes) {
+		if (culled(pass)) {
+			cullPass(pass);
+		}
+	}
+
+	// Walk back from every resource that is never read, to the passes producing it
+	while (!unreferenced.empty()) {
+		Resource resource = unreferenced.back();
+		unreferenced.pop_back();
+
+		for (uint32_t writer : m_resources[resource].writers) {
+			PassNode& pass = m_passes[writer];
+			if (pass.refCount == 0) {
+				continue;
+			}
+
+			if (--pass.refCount == 0 && !pass.sideEffect) {
+				cullPass(pass);
+			}
+		}
+	}
+}
+
+void RenderGraph::allocate()
+{
+	constexpr uint32_t unused = UINT32_MAX;
+
+	for (auto& resource : m_resources) {
+		resource.firstPass = unused;
+		resource.lastPass = 0;
+	}
+
+	for (uint32_t i = 0; i < m_passes.size(); ++i) {
+		if (culled(m_passes[i])) {
+			continue;
+		}
+
+		auto use = [this, i](Resource resource) {
+			auto& node = m_resources[resource];
+			node.firstPass = std::min(node.firstPass, i);
+			node.lastPass = std::max(node.lastPass, i);
+		};
+		std::for_each(m_passes[i].reads.begin(), m_passes[i].reads.end(), use);
+		std::for_each(m_passes[i].writes.begin(), m_passes[i].writes.end(), use);
+	}
+
+	// Targets whose last use has passed are free to be aliased by later resources
+	std::vector<std::pair<RenderTargetDescription, std::shared_ptr<TextureFramebuffer>>> available;
+
+	for (uint32_t i = 0; i < m_passes.size(); ++i) {
+		for (auto& resource : m_resources) {
+			if (resource.imported || resource.firstPass != i) {
+				continue;
+			}
+
+			auto it = std::find_if(available.begin(), available.end(), [&resource](const auto& target) {
+				return target.first == resource.description;
+			});
+			if (it != available.end()) {
+				resource.texture = it->second;
+				available.erase(it);
+				continue;
+			}
+
+			resource.texture = m_pool.acquire(resource.description);
+		}
+
+		for (auto& resource : m_resources) {
+			if (resource.imported || resource.firstPass == unused || resource.lastPass != i) {
+				continue;
+			}
+
+			available.push_back({ resource.description, resource.texture });
+		}
+	}
+}
+
+void RenderGraph::executeBlit(const PassNode& pass)
+{
+	Resource from = pass.reads.front();
+	Resource to = pass.writes.front();
+
+	Framebuffer::copyBuffer(framebuffer({ from }), framebuffer({ to }), pass.blitBits, pass.blitFilter);
+}
+
+std::shared_ptr<Framebuffer> RenderGraph::framebuffer(const std::vector<Resource>& resources)
+{
+	bool imported = m_resources[resources.front()].imported;
+
+	std::vector<std::shared_ptr<TextureFramebuffer>> textures;
+	for (Resource resource : resources) {
+		VERIFY(m_resources[resource].imported == imported,
+		       "cant mix the default framebuffer with render targets: '{}'", m_resources[resource].name);
+		if (!imported) {
+			textures.push_back(m_resources[resource].texture);
+		}
+	}
+
+	return imported ? m_screen : m_pool.framebuffer(textures);
+}
+
+void RenderGraph::beginPass(uint32_t index)
+{
+	const PassNode& pass = m_passes[index];
+	if (pass.writes.empty()) {
+		return;
+	}
+
+	std::vector<Resource> attachments = pass.writes;
+	attachments.insert(attachments.end(), pass.depthReads.begin(), pass.depthReads.end());
+
+	auto target = framebuffer(attachments);
+	target->bind();
+	RenderCommand::setViewport(0, 0, target->width(), target->height());
+	if (target->id() != 0) {
+		RenderCommand::setColorAttachmentCount(target->colorAttachmentCount());
+	}
+
+	uint32_t clearBits = 0;
+	std::vector<uint32_t> invalidate;
+	uint32_t colorAttachment = 0;
+	for (size_t i = 0; i < pass.writes.size(); ++i) {
+		Resource resource = pass.writes[i];
+		const auto& node = m_resources[resource];
+		LoadOp loadOp = pass.loadOps[i];
+
+		// The contents of a target that is used for the first time are undefined
+		if (loadOp == LoadOp::Load && !node.imported && node.firstPass == index) {
+			loadOp = LoadOp::DontCare;
+		}
+
+		uint32_t bit = GL_COLOR_BUFFER_BIT;
+		uint32_t attachment = node.imported ? GL_COLOR : GL_COLOR_ATTACHMENT0 + colorAttachment;
+		if (node.description.format == Framebuffer::Type::Depth24Stencil8) {
+			bit = GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+			attachment = node.imported ? GL_DEPTH : GL_DEPTH_STENCIL_ATTACHMENT;
+		}
+		else if (node.description.format == Framebuffer::Type::Depth32F) {
+			bit = GL_DEPTH_BUFFER_BIT;
+			attachment = node.imported ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+		}
+		else {
+			colorAttachment++;
+		}
+
+		if (loadOp == LoadOp::Clear) {
+			clearBits |= bit;
+		}
+		else if (loadOp == LoadOp::DontCare) {
+			invalidate.push_back(attachment);
+		}
+	}
+
+	if (!invalidate.empty()) {
+		glInvalidateNamedFramebufferData(target->id(), invalidate.size(), invalidate.data());
+	}
+
+	if (clearBits) {
+		RenderCommand::clearColor(pass.clearColor);
+		RenderCommand::clearBit(clearBits);
+	}
+}
+
+} // namespace Inferno
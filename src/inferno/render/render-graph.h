@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint8_t, uint32_t, uint64_t
+#include <functional>
+#include <map>
+#include <memory> // std::shared_ptr
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "glm/ext/vector_float4.hpp" // glm::vec4
+
+#include "inferno/render/framebuffer.h"
+
+namespace Inferno {
+
+class TextureFramebuffer;
+
+struct RenderTargetDescription {
+	uint32_t width { 0 };
+	uint32_t height { 0 };
+	Framebuffer::Type format { Framebuffer::Type::None };
+
+	bool operator==(const RenderTargetDescription&) const = default;
+	bool operator<(const RenderTargetDescription& other) const;
+	bool isDepth() const { return format >= Framebuffer::Type::Depth24Stencil8; }
+};
+
+// Render target textures that outlive a single frame, keyed by size and format.
+// Targets that have not been used for a few frames are released, so that old
+// sizes disappear after a resize.
+class RenderTargetPool final {
+public:
+	static constexpr const uint32_t maxUnusedFrames = 3;
+
+	std::shared_ptr<TextureFramebuffer> acquire(const RenderTargetDescription& description);
+	void release(std::shared_ptr<TextureFramebuffer> texture);
+	std::shared_ptr<Framebuffer> framebuffer(const std::vector<std::shared_ptr<TextureFramebuffer>>& textures);
+
+	void nextFrame();
+
+private:
+	struct Target {
+		RenderTargetDescription description {};
+		std::shared_ptr<TextureFramebuffer> texture {};
+		uint64_t lastUsed { 0 };
+		bool inUse { false };
+	};
+
+	uint64_t m_frame { 0 };
+	std::vector<Target> m_targets;
+	std::map<std::vector<uint32_t>, std::shared_ptr<Framebuffer>> m_framebuffers; // texture ids -> FBO
+};
+
+// -----------------------------------------
+
+// Frame graph, passes declare the resources they read and write, which is used
+// to cull work that never reaches the screen and to share memory between
+// transient targets whose lifetimes dont overlap
+class RenderGraph final {
+public:
+	using Resource = uint32_t;
+
+	// Imported resources, backed by the default framebuffer
+	static constexpr const Resource screenColor = 0;
+	static constexpr const Resource screenDepth = 1;
+
+	enum class LoadOp : uint8_t {
+		Load,     // Keep the contents
+		Clear,    // Clear to the pass clear color
+		DontCare, // The pass overwrites every pixel
+	};
+
+	class Builder {
+	public:
+		Resource create(std::string_view name, const RenderTargetDescription& description);
+		Resource read(Resource resource);
+		Resource readDepth(Resource resource); // Attach for depth testing, without writing to it
+		Resource write(Resource resource, LoadOp loadOp = LoadOp::Load);
+
+		void setClearColor(const glm::vec4& clearColor);
+		void setSideEffect(); // Never cull this pass
+
+	private:
+		friend RenderGraph;
+		Builder(RenderGraph& graph, uint32_t pass)
+			: m_graph(graph)
+			, m_pass(pass)
+		{
+		}
+
+		RenderGraph& m_graph;
+		uint32_t m_pass { 0 };
+	};
+
+	using SetupFunction = std::function<void(Builder&)>;
+	using ExecuteFunction = std::function<void(const RenderGraph&)>;
+
+	RenderGraph() = default;
+	~RenderGraph() = default;
+
+	// Start recording a new frame
+	void reset(uint32_t width, uint32_t height);
+
+	void addPass(std::string_view name, const SetupFunction& setup, const ExecuteFunction& execute);
+	void addBlitPass(std::string_view name, Resource from, Resource to, uint32_t bits, uint32_t filter);
+
+	void compile();
+	void execute();
+
+	std::shared_ptr<TextureFramebuffer> texture(Resource resource) const;
+	const RenderTargetDescription& description(Resource resource) const;
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+
+private:
+	struct ResourceNode {
+		std::string name {};
+		RenderTargetDescription description {};
+		bool imported { false };
+		uint32_t readCount { 0 };
+		std::vector<uint32_t> writers {};
+		uint32_t firstPass { 0 };
+		uint32_t lastPass { 0 };
+		std::shared_ptr<TextureFramebuffer> texture {};
+	};
+
+	struct PassNode {
+		std::string name {};
+		std::vector<Resource> reads {};
+		std::vector<Resource> depthReads {};
+		std::vector<Resource> writes {};
+		std::vector<LoadOp> loadOps {};
+		glm::vec4 clearColor { 0.0f };
+		bool sideEffect { false };
+		uint32_t refCount { 0 };
+		ExecuteFunction execute {};
+
+		// Blit pass
+		bool blit { false };
+		uint32_t blitBits { 0 };
+		uint32_t blitFilter { 0 };
+	};
+
+	bool culled(const PassNode& pass) const { return pass.refCount == 0 && !pass.sideEffect; }
+	void cull();
+	void allocate();
+	void executeBlit(const PassNode& pass);
+	std::shared_ptr<Framebuffer> framebuffer(const std::vector<Resource>& resources);
+	void beginPass(uint32_t index);
+
+private:
+	uint32_t m_width { 0 };
+	uint32_t m_height { 0 };
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	std::shared_ptr<Framebuffer> m_screen;
+	RenderTargetPool m_pool;
+};
+
+} // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+RenderGraph::Resource albedo;
+graph.reset(width, height);
+graph.addPass(
+	"Geometry",
+	[&](RenderGraph::Builder& builder) {
+		albedo = builder.create("Albedo", { width, height, Framebuffer::Type::RGBA8 });
+		builder.write(albedo, RenderGraph::LoadOp::Clear);
+	},
+	[&](const RenderGraph&) { /* draw */ });
+graph.addPass(
+	"Lighting",
+	[&](RenderGraph::Builder& builder) {
+		builder.read(albedo);
+		builder.write(RenderGraph::screenColor);
+	},
+	[&](const RenderGraph& graph) { /* sample graph.texture(albedo) */ });
+graph.compile();
+graph.execute();
+
+#endif
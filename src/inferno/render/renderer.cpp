@@ -4,11 +4,14 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <algorithm> // std::copy, std::min
+#include <algorithm> // std::copy, std::min, std::sort
+#include <cstdint>   // uintptr_t
 #include <span>
 
 #include "glad/glad.h"
-#include "glm/ext/vector_float4.hpp" // glm::vec4
+#include "glm/ext/matrix_float3x3.hpp" // glm::mat3
+#include "glm/ext/matrix_float4x4.hpp" // glm::mat4
+#include "glm/ext/vector_float4.hpp"   // glm::vec4
 #include "ruc/format/log.h"
 
 #include "inferno/asset/asset-manager.h"
@@ -68,9 +71,10 @@ void Renderer<T>::destroy()
 }
 
 template<typename T>
-uint32_t Renderer<T>::addTextureUnit(std::shared_ptr<Texture> texture)
+uint32_t Renderer<T>::addTextureUnit(Texture* texture)
 {
-	if (texture == nullptr) {
+	// Textures that are still loading are drawn with only their color, as a placeholder
+	if (texture == nullptr || !texture->ready()) {
 		return 0;
 	}
 
@@ -247,12 +251,12 @@ void Renderer2D::drawQuad(const TransformComponent& transform, glm::mat4 color)
 	drawQuad(transform, color, nullptr);
 }
 
-void Renderer2D::drawQuad(const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture)
+void Renderer2D::drawQuad(const TransformComponent& transform, glm::vec4 color, Texture* texture)
 {
 	drawQuad(transform, glm::mat4(color, color, color, color), texture);
 }
 
-void Renderer2D::drawQuad(const TransformComponent& transform, glm::mat4 color, std::shared_ptr<Texture> texture)
+void Renderer2D::drawQuad(const TransformComponent& transform, glm::mat4 color, Texture* texture)
 {
 	// Create a new batch if the quad limit has been reached
 	if (m_vertexIndex + vertexPerQuad > maxVertices || m_elementIndex + elementPerQuad > maxElements) {
@@ -378,12 +382,12 @@ void RendererCubemap::beginScene(glm::mat4 cameraProjection, glm::mat4 cameraVie
 	m_shader->unbind();
 }
 
-void RendererCubemap::drawCubemap(const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture)
+void RendererCubemap::drawCubemap(const TransformComponent& transform, glm::vec4 color, Texture* texture)
 {
 	drawCubemap(transform, glm::mat4(color, color, color, color), texture);
 }
 
-void RendererCubemap::drawCubemap(const TransformComponent& transform, glm::mat4 color, std::shared_ptr<Texture> texture)
+void RendererCubemap::drawCubemap(const TransformComponent& transform, glm::mat4 color, Texture* texture)
 {
 	// Create a new batch if the quad limit has been reached
 	if (m_vertexIndex + (vertexPerQuad * quadPerCube) > maxVertices
@@ -419,30 +423,30 @@ RendererFont::RendererFont(s)
 	// ---------------------------------
 	// CPU
 
-	// Create array for storing quads vertices
-	m_vertexBufferBase = std::make_unique<SymbolVertex[]>(maxVertices);
+	// Create array for storing glyph instances
+	m_vertexBufferBase = std::make_unique<SymbolInstance[]>(maxVertices);
 	m_vertexBufferPtr = m_vertexBufferBase.get();
 
+	m_styles.reserve(maxStyles);
+
 	// ---------------------------------
 	// GPU
 
 	m_enableDepthBuffer = false;
 
-	// Create vertex buffer
-	auto vertexBuffer = std::make_shared<VertexBuffer>(sizeof(SymbolVertex) * maxVertices);
+	// Create instance buffer, the attributes advance once per glyph
+	auto vertexBuffer = std::make_shared<VertexBuffer>(sizeof(SymbolInstance) * maxVertices);
 	vertexBuffer->setLayout({
-		{ BufferElementType::Vec3, "a_position" },
-		{ BufferElementType::Vec4, "a_color" },
-		{ BufferElementType::Vec2, "a_textureCoordinates" },
+		{ BufferElementType::Vec4, "a_position" },
+		{ BufferElementType::Vec4, "a_textureCoordinates" },
+		{ BufferElementType::Uint, "a_style" },
 		{ BufferElementType::Uint, "a_textureIndex" },
-		{ BufferElementType::Float, "a_width" },
-		{ BufferElementType::Float, "a_edge" },
-		{ BufferElementType::Float, "a_borderWidth" },
-		{ BufferElementType::Float, "a_borderEdge" },
-		{ BufferElementType::Vec4, "a_borderColor" },
-		{ BufferElementType::Float, "a_offset" },
 	});
-	m_vertexArray->addVertexBuffer(vertexBuffer);
+	m_vertexArray->addVertexBuffer(vertexBuffer, 1);
+
+	// Create style storage buffer
+	m_storageArena = std::make_shared<ShaderStorageArena>(sizeof(SymbolStyle) * maxStyles, true);
+	m_stylesRange = m_storageArena->allocate(sizeof(SymbolStyle) * maxStyles);
 
 	ruc::info("RendererFont initialized");
 }
@@ -451,34 +455,57 @@ RendererFont::~RendererFont()
 {
 }
 
-void RendererFont::drawSymbol(std::array<SymbolVertex, vertexPerQuad>& symbolQuad, std::shared_ptr<Texture> texture)
+void RendererFont::endScene()
 {
-	// Create a new batch if the quad limit has been reached
-	if (m_vertexIndex + vertexPerQuad > maxVertices || m_elementIndex + elementPerQuad > maxElements) {
+	nextBatch();
+
+	m_styles.clear();
+	m_uploadedStyles = 0;
+	m_storageArena->nextFrame();
+}
+
+uint32_t RendererFont::addStyle(const SymbolStyle& style)
+{
+	// Draw everything that uses the current styles, so they can be overwritten
+	if (m_styles.size() >= maxStyles) {
 		nextBatch();
+		m_styles.clear();
+		m_uploadedStyles = 0;
 	}
 
-	uint32_t textureUnitIndex = addTextureUnit(texture);
+	m_styles.push_back(style);
+	return static_cast<uint32_t>(m_styles.size() - 1);
+}
 
-	// Add the quads 4 vertices
-	for (uint32_t i = 0; i < vertexPerQuad; i++) {
-		m_vertexBufferPtr->quad.position = symbolQuad[i].quad.position;
-		m_vertexBufferPtr->quad.color = symbolQuad[i].quad.color;
-		m_vertexBufferPtr->quad.textureCoordinates = symbolQuad[i].quad.textureCoordinates;
-		m_vertexBufferPtr->quad.textureIndex = textureUnitIndex;
-
-		m_vertexBufferPtr->width = symbolQuad[i].width;
-		m_vertexBufferPtr->edge = symbolQuad[i].edge;
-		m_vertexBufferPtr->borderWidth = symbolQuad[i].borderWidth;
-		m_vertexBufferPtr->borderEdge = symbolQuad[i].borderEdge;
-		m_vertexBufferPtr->borderColor = symbolQuad[i].borderColor;
-		m_vertexBufferPtr->offset = symbolQuad[i].offset;
+void RendererFont::drawSymbols(std::span<SymbolInstance> symbols, Texture* texture, uint32_t style)
+{
+	VERIFY(style < m_styles.size(), "symbol style out of range: {}", style);
 
-		m_vertexBufferPtr++;
-	}
+	while (!symbols.empty()) {
+		// Create a new batch if the glyph limit has been reached
+		if (m_vertexIndex >= maxVertices) {
+			nextBatch();
+		}
 
-	m_vertexIndex += vertexPerQuad;
-	m_elementIndex += elementPerQuad;
+		uint32_t textureUnitIndex = addTextureUnit(texture);
+
+		// Fit as many glyphs as possible in the current batch
+		auto instances = symbols.first(std::min<size_t>(symbols.size(), maxVertices - m_vertexIndex));
+		symbols = symbols.subspan(instances.size());
+
+		// The texture unit and style are stored in the cached instances, so these are only updated when they change
+		if (instances.front().textureIndex != textureUnitIndex || instances.front().style != style) {
+			for (auto& instance : instances) {
+				instance.textureIndex = textureUnitIndex;
+				instance.style = style;
+			}
+		}
+
+		std::copy(instances.begin(), instances.end(), m_vertexBufferPtr);
+		m_vertexBufferPtr += instances.size();
+
+		m_vertexIndex += instances.size();
+	}
 }
 
 void RendererFont::loadShader()
@@ -486,6 +513,36 @@ void RendererFont::loadShader()
 	m_shader = AssetManager::the().load<Shader>("assets/glsl/batch-font");
 }
 
+void RendererFont::flush()
+{
+	if (m_vertexIndex == 0) {
+		return;
+	}
+
+	// Upload instance data to GPU
+	m_vertexArray->at(0)->uploadData(m_vertexBufferBase.get(), m_vertexIndex * sizeof(SymbolInstance));
+
+	// Upload the styles that were added since the last batch
+	if (m_uploadedStyles < m_styles.size()) {
+		std::span<const SymbolStyle> styles(m_styles.begin() + m_uploadedStyles, m_styles.end());
+		m_storageArena->setValues(m_stylesRange, styles, m_uploadedStyles);
+		m_uploadedStyles = static_cast<uint32_t>(m_styles.size());
+	}
+	m_storageArena->upload();
+	m_storageArena->bind(m_stylesRange, 1);
+
+	bind();
+
+	// Render
+	bool depthTest = RenderCommand::depthTest();
+	RenderCommand::setDepthTest(m_enableDepthBuffer);
+	RenderCommand::setColorAttachmentCount(m_colorAttachmentCount);
+	RenderCommand::drawInstanced(m_vertexArray, vertexPerQuad, m_vertexIndex);
+	RenderCommand::setDepthTest(depthTest);
+
+	unbind();
+}
+
 // -----------------------------------------
 
 Renderer3D::Renderer3D(s)
@@ -516,6 +573,27 @@ Renderer3D::Renderer3D(s)
 	});
 	m_vertexArray->addVertexBuffer(vertexBuffer);
 
+	// ---------------------------------
+	// Depth pre-pass
+
+	m_positionBufferBase = std::make_unique<glm::vec3[]>(maxVertices);
+	m_positionBufferPtr = m_positionBufferBase.get();
+
+	m_depthShader = AssetManager::the().load<Shader>("assets/glsl/depth-prepass");
+
+	// Position-only vertex buffer, sharing the element buffer
+	m_depthVertexArray = std::make_shared<VertexArray>();
+	auto positionBuffer = std::make_shared<VertexBuffer>(sizeof(glm::vec3) * maxVertices);
+	positionBuffer->setLayout({
+		{ BufferElementType::Vec3, "a_position" },
+	});
+	m_depthVertexArray->addVertexBuffer(positionBuffer);
+	m_depthVertexArray->setIndexBuffer(m_vertexArray->indexBuffer());
+
+	// Batched vertices are already in world space
+	resetMeshUniforms(m_shader);
+	resetMeshUniforms(m_depthShader);
+
 	ruc::info("Renderer3D initialized");
 }
 
@@ -523,7 +601,7 @@ Renderer3D::~Renderer3D()
 {
 }
 
-void Renderer3D::drawModel(std::span<const Vertex> vertices, std::span<const uint32_t> elements, const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture)
+void Renderer3D::drawModel(std::span<const Vertex> vertices, std::span<const uint32_t> elements, const TransformComponent& transform, glm::vec4 color, Texture* texture, uint32_t baseVertex)
 {
 	// ruc::error("drawModel");
 
@@ -548,15 +626,167 @@ void Renderer3D::drawModel(std::span<const Vertex> vertices, std::span<const uin
 		m_vertexBufferPtr++;
 	}
 
-	// Copy element indices to the element buffer
-	for (const auto& element : elements) {
-		// Indices are referenced relative to vertices[0], if there are multiple models in a batch,
-		// then the indices need to be offset by the total amount of vertices
-		*m_elementBufferPtr++ = element + m_vertexIndex;
+	addElements(elements, vertices.size(), baseVertex);
+}
+
+void Renderer3D::endScene()
+{
+	nextBatch();
+	m_depthPrepass = false;
+}
+
+void Renderer3D::beginDepthPrepass()
+{
+	VERIFY(m_vertexIndex == 0, "depth pre-pass started during a batch");
+	m_depthPrepass = true;
+}
+
+void Renderer3D::drawModelDepth(std::span<const Vertex> vertices, std::span<const uint32_t> elements, const TransformComponent& transform, uint32_t baseVertex)
+{
+	VERIFY(m_depthPrepass, "depth pre-pass was not started");
+	VERIFY(vertices.size() <= maxVertices, "model vertices too big for buffer, {}/{}", vertices.size(), maxVertices);
+	VERIFY(elements.size() <= maxElements, "model elements too big for buffer, {}/{}", elements.size(), maxElements);
+
+	// Create a new batch if the quad limit has been reached
+	if (m_vertexIndex + vertices.size() > maxVertices || m_elementIndex + elements.size() > maxElements) {
+		nextBatch();
 	}
 
-	m_vertexIndex += vertices.size();
-	m_elementIndex += elements.size();
+	// Must match drawModel() exactly, the geometry pass depth tests with GL_EQUAL
+	for (const auto& vertex : vertices) {
+		*m_positionBufferPtr++ = transform.transform * glm::vec4(vertex.position, 1.0f);
+	}
+
+	addElements(elements, vertices.size(), baseVertex);
+}
+
+std::shared_ptr<VertexArray> Renderer3D::createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	auto vertexBuffer = std::make_shared<VertexBuffer>(vertices.size_bytes());
+	vertexBuffer->setLayout({
+		{ BufferElementType::Vec3, "a_position" },
+		{ BufferElementType::Vec3, "a_normal" },
+		{ BufferElementType::Vec4, "a_color" },
+		{ BufferElementType::Vec2, "a_textureCoordinates" },
+		{ BufferElementType::Uint, "a_textureIndex" },
+	});
+	vertexBuffer->uploadData(vertices.data(), vertices.size_bytes());
+
+	auto indexBuffer = std::make_shared<IndexBuffer>(nullptr, indices.size_bytes());
+	indexBuffer->uploadData(indices.data(), indices.size_bytes());
+
+	auto vertexArray = std::make_shared<VertexArray>();
+	vertexArray->addVertexBuffer(vertexBuffer);
+	vertexArray->setIndexBuffer(indexBuffer);
+
+	return vertexArray;
+}
+
+std::shared_ptr<VertexArray> Renderer3D::createMeshDepth(std::span<const Vertex> vertices, std::shared_ptr<IndexBuffer> indexBuffer)
+{
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		positions[i] = vertices[i].position;
+	}
+
+	// Position-only vertex buffer, sharing the element buffer of the mesh
+	auto positionBuffer = std::make_shared<VertexBuffer>(positions.size() * sizeof(glm::vec3));
+	positionBuffer->setLayout({
+		{ BufferElementType::Vec3, "a_position" },
+	});
+	positionBuffer->uploadData(positions.data(), positions.size() * sizeof(glm::vec3));
+
+	auto vertexArray = std::make_shared<VertexArray>();
+	vertexArray->addVertexBuffer(positionBuffer);
+	vertexArray->setIndexBuffer(indexBuffer);
+
+	return vertexArray;
+}
+
+void Renderer3D::drawMesh(std::shared_ptr<VertexArray> vertexArray, const TransformComponent& transform, std::span<MeshRange> ranges)
+{
+	if (ranges.empty()) {
+		return;
+	}
+
+	// Ranges that share a texture and color end up next to each other
+	std::sort(ranges.begin(), ranges.end(), [](const MeshRange& a, const MeshRange& b) {
+		if (a.texture != b.texture) {
+			return a.texture < b.texture;
+		}
+		for (int i = 0; i < 4; ++i) {
+			if (a.color[i] != b.color[i]) {
+				return a.color[i] < b.color[i];
+			}
+		}
+		return false;
+	});
+
+	m_shader->bind();
+	m_shader->setFloat("u_model", transform.transform);
+	m_shader->setFloat("u_normalMatrix", glm::mat3(glm::transpose(glm::inverse(transform.transform))));
+	m_meshUniforms = true;
+	vertexArray->bind();
+
+	bool depthTest = RenderCommand::depthTest();
+	RenderCommand::setDepthTest(m_enableDepthBuffer);
+	RenderCommand::setColorAttachmentCount(m_colorAttachmentCount);
+
+	for (size_t i = 0; i < ranges.size();) {
+		Texture* texture = ranges[i].texture;
+		glm::vec4 color = ranges[i].color;
+		bool textured = texture != nullptr && texture->ready();
+
+		m_shader->setFloat("u_color", color);
+		m_shader->setInt("u_textureIndex", textured ? 1 : 0);
+		if (textured) {
+			texture->bind(1);
+		}
+
+		// Render
+		m_rangeCounts.clear();
+		m_rangeOffsets.clear();
+		for (; i < ranges.size() && ranges[i].texture == texture && ranges[i].color == color; ++i) {
+			addMeshRange(vertexArray, ranges[i]);
+		}
+		RenderCommand::multiDrawIndexed(vertexArray, m_rangeCounts, m_rangeOffsets);
+
+		if (textured) {
+			texture->unbind();
+		}
+	}
+
+	RenderCommand::setDepthTest(depthTest);
+	vertexArray->unbind();
+}
+
+void Renderer3D::drawMeshDepth(std::shared_ptr<VertexArray> vertexArray, const TransformComponent& transform, std::span<const MeshRange> ranges)
+{
+	VERIFY(m_depthPrepass, "depth pre-pass was not started");
+	if (ranges.empty()) {
+		return;
+	}
+
+	m_depthShader->bind();
+	m_depthShader->setFloat("u_model", transform.transform);
+	m_meshUniforms = true;
+	vertexArray->bind();
+
+	m_rangeCounts.clear();
+	m_rangeOffsets.clear();
+	for (const auto& range : ranges) {
+		addMeshRange(vertexArray, range);
+	}
+
+	// Render, depth only
+	bool depthTest = RenderCommand::depthTest();
+	RenderCommand::setDepthTest(true);
+	RenderCommand::setColorMask(false);
+	RenderCommand::multiDrawIndexed(vertexArray, m_rangeCounts, m_rangeOffsets);
+	RenderCommand::setColorMask(true);
+	RenderCommand::setDepthTest(depthTest);
+
+	vertexArray->unbind();
 }
 
 void Renderer3D::createElementBuffer()
@@ -586,10 +816,83 @@ void Renderer3D::loadShader()
 	m_shader = AssetManager::the().load<Shader>("assets/glsl/batch-3d");
 }
 
+void Renderer3D::flush()
+{
+	// Batched vertices are already in world space, undo the uniforms of the meshes
+	if (m_meshUniforms) {
+		resetMeshUniforms(m_shader);
+		resetMeshUniforms(m_depthShader);
+		m_meshUniforms = false;
+	}
+
+	if (!m_depthPrepass) {
+		Renderer<Vertex>::flush();
+		return;
+	}
+
+	if (m_vertexIndex == 0 || m_elementIndex == 0) {
+		return;
+	}
+
+	// Upload index data to GPU
+	uploadElementBuffer();
+
+	// Upload vertex data to GPU
+	m_depthVertexArray->at(0)->uploadData(m_positionBufferBase.get(), m_vertexIndex * sizeof(glm::vec3));
+
+	m_depthShader->bind();
+	m_depthVertexArray->bind();
+
+	// Render, depth only
+	bool depthTest = RenderCommand::depthTest();
+	RenderCommand::setDepthTest(true);
+	RenderCommand::setColorMask(false);
+	RenderCommand::drawIndexed(m_depthVertexArray, m_elementIndex);
+	RenderCommand::setColorMask(true);
+	RenderCommand::setDepthTest(depthTest);
+
+	m_depthVertexArray->unbind();
+	m_depthShader->unbind();
+}
+
 void Renderer3D::startBatch()
 {
 	Renderer<Vertex>::startBatch();
 	m_elementBufferPtr = m_elementBufferBase.get();
+	m_positionBufferPtr = m_positionBufferBase.get();
+}
+
+void Renderer3D::addElements(std::span<const uint32_t> elements, uint32_t vertexCount, uint32_t baseVertex)
+{
+	// Copy element indices to the element buffer
+	for (const auto& element : elements) {
+		// Indices are referenced relative to vertices[0], if there are multiple models in a batch,
+		// then the indices need to be offset by the total amount of vertices
+		*m_elementBufferPtr++ = element - baseVertex + m_vertexIndex;
+	}
+
+	m_vertexIndex += vertexCount;
+	m_elementIndex += elements.size();
+}
+
+void Renderer3D::addMeshRange(std::shared_ptr<VertexArray> vertexArray, const MeshRange& range)
+{
+	uint32_t count = range.indexCount ? range.indexCount : vertexArray->indexBuffer()->count();
+	m_rangeCounts.push_back(static_cast<int32_t>(count));
+	// The offset into the bound index buffer is passed as the pointer, in bytes
+	m_rangeOffsets.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(range.indexOffset) * sizeof(uint32_t)));
+}
+
+void Renderer3D::resetMeshUniforms(std::shared_ptr<Shader> shader)
+{
+	shader->bind();
+	shader->setFloat("u_model", glm::mat4(1.0f));
+	if (shader == m_shader) {
+		shader->setFloat("u_normalMatrix", glm::mat3(1.0f));
+		shader->setFloat("u_color", glm::vec4(1.0f));
+		shader->setInt("u_textureIndex", -1);
+	}
+	shader->unbind();
 }
 
 // -----------------------------------------
@@ -605,7 +908,7 @@ RendererPostProcess::~RendererPostProcess()
 {
 }
 
-void RendererPostProcess::drawQuad(const TransformComponent& transform, std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> position, std::shared_ptr<Texture> normal)
+void RendererPostProcess::drawQuad(const TransformComponent& transform, Texture* albedo, Texture* position, Texture* normal)
 {
 	nextBatch();
 
@@ -9,6 +9,7 @@
 #include <cstdint> // int32_t, uint32_t
 #include <memory>  // std::shared_ptr, std::unique_ptr, std::make_shared, std::make_unique
 #include <span>
+#include <vector>
 
 #include "glm/ext/matrix_float4x4.hpp" // glm::mat4
 #include "glm/ext/vector_float2.hpp"   // glm::vec2
@@ -17,13 +18,23 @@
 #include "ruc/singleton.h"
 
 #include "inferno/asset/shader.h"
+#include "inferno/render/shader-storage-arena.h"
 
 namespace Inferno {
 
+class IndexBuffer;
 class Texture;
 class TransformComponent;
 class VertexArray;
 
+// Part of a mesh that lives on the GPU, drawn with its own color and texture
+struct MeshRange {
+	uint32_t indexOffset { 0 };
+	uint32_t indexCount { 0 }; // 0 draws the whole mesh
+	glm::vec4 color { 1.0f };
+	Texture* texture { nullptr };
+};
+
 struct QuadVertex {
 	glm::vec3 position { 0.0f };
 	glm::vec4 color { 1.0f };
@@ -37,18 +48,28 @@ struct CubemapVertex {
 	uint32_t textureIndex { 0 };
 };
 
-struct SymbolVertex {
-	QuadVertex quad;
+// One glyph, the quad corners are expanded in the vertex shader
+struct SymbolInstance {
+	glm::vec4 position { 0.0f };           // Screen space, bottom left xy, top right zw
+	glm::vec4 textureCoordinates { 0.0f }; // Bottom left xy, top right zw
+	uint32_t style { 0 };                  // Index into the style storage buffer
+	uint32_t textureIndex { 0 };
+};
 
+// Shared by all glyphs of a text area, std430 layout
+struct SymbolStyle {
+	glm::vec4 color { 1.0f };
+	// Outline
+	glm::vec4 borderColor { 1.0f };
 	// Font
 	float width = 0.44f;
 	float edge = 0.15f;
 	// Outline
 	float borderWidth = 0.7f;
 	float borderEdge = 0.1f;
-	glm::vec4 borderColor { 1.0f };
 	// Dropshadow
 	float offset = 0.0f;
+	float padding[3] { 0.0f };
 };
 
 struct Vertex {
@@ -89,7 +110,7 @@ protected:
 	void initialize();
 	void destroy();
 
-	uint32_t addTextureUnit(std::shared_ptr<Texture> texture);
+	uint32_t addTextureUnit(Texture* texture);
 
 	void bind();
 	void unbind();
@@ -111,7 +132,7 @@ protected:
 	// Texture units
 	static inline uint32_t m_maxSupportedTextureSlots { 0 };
 	uint32_t m_textureSlotIndex { 1 };
-	std::array<std::shared_ptr<Texture>, maxTextureSlots> m_textureSlots;
+	std::array<Texture*, maxTextureSlots> m_textureSlots; // Assets are only removed between frames
 
 	// GPU objects
 	bool m_enableDepthBuffer { true };
@@ -139,8 +160,8 @@ public:
 
 	void drawQuad(const TransformComponent& transform, glm::vec4 color);
 	void drawQuad(const TransformComponent& transform, glm::mat4 color);
-	void drawQuad(const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture);
-	void drawQuad(const TransformComponent& transform, glm::mat4 color, std::shared_ptr<Texture> texture);
+	void drawQuad(const TransformComponent& transform, glm::vec4 color, Texture* texture);
+	void drawQuad(const TransformComponent& transform, glm::mat4 color, Texture* texture);
 
 protected:
 	Renderer2D() {} // Needed for derived classes
@@ -169,8 +190,8 @@ public:
 
 	virtual void beginScene(glm::mat4 cameraProjection, glm::mat4 cameraView) override;
 
-	void drawCubemap(const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture);
-	void drawCubemap(const TransformComponent& transform, glm::mat4 color, std::shared_ptr<Texture> texture);
+	void drawCubemap(const TransformComponent& transform, glm::vec4 color, Texture* texture);
+	void drawCubemap(const TransformComponent& transform, glm::mat4 color, Texture* texture);
 
 protected:
 	RendererCubemap() {} // Needed for derived classes
@@ -186,19 +207,34 @@ private:
 
 // -------------------------------------
 
+// Glyphs are drawn as instances, maxVertices is the amount of glyphs per batch
 class RendererFont final
-	: public Renderer<SymbolVertex>
+	: public Renderer<SymbolInstance>
 	, public ruc::Singleton<RendererFont> {
 public:
+	static constexpr const uint32_t maxStyles = 1024;
+
 	RendererFont(s);
 	virtual ~RendererFont();
 
 	using Singleton<RendererFont>::destroy;
 
-	void drawSymbol(std::array<SymbolVertex, vertexPerQuad>& symbolQuad, std::shared_ptr<Texture> texture);
+	virtual void endScene() override;
+
+	// Returns the style index to draw symbols with, valid until endScene()
+	uint32_t addStyle(const SymbolStyle& style);
+	void drawSymbols(std::span<SymbolInstance> symbols, Texture* texture, uint32_t style);
 
 private:
+	void createElementBuffer() override {}
 	void loadShader() override;
+	void flush() override;
+
+private:
+	std::vector<SymbolStyle> m_styles;
+	uint32_t m_uploadedStyles { 0 };
+	std::shared_ptr<ShaderStorageArena> m_storageArena;
+	ArenaRange m_stylesRange;
 };
 
 // -------------------------------------
@@ -212,18 +248,50 @@ public:
 
 	using Singleton<Renderer3D>::destroy;
 
-	void drawModel(std::span<const Vertex> vertices, std::span<const uint32_t> indices, const TransformComponent& transform, glm::vec4 color, std::shared_ptr<Texture> texture);
+	virtual void endScene() override;
+
+	// Base vertex is the index of vertices[0] in the indices, for a part of a larger mesh
+	void drawModel(std::span<const Vertex> vertices, std::span<const uint32_t> indices, const TransformComponent& transform, glm::vec4 color, Texture* texture, uint32_t baseVertex = 0);
+
+	// Depth pre-pass, only the positions of the models are drawn until endScene()
+	void beginDepthPrepass();
+	void drawModelDepth(std::span<const Vertex> vertices, std::span<const uint32_t> indices, const TransformComponent& transform, uint32_t baseVertex = 0);
+
+	// Meshes that live on the GPU are drawn directly, transformed in the vertex shader.
+	// The model uniforms are set once per mesh, the ranges are sorted on their texture
+	// and color and the ranges that share both are drawn in a single call
+	static std::shared_ptr<VertexArray> createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	// Positions of the mesh only, for the depth pre-pass, drawn with the indices of the mesh
+	static std::shared_ptr<VertexArray> createMeshDepth(std::span<const Vertex> vertices, std::shared_ptr<IndexBuffer> indexBuffer);
+	void drawMesh(std::shared_ptr<VertexArray> vertexArray, const TransformComponent& transform, std::span<MeshRange> ranges);
+	void drawMeshDepth(std::shared_ptr<VertexArray> vertexArray, const TransformComponent& transform, std::span<const MeshRange> ranges);
 
 private:
 	void createElementBuffer() override;
 	void uploadElementBuffer() override;
 	void loadShader() override;
+	void flush() override;
 	void startBatch() override;
+	void addElements(std::span<const uint32_t> elements, uint32_t vertexCount, uint32_t baseVertex = 0);
+	void resetMeshUniforms(std::shared_ptr<Shader> shader);
+	void addMeshRange(std::shared_ptr<VertexArray> vertexArray, const MeshRange& range);
 
 private:
 	// CPU element vertices
 	std::unique_ptr<uint32_t[]> m_elementBufferBase { nullptr };
 	uint32_t* m_elementBufferPtr { nullptr };
+
+	// Depth pre-pass, tightly packed positions
+	bool m_depthPrepass { false };
+	std::unique_ptr<glm::vec3[]> m_positionBufferBase { nullptr };
+	glm::vec3* m_positionBufferPtr { nullptr };
+	std::shared_ptr<Shader> m_depthShader;
+	std::shared_ptr<VertexArray> m_depthVertexArray;
+
+	// Meshes, the shaders hold model uniforms until the next flush
+	bool m_meshUniforms { false };
+	std::vector<int32_t> m_rangeCounts;
+	std::vector<const void*> m_rangeOffsets;
 };
 
 // -----------------------------------------
@@ -239,7 +307,7 @@ public:
 	RendererPostProcess(s);
 	virtual ~RendererPostProcess();
 
-	void drawQuad(const TransformComponent& transform, std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> position, std::shared_ptr<Texture> normal);
+	void drawQuad(const TransformComponent& transform, Texture* albedo, Texture* position, Texture* normal);
 
 private:
 	virtual void loadShader() override;
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm> // std::lower_bound, std::max, std::sort
+#include <climits>   // UINT_MAX
+#include <cstdint>   // int32_t, uint8_t, uint32_t
+#include <cstring>   // std::memcpy
+
+#include "glad/glad.h"
+#include "ruc/meta/assert.h"
+
+#include "inferno/render/shader-storage-arena.h"
+
+namespace Inferno {
+
+ShaderStorageArena::ShaderStorageArena(uint32_t capacity, bool perFrame)
+	: m_perFrame(perFrame)
+{
+	// Sub-ranges can only be bound on offsets that are a multiple of this value
+	int32_t alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) {
+		m_alignment = static_cast<uint32_t>(alignment);
+	}
+	VERIFY((m_alignment & (m_alignment - 1)) == 0, "unsupported storage buffer alignment: {}", m_alignment);
+
+	uint32_t count = m_perFrame ? frameCount : 1;
+	m_ids.resize(count, 0);
+	m_bufferCapacities.resize(count, 0);
+	m_fences.resize(count, nullptr);
+	m_dirty.resize(count);
+
+	grow(std::max(capacity, m_alignment));
+}
+
+ShaderStorageArena::~ShaderStorageArena()
+{
+	for (uint32_t i = 0; i < bufferCount(); ++i) {
+		if (m_fences[i]) {
+			glDeleteSync(m_fences[i]);
+		}
+		if (m_ids[i]) {
+			glDeleteBuffers(1, &m_ids[i]);
+		}
+	}
+}
+
+// -----------------------------------------
+
+ArenaRange ShaderStorageArena::allocate(uint32_t size)
+{
+	VERIFY(size > 0, "cant allocate an empty storage range");
+
+	uint32_t alignedSize = align(size);
+
+	// Reuse freed memory, first fit
+	for (auto it = m_freeList.begin(); it != m_freeList.end(); ++it) {
+		if (it->size < alignedSize) {
+			continue;
+		}
+
+		ArenaRange range = { it->offset, size };
+		it->offset += alignedSize;
+		it->size -= alignedSize;
+		if (it->size == 0) {
+			m_freeList.erase(it);
+		}
+
+		return range;
+	}
+
+	// Grow geometrically, the GPU buffers follow on the next upload
+	if (m_head + alignedSize > m_capacity) {
+		grow(std::max(m_capacity * 2, m_head + alignedSize));
+	}
+
+	ArenaRange range = { m_head, size };
+	m_head += alignedSize;
+
+	return range;
+}
+
+void ShaderStorageArena::free(ArenaRange range)
+{
+	if (!range.valid()) {
+		return;
+	}
+
+	ArenaRange block = { range.offset, align(range.size) };
+
+	auto it = std::lower_bound(m_freeList.begin(), m_freeList.end(), block, [](const ArenaRange& a, const ArenaRange& b) {
+		return a.offset < b.offset;
+	});
+	it = m_freeList.insert(it, block);
+
+	// Coalesce with the next block
+	if (it + 1 != m_freeList.end() && it->offset + it->size == (it + 1)->offset) {
+		it->size += (it + 1)->size;
+		m_freeList.erase(it + 1);
+	}
+
+	// Coalesce with the previous block
+	if (it != m_freeList.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+		(it - 1)->size += it->size;
+		it = m_freeList.erase(it) - 1;
+	}
+
+	// Give the tail back to the bump allocator
+	if (it->offset + it->size == m_head) {
+		m_head = it->offset;
+		m_freeList.erase(it);
+	}
+}
+
+void ShaderStorageArena::reset()
+{
+	m_freeList.clear();
+	m_head = 0;
+}
+
+void ShaderStorageArena::write(ArenaRange range, uint32_t offset, const void* data, uint32_t size)
+{
+	VERIFY(offset + size <= range.size, "storage range write out of bounds: {}/{}", offset + size, range.size);
+
+	if (size == 0) {
+		return;
+	}
+
+	std::memcpy(m_data.data() + range.offset + offset, data, size);
+	markDirty(range.offset + offset, range.offset + offset + size);
+}
+
+void ShaderStorageArena::upload()
+{
+	uint32_t index = m_perFrame ? m_frame : 0;
+
+	if (m_bufferCapacities[index] < m_capacity) {
+		createBuffer(index);
+	}
+
+	auto& dirty = m_dirty[index];
+	if (dirty.empty()) {
+		return;
+	}
+
+	std::sort(dirty.begin(), dirty.end(), [](const ArenaRange& a, const ArenaRange& b) {
+		return a.offset < b.offset;
+	});
+
+	// Merge ranges that overlap or are close together, to reduce the amount of calls
+	ArenaRange current = dirty.front();
+	for (size_t i = 1; i <= dirty.size(); ++i) {
+		if (i < dirty.size() && dirty[i].offset <= current.offset + current.size + m_alignment) {
+			current.size = std::max(current.offset + current.size, dirty[i].offset + dirty[i].size) - current.offset;
+			continue;
+		}
+
+		glNamedBufferSubData(m_ids[index], current.offset, current.size, m_data.data() + current.offset);
+
+		if (i < dirty.size()) {
+			current = dirty[i];
+		}
+	}
+
+	dirty.clear();
+}
+
+void ShaderStorageArena::bind(ArenaRange range, uint8_t bindingPoint) const
+{
+	VERIFY(range.valid(), "cant bind an empty storage range");
+
+	uint32_t index = m_perFrame ? m_frame : 0;
+	VERIFY(m_ids[index] != 0, "storage arena was bound before upload");
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, m_ids[index], range.offset, range.size);
+}
+
+void ShaderStorageArena::nextFrame()
+{
+	if (!m_perFrame) {
+		return;
+	}
+
+	// Mark the point where the GPU is done reading this frame's buffer
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// Only poll whether the GPU is done with the next buffer in the ring
+	uint32_t next = (m_frame + 1) % bufferCount();
+	GLsync fence = m_fences[next];
+	if (fence && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		// Still being read, write into a new buffer instead of waiting on it. It
+		// goes right after the current one, so the ring keeps its submission order
+		next = m_frame + 1;
+		m_ids.insert(m_ids.begin() + next, 0);
+		m_bufferCapacities.insert(m_bufferCapacities.begin() + next, 0);
+		m_fences.insert(m_fences.begin() + next, nullptr);
+		m_dirty.insert(m_dirty.begin() + next, {});
+	}
+	else if (fence) {
+		glDeleteSync(fence);
+		m_fences[next] = nullptr;
+	}
+
+	m_frame = next;
+}
+
+// -----------------------------------------
+
+void ShaderStorageArena::grow(uint32_t capacity)
+{
+	m_capacity = align(capacity);
+	m_data.resize(m_capacity);
+}
+
+void ShaderStorageArena::markDirty(uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = 0; i < bufferCount(); ++i) {
+		m_dirty[i].push_back({ begin, end - begin });
+	}
+}
+
+void ShaderStorageArena::createBuffer(uint32_t index)
+{
+	// The old buffer is released by the driver once the GPU is done with it
+	if (m_ids[index]) {
+		glDeleteBuffers(1, &m_ids[index]);
+	}
+
+	m_ids[index] = UINT_MAX;
+	glCreateBuffers(1, &m_ids[index]);
+	glNamedBufferStorage(m_ids[index], m_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	m_bufferCapacities[index] = m_capacity;
+
+	// Everything that is in use has to be uploaded to the new buffer
+	m_dirty[index].clear();
+	if (m_head > 0) {
+		m_dirty[index].push_back({ 0, m_head });
+	}
+}
+
+} // namespace Inferno
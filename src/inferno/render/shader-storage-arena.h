@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
+#include <span>
+#include <vector>
+
+#include "glad/glad.h"
+
+namespace Inferno {
+
+// Byte range that was sub-allocated from an arena
+struct ArenaRange {
+	uint32_t offset { 0 };
+	uint32_t size { 0 };
+
+	bool valid() const { return size != 0; }
+};
+
+// Growable Shader Storage Buffer Object, that hosts many variable-length arrays.
+// Writes go into a CPU-side copy, only the dirty sub-ranges are uploaded.
+class ShaderStorageArena final { // SSBO
+public:
+	static constexpr const uint32_t frameCount = 2; // Buffers a per-frame arena starts with
+
+	// Per-frame arenas keep one GPU buffer per frame in flight, so writing the
+	// data of the next frame never has to wait on the GPU reading the last one.
+	// When the GPU falls further behind, a buffer is added to the ring
+	ShaderStorageArena(uint32_t capacity, bool perFrame = false);
+	~ShaderStorageArena();
+
+	ArenaRange allocate(uint32_t size);
+	void free(ArenaRange range);
+	void reset();
+
+	void write(ArenaRange range, uint32_t offset, const void* data, uint32_t size);
+
+	template<typename T>
+	void setValue(ArenaRange range, uint32_t index, const T& value)
+	{
+		write(range, index * sizeof(T), &value, sizeof(T));
+	}
+
+	template<typename T>
+	void setValues(ArenaRange range, std::span<const T> values, uint32_t index = 0)
+	{
+		write(range, index * sizeof(T), values.data(), values.size_bytes());
+	}
+
+	void upload();
+	void bind(ArenaRange range, uint8_t bindingPoint) const;
+	void nextFrame();
+
+	uint32_t capacity() const { return m_capacity; }
+	uint32_t size() const { return m_head; }
+	uint32_t alignment() const { return m_alignment; }
+
+private:
+	uint32_t align(uint32_t size) const { return (size + m_alignment - 1) & ~(m_alignment - 1); }
+	uint32_t bufferCount() const { return static_cast<uint32_t>(m_ids.size()); }
+	void grow(uint32_t capacity);
+	void markDirty(uint32_t begin, uint32_t end);
+	void createBuffer(uint32_t index);
+
+private:
+	bool m_perFrame { false };
+	uint32_t m_alignment { 256 };
+	uint32_t m_capacity { 0 };
+	uint32_t m_head { 0 };
+	std::vector<ArenaRange> m_freeList; // sorted on offset
+	std::vector<uint8_t> m_data;
+
+	// GPU
+	uint32_t m_frame { 0 };
+	std::vector<uint32_t> m_ids;
+	std::vector<uint32_t> m_bufferCapacities;
+	std::vector<GLsync> m_fences;
+	std::vector<std::vector<ArenaRange>> m_dirty; // Appended on write, sorted and merged on upload
+};
+
+} // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+ShaderStorageArena arena(4096, true);
+ArenaRange lights = arena.allocate(sizeof(DirectionalLightBlock) * count);
+arena.setValues(lights, std::span<const DirectionalLightBlock>(data, count));
+
+arena.upload();
+arena.bind(lights, 0); // GLSL: DirectionalLight u_directionalLight[]; .length() == count
+// .. draw ..
+arena.nextFrame();
+
+#endif
@@ -12,7 +12,6 @@ namespace Inferno {
 
 // Shader storage block layouts, using std430 memory layout rules
 
-#define MAX_DIRECTIONAL_LIGHTS 4
 struct alignas(16) DirectionalLightBlock {
 	alignas(16) glm::vec3 direction { 0 };
 
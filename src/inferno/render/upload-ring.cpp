@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstdint> // uint8_t, uint32_t
+#include <mutex>   // std::lock_guard
+
+#include "glad/glad.h"
+#include "ruc/format/log.h"
+#include "ruc/meta/assert.h"
+
+#include "inferno/render/upload-ring.h"
+
+namespace Inferno {
+
+UploadRing::UploadRing(s)
+{
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_id);
+	glNamedBufferStorage(m_id, capacity, nullptr, flags);
+	m_data = static_cast<uint8_t*>(glMapNamedBufferRange(m_id, 0, capacity, flags));
+	VERIFY(m_data, "failed to map the upload ring");
+
+	ruc::info("UploadRing initialized, {} MiB", capacity / 1024 / 1024);
+}
+
+UploadRing::~UploadRing()
+{
+	for (auto& block : m_blocks) {
+		if (block.fence) {
+			glDeleteSync(block.fence);
+		}
+	}
+
+	glUnmapNamedBuffer(m_id);
+	glDeleteBuffers(1, &m_id);
+}
+
+// -----------------------------------------
+
+UploadRange UploadRing::allocate(uint32_t size)
+{
+	uint32_t alignedSize = (size + alignment - 1) & ~(alignment - 1);
+	if (size == 0 || alignedSize > capacity) {
+		return {};
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Ranges are contiguous, skip the end of the buffer if it doesnt fit there
+	uint32_t offset = m_head;
+	uint32_t skipped = 0;
+	if (offset + alignedSize > capacity) {
+		skipped = capacity - offset;
+		offset = 0;
+	}
+
+	if (m_used + skipped + alignedSize > capacity) {
+		return {};
+	}
+
+	m_blocks.push_back({ offset, skipped + alignedSize });
+	m_head = (offset + alignedSize) % capacity;
+	m_used += skipped + alignedSize;
+
+	return { offset, size, m_data + offset };
+}
+
+void UploadRing::cancel(const UploadRange& range)
+{
+	if (!range.valid()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	find(range)->released = true;
+}
+
+void UploadRing::submit(const UploadRange& range)
+{
+	if (!range.valid()) {
+		return;
+	}
+
+	// Mark the point where the GPU is done reading the range
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Block* block = find(range);
+	block->released = true;
+	block->fence = fence;
+}
+
+void UploadRing::update()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Ranges are reused in allocation order, an unfinished range holds back the ones after it
+	while (!m_blocks.empty() && m_blocks.front().released) {
+		Block& block = m_blocks.front();
+		if (block.fence) {
+			GLenum status = glClientWaitSync(block.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+				break;
+			}
+			glDeleteSync(block.fence);
+		}
+
+		m_used -= block.size;
+		m_blocks.pop_front();
+	}
+
+	// Start at the beginning again when empty, so large ranges dont have to wrap
+	if (m_blocks.empty()) {
+		m_head = 0;
+	}
+}
+
+void UploadRing::bind() const
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+}
+
+void UploadRing::unbind() const
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// -----------------------------------------
+
+UploadRing::Block* UploadRing::find(const UploadRange& range)
+{
+	for (auto& block : m_blocks) {
+		if (!block.released && block.offset == range.offset) {
+			return &block;
+		}
+	}
+
+	VERIFY_NOT_REACHED();
+	return nullptr;
+}
+
+} // namespace Inferno
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint8_t, uint32_t, uintptr_t
+#include <deque>
+#include <mutex>
+
+#include "glad/glad.h"
+#include "ruc/singleton.h"
+
+namespace Inferno {
+
+// Byte range of the upload ring, that the loader threads write pixels into
+struct UploadRange {
+	uint32_t offset { 0 };
+	uint32_t size { 0 };
+	uint8_t* data { nullptr }; // Mapped memory
+
+	bool valid() const { return data != nullptr; }
+	// Pixel pointer argument of the upload functions, while the ring is bound
+	const void* pointer(uint32_t at = 0) const { return reinterpret_cast<const void*>(static_cast<uintptr_t>(offset + at)); }
+};
+
+// Persistent-mapped Pixel Buffer Object, texture uploads are staged in it so the
+// driver copies them on the GPU timeline instead of out of client memory. Ranges
+// are reused once the fence of the upload that read them has signaled.
+class UploadRing final : public ruc::Singleton<UploadRing> { // PBO
+public:
+	static constexpr const uint32_t capacity = 64 * 1024 * 1024;
+	static constexpr const uint32_t alignment = 256;
+
+	// Has to be created on the main thread, before the loader threads use it
+	UploadRing(s);
+	virtual ~UploadRing();
+
+	// Any thread, returns an invalid range if there is no room, the caller then
+	// uploads from its own memory
+	UploadRange allocate(uint32_t size);
+	// Any thread, the range was not used
+	void cancel(const UploadRange& range);
+
+	// Main thread, after the upload commands that read the range were issued
+	void submit(const UploadRange& range);
+	// Main thread, reclaims the ranges that the GPU is done reading
+	void update();
+
+	void bind() const;
+	void unbind() const;
+
+private:
+	struct Block {
+		uint32_t offset { 0 };
+		uint32_t size { 0 }; // Includes the skipped end of the buffer, when the block wrapped around
+		bool released { false };
+		GLsync fence { nullptr };
+	};
+
+	Block* find(const UploadRange& range);
+
+	std::mutex m_mutex;
+	uint32_t m_head { 0 };
+	uint32_t m_used { 0 };
+	std::deque<Block> m_blocks; // In allocation order
+
+	uint32_t m_id { 0 };
+	uint8_t* m_data { nullptr };
+};
+
+} // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+// Loader thread
+UploadRange range = UploadRing::the().allocate(size);
+if (range.valid()) {
+	std::memcpy(range.data, pixels, size);
+}
+
+// Main thread
+UploadRing::the().bind();
+glTextureSubImage2D(id, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, range.pointer());
+UploadRing::the().unbind();
+UploadRing::the().submit(range);
+
+#endif
@@ -4,17 +4,24 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <chrono>
 #include <cstddef> // size_t
 #include <cstdint> // uint32_t
 #include <limits>  // std::numeric_limits
+#include <string>
+#include <unordered_set>
 #include <utility> // std::pair
+#include <vector>
 
 #include "entt/entity/fwd.hpp" // ent::entity
-#include "ruc/file.h"
 #include "ruc/format/log.h"
 #include "ruc/json/json.h"
 #include "ruc/meta/assert.h"
 
+#include "inferno/asset/asset-manager.h"
+#include "inferno/asset/font.h"
+#include "inferno/asset/model.h"
+#include "inferno/asset/texture.h"
 #include "inferno/component/cameracomponent.h"
 #include "inferno/component/cubemap-component.h"
 #include "inferno/component/id-component.h"
@@ -25,6 +32,7 @@
 #include "inferno/component/tagcomponent.h"
 #include "inferno/component/textareacomponent.h"
 #include "inferno/component/transformcomponent.h"
+#include "inferno/io/file-system.h"
 #include "inferno/render/renderer.h"
 #include "inferno/render/uniformbuffer.h"
 #include "inferno/scene/scene.h"
@@ -54,12 +62,26 @@ void Scene::initialize()
 	// Load scene .json
 	// -------------------------------------
 
-	auto sceneJson = ruc::Json::parse(ruc::File("assets/scene/scene1.json").data());
+	auto start = std::chrono::steady_clock::now();
+	auto sceneJson = ruc::Json::parse(FileSystem::the().read("assets/scene/scene1.json").string());
+	auto parsed = std::chrono::steady_clock::now();
 
 	if (sceneJson.exists("init")) {
 		// TODO: load either NativeScript or LuaScript?
 	}
 
+	// Assets
+	// -------------------------------------
+
+	auto decodeTime = AssetManager::the().decodeTime();
+	size_t assetCount = 0;
+	if (sceneJson.exists("entities")) {
+		VERIFY(sceneJson.at("entities").type() == ruc::Json::Type::Array);
+		assetCount = prefetchAssets(sceneJson.at("entities"));
+	}
+	auto prefetched = std::chrono::steady_clock::now();
+	decodeTime = AssetManager::the().decodeTime() - decodeTime;
+
 	// Entities
 	// -------------------------------------
 
@@ -71,8 +93,14 @@ void Scene::initialize()
 			loadEntity(entities.at(i));
 		}
 	}
-
-	ruc::info("Scene initialized");
+	auto instantiated = std::chrono::steady_clock::now();
+
+	using Milliseconds = std::chrono::duration<float, std::milli>;
+	ruc::info("Scene initialized in {:.2f}ms", Milliseconds(instantiated - start).count());
+	ruc::info("  parse:       {:.2f}ms", Milliseconds(parsed - start).count());
+	ruc::info("  prefetch:    {:.2f}ms, {} assets, {:.2f}ms of decoding on the loader threads",
+	          Milliseconds(prefetched - parsed).count(), assetCount, Milliseconds(decodeTime).count());
+	ruc::info("  instantiate: {:.2f}ms", Milliseconds(instantiated - prefetched).count());
 }
 
 void Scene::update(float deltaTime)
@@ -171,6 +199,7 @@ uint32_t Scene::loadEntity(ruc::Json components, uint32_t parentEntity)
 	if (components.exists("model")) {
 		auto& text = addComponent<ModelComponent>(entity);
 		components.at("model").getTo(text);
+		loadModelInstances(entity, text);
 	}
 	if (components.exists("children")) {
 		VERIFY(components.at("children").type() == ruc::Json::Type::Array);
@@ -183,6 +212,93 @@ uint32_t Scene::loadEntity(ruc::Json components, uint32_t parentEntity)
 	return entity;
 }
 
+size_t Scene::prefetchAssets(const ruc::Json& entities)
+{
+	std::unordered_set<std::string> models;
+	std::unordered_set<std::string> textures;
+	std::unordered_set<std::string> cubemaps;
+	std::unordered_set<std::string> fonts;
+
+	auto collect = [](const ruc::Json& json, const char* component, const char* key, std::unordered_set<std::string>& paths) {
+		if (json.exists(component) && json.at(component).type() == ruc::Json::Type::Object
+		    && json.at(component).exists(key) && json.at(component).at(key).type() == ruc::Json::Type::String) {
+			paths.emplace(json.at(component).at(key).asString());
+		}
+	};
+
+	// Walk the same components as loadEntity, including the children
+	std::vector<const ruc::Json*> stack = { &entities };
+	while (!stack.empty()) {
+		const ruc::Json& json = *stack.back();
+		stack.pop_back();
+
+		if (json.type() == ruc::Json::Type::Array) {
+			const auto& array = json.asArray();
+			for (size_t i = 0; i < array.size(); ++i) {
+				stack.push_back(&array.at(i));
+			}
+			continue;
+		}
+		if (json.type() != ruc::Json::Type::Object) {
+			continue;
+		}
+
+		collect(json, "model", "model", models);
+		collect(json, "model", "texture", textures);
+		collect(json, "sprite", "texture", textures);
+		collect(json, "cubemap", "texture", cubemaps);
+		collect(json, "text", "font", fonts);
+
+		if (json.exists("children")) {
+			stack.push_back(&json.at("children"));
+		}
+	}
+
+	// Start all the background loads first
+	std::vector<AssetId> ids;
+	for (const auto& path : models) {
+		ids.push_back(AssetManager::the().loadHandle<Model>(path).id());
+	}
+	for (const auto& path : textures) {
+		ids.push_back(AssetManager::the().loadHandle<Texture2D>(path).id());
+	}
+	for (const auto& path : cubemaps) {
+		ids.push_back(AssetManager::the().loadHandle<TextureCubemap>(path).id());
+	}
+
+	// Fonts are created on the main thread, while the loader threads decode the rest
+	for (const auto& path : fonts) {
+		AssetManager::the().load<Font>(path);
+	}
+
+	AssetManager::the().wait(ids);
+
+	return ids.size() + fonts.size();
+}
+
+void Scene::loadModelInstances(uint32_t entity, ModelComponent model)
+{
+	// Only known once the model is decoded, which the prefetch waited for
+	Model* asset = model.model.get();
+	if (asset == nullptr || !asset->ready()) {
+		return;
+	}
+
+	for (const auto& instancing : asset->instancing()) {
+		model.model = AssetManager::the().loadHandle<Model>(instancing.path);
+		if (Model* part = model.model.get(); part != nullptr && model.residency) {
+			part->requestResidency(*model.residency);
+		}
+		for (const auto& transform : instancing.transforms) {
+			uint32_t instance = createEntity();
+			auto& component = getComponent<TransformComponent>(instance);
+			fromMatrix(transform, component);
+			component.parent = static_cast<entt::entity>(entity);
+			addComponent<ModelComponent>(instance, model);
+		}
+	}
+}
+
 uint32_t Scene::findEntity(std::string_view name)
 {
 	auto view = m_registry->view<TagComponent>();
@@ -22,6 +22,7 @@ namespace Inferno {
 
 class Camera;
 class Texture;
+struct ModelComponent;
 
 class Scene {
 public:
@@ -84,6 +85,12 @@ public:
 	// const entt::registry& registry() const { return m_registry; }
 	std::shared_ptr<entt::registry> registry() const { return m_registry; }
 
+private:
+	// Load every asset the entities reference concurrently, returns the amount of assets
+	size_t prefetchAssets(const ruc::Json& entities);
+	// Create an entity for every instance of the instanced parts of the model
+	void loadModelInstances(uint32_t entity, ModelComponent model);
+
 private:
 	std::shared_ptr<Texture> m_texture;
 	std::shared_ptr<Texture> m_texture2;
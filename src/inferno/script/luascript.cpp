@@ -4,13 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include "ruc/file.h"
 #include "sol/unsafe_function_result.hpp"
 
 #include "inferno/component/cameracomponent.h"
 #include "inferno/component/spritecomponent.h"
 #include "inferno/component/tagcomponent.h"
 #include "inferno/component/transformcomponent.h"
+#include "inferno/io/file-system.h"
 #include "inferno/scene/scene.h"
 #include "inferno/script/luascript.h"
 #include "inferno/script/registration.h"
@@ -69,7 +69,7 @@ void LuaScript::update(float deltaTime)
 
 void LuaScript::loadScript()
 {
-	std::string script = ruc::File(m_path).data();
+	std::string script(FileSystem::the().read(m_path).string());
 	auto result = m_state.script(script.c_str(),
 	                             [](lua_State*, sol::protected_function_result pfr) { return pfr; });
 	VERIFY(result.valid(), "LuaScript {}", ((sol::error)result).what());
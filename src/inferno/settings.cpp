@@ -11,7 +11,9 @@
 #include "ruc/format/log.h"
 #include "ruc/json/json.h"
 
+#include "inferno/io/file-system.h"
 #include "inferno/settings.h"
+#include "inferno/system/rendersystem.h"
 #include "inferno/window.h"
 
 namespace Inferno {
@@ -34,7 +36,7 @@ void Settings::destroy()
 
 bool Settings::load()
 {
-	auto object = ruc::Json::parse(ruc::File(m_path).data());
+	auto object = ruc::Json::parse(FileSystem::the().read(m_path).string());
 
 	if (object.type() != ruc::Json::Type::Object) {
 		ruc::warn("Settings invalid formatting, using default values");
@@ -65,7 +67,8 @@ bool Settings::save()
 void toJson(ruc::Json& object, const SettingsProperties& settings)
 {
 	object = ruc::Json {
-		{ "window", settings.window }
+		{ "window", settings.window },
+		{ "render", settings.render },
 	};
 }
 
@@ -75,6 +78,8 @@ void fromJson(const ruc::Json& object, SettingsProperties& settings)
 
 	if (object.exists("window"))
 		object.at("window").getTo(settings.window);
+	if (object.exists("render"))
+		object.at("render").getTo(settings.render);
 }
 
 void toJson(ruc::Json& object, const WindowProperties& window)
@@ -104,4 +109,31 @@ void fromJson(const ruc::Json& object, WindowProperties& window)
 		object.at("vsync").getTo(window.vsync);
 }
 
+void toJson(ruc::Json& object, const RenderProperties& render)
+{
+	object = ruc::Json {
+		{ "dynamic-resolution", render.dynamicResolution },
+		{ "target-frame-time", render.targetFrameTime },
+		{ "min-scale", render.minScale },
+		{ "max-scale", render.maxScale },
+		{ "depth-prepass", render.depthPrepass },
+	};
+}
+
+void fromJson(const ruc::Json& object, RenderProperties& render)
+{
+	VERIFY(object.type() == ruc::Json::Type::Object);
+
+	if (object.exists("dynamic-resolution"))
+		object.at("dynamic-resolution").getTo(render.dynamicResolution);
+	if (object.exists("target-frame-time"))
+		object.at("target-frame-time").getTo(render.targetFrameTime);
+	if (object.exists("min-scale"))
+		object.at("min-scale").getTo(render.minScale);
+	if (object.exists("max-scale"))
+		object.at("max-scale").getTo(render.maxScale);
+	if (object.exists("depth-prepass"))
+		object.at("depth-prepass").getTo(render.depthPrepass);
+}
+
 } // namespace Inferno
@@ -8,12 +8,14 @@
 
 #include "ruc/json/json.h"
 
+#include "inferno/system/rendersystem.h"
 #include "inferno/window.h"
 
 namespace Inferno {
 
 struct SettingsProperties {
 	WindowProperties window;
+	RenderProperties render;
 };
 
 class Settings {
@@ -41,4 +43,7 @@ void fromJson(const ruc::Json& object, SettingsProperties& settings);
 void toJson(ruc::Json& object, const WindowProperties& window);
 void fromJson(const ruc::Json& object, WindowProperties& window);
 
+void toJson(ruc::Json& object, const RenderProperties& render);
+void fromJson(const ruc::Json& object, RenderProperties& render);
+
 } // namespace Inferno
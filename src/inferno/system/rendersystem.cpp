@@ -4,21 +4,32 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <cstdint> // int32_t
+#include <algorithm> // std::clamp, std::max
+#include <cmath>     // std::abs, std::lerp, std::round, std::sqrt
+#include <cstdint>   // int32_t, uint32_t
+#include <span>
 
 #include "glad/glad.h"
+#include "glm/ext/matrix_float4x4.hpp" // glm::mat4
+#include "glm/ext/vector_float4.hpp"  // glm::vec4
+#include "glm/geometric.hpp"          // glm::dot, glm::length
 #include "ruc/format/log.h"
 
+#include "inferno/asset/model.h"
+#include "inferno/asset/texture.h"
 #include "inferno/component/cubemap-component.h"
 #include "inferno/component/model-component.h"
 #include "inferno/component/spritecomponent.h"
 #include "inferno/component/transformcomponent.h"
 #include "inferno/render/framebuffer.h"
+#include "inferno/render/gpu-query.h"
 #include "inferno/render/render-command.h"
+#include "inferno/render/render-graph.h"
 #include "inferno/render/renderer.h"
-#include "inferno/render/shader-storage-buffer.h"
+#include "inferno/render/shader-storage-arena.h"
 #include "inferno/render/shader-structs.h"
 #include "inferno/render/uniformbuffer.h"
+#include "inferno/settings.h"
 #include "inferno/system/camerasystem.h"
 #include "inferno/system/rendersystem.h"
 #include "inferno/system/textareasystem.h"
@@ -37,19 +48,8 @@ RenderSystem::~RenderSystem()
 
 void RenderSystem::initialize(uint32_t width, uint32_t height)
 {
-	m_framebuffer = Framebuffer::create({
-		.attachments = { Framebuffer::Type::Color, Framebuffer::Type::RGBA16F, Framebuffer::Type::RGBA16F, Framebuffer::Type::Depth },
-		.width = width,
-		.height = height,
-		.clearColor = { 0.0f, 0.0f, 0.0f, 0.0f },
-		.clearBit = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
-	});
-
-	m_screenFramebuffer = Framebuffer::create({
-		.renderToScreen = true,
-		.clearColor = { 1.0f, 1.0f, 1.0f, 1.0f },
-		.clearBit = GL_COLOR_BUFFER_BIT,
-	});
+	m_width = width;
+	m_height = height;
 
 	Uniformbuffer::the().setLayout(
 		"Camera", 0,
@@ -59,8 +59,11 @@ void RenderSystem::initialize(uint32_t width, uint32_t height)
 		});
 	Uniformbuffer::the().create("Camera");
 
-	ShaderStorageBuffer::the().setLayout("DirectionalLights", 0, RendererPostProcess::the().shaderID());
-	ShaderStorageBuffer::the().create("DirectionalLights");
+	// Per-frame storage, for the variable-length arrays of the shaders
+	m_storageArena = std::make_shared<ShaderStorageArena>(4096, true);
+
+	m_frameTimer = std::make_shared<GpuQuery>(GL_TIME_ELAPSED);
+	m_samplesQuery = std::make_shared<GpuQuery>(GL_SAMPLES_PASSED);
 
 	ruc::info("RenderSystem initialized");
 }
@@ -69,68 +72,249 @@ void RenderSystem::render()
 {
 	static constexpr TransformComponent transformIdentity;
 
-	// ---------------------------------
-	// Deferred rendering to a framebuffer
+	updateRenderScale();
+	updateDepthPrepass();
+	m_frameTimer->begin();
 
-	framebufferSetup(m_framebuffer);
+	auto [projection, view] = CameraSystem::the().projectionView();
+	auto translate = CameraSystem::the().translate();
+	Uniformbuffer::the().setValue("Camera", "u_projectionView", projection * view);
+	Uniformbuffer::the().setValue("Camera", "u_position", translate);
 
-	renderGeometry();
+	m_renderGraph.reset(m_width, m_height);
 
-	framebufferTeardown(m_framebuffer);
+	// The 3D scene is rendered at a lower resolution when the GPU is over budget
+	uint32_t width = std::max(1u, static_cast<uint32_t>(m_width * m_renderScale));
+	uint32_t height = std::max(1u, static_cast<uint32_t>(m_height * m_renderScale));
+	m_renderWidth = width;
+	m_renderHeight = height;
 
 	// ---------------------------------
-	// Forward rendering to the screen
+	// Deferred rendering to the G-buffer
+
+	// Only the nearest surface of every pixel is shaded after a depth pre-pass
+	RenderGraph::Resource depth;
+	if (m_depthPrepass) {
+		m_renderGraph.addPass(
+			"DepthPrepass",
+			[&](RenderGraph::Builder& builder) {
+				depth = builder.create("Depth", { width, height, Framebuffer::Type::Depth });
+				builder.write(depth, RenderGraph::LoadOp::Clear);
+			},
+			[this](const RenderGraph&) {
+				m_samplesQuery->begin();
+				renderDepthPrepass();
+				m_samplesQuery->end();
+			});
+	}
 
-	framebufferSetup(m_screenFramebuffer);
+	RenderGraph::Resource albedo;
+	RenderGraph::Resource position;
+	RenderGraph::Resource normal;
+	m_renderGraph.addPass(
+		"Geometry",
+		[&](RenderGraph::Builder& builder) {
+			albedo = builder.create("Albedo", { width, height, Framebuffer::Type::Color });
+			position = builder.create("Position", { width, height, Framebuffer::Type::RGBA16F });
+			normal = builder.create("Normal", { width, height, Framebuffer::Type::RGBA16F });
+			builder.write(albedo, RenderGraph::LoadOp::Clear);
+			builder.write(position, RenderGraph::LoadOp::Clear);
+			builder.write(normal, RenderGraph::LoadOp::Clear);
+			if (m_depthPrepass) {
+				builder.readDepth(depth);
+			}
+			else {
+				depth = builder.create("Depth", { width, height, Framebuffer::Type::Depth });
+				builder.write(depth, RenderGraph::LoadOp::Clear);
+			}
+			builder.setClearColor({ 0.0f, 0.0f, 0.0f, 0.0f });
+		},
+		[this](const RenderGraph&) {
+			if (!m_depthPrepass) {
+				m_samplesQuery->begin();
+				renderGeometry();
+				m_samplesQuery->end();
+				return;
+			}
+
+			RenderCommand::setDepthFunc(GL_EQUAL);
+			RenderCommand::setDepthMask(false);
+			renderGeometry();
+			RenderCommand::setDepthMask(true);
+			RenderCommand::setDepthFunc(GL_LESS);
+		});
 
-	renderSkybox();
+	// ---------------------------------
+	// Forward rendering of the scene
+
+	RenderGraph::Resource scene;
+	m_renderGraph.addPass(
+		"Skybox",
+		[&](RenderGraph::Builder& builder) {
+			scene = builder.create("Scene", { width, height, Framebuffer::Type::Color });
+			builder.write(scene, RenderGraph::LoadOp::Clear);
+			builder.setClearColor({ 1.0f, 1.0f, 1.0f, 1.0f });
+		},
+		[this](const RenderGraph&) { renderSkybox(); });
 
 	// Render 3D geometry post-processing
-	RendererPostProcess::the().drawQuad(transformIdentity, m_framebuffer->texture(0), m_framebuffer->texture(1), m_framebuffer->texture(2));
-	RendererPostProcess::the().endScene();
+	m_renderGraph.addPass(
+		"Lighting",
+		[&](RenderGraph::Builder& builder) {
+			builder.read(albedo);
+			builder.read(position);
+			builder.read(normal);
+			builder.write(scene);
+		},
+		[&](const RenderGraph& graph) {
+			RendererPostProcess::the().drawQuad(transformIdentity, graph.texture(albedo).get(), graph.texture(position).get(), graph.texture(normal).get());
+			RendererPostProcess::the().endScene();
+		});
+
+	// Visual representation of light sources, depth tested against the G-buffer
+	bool hasLightCubes = false;
+	for (auto [entity, cubemap] : m_registry->view<CubemapComponent>().each()) {
+		hasLightCubes |= cubemap.isLight;
+	}
+
+	m_renderGraph.addPass(
+		"LightCubes",
+		[&](RenderGraph::Builder& builder) {
+			if (hasLightCubes) {
+				builder.readDepth(depth);
+				builder.write(scene);
+			}
+		},
+		[this](const RenderGraph&) { renderLightCubes(); });
+
+	// Upsample the scene to the screen, with bilinear filtering
+	m_renderGraph.addBlitPass("Upsample", scene, RenderGraph::screenColor, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
-	// Visual representation of light sources
-	Framebuffer::copyBuffer(m_framebuffer, m_screenFramebuffer, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-	renderLightCubes();
+	// ---------------------------------
+	// Forward rendering to the screen, at native resolution
 
 	// Render 2D, UI
-	renderOverlay();
+	m_renderGraph.addPass(
+		"Overlay",
+		[](RenderGraph::Builder& builder) {
+			builder.write(RenderGraph::screenColor);
+		},
+		[this](const RenderGraph&) { renderOverlay(); });
+
+	m_renderGraph.compile();
+	m_renderGraph.execute();
 
-	framebufferTeardown(m_screenFramebuffer);
+	m_frameTimer->end();
+	m_storageArena->nextFrame();
 }
 
 void RenderSystem::resize(int32_t width, int32_t height)
 {
+	// Render targets of the new size are created by the render graph when first needed
 	RenderCommand::setViewport(0, 0, width, height);
-	m_framebuffer->resize(width, height);
-	m_screenFramebuffer->resize(width, height);
+	m_width = width;
+	m_height = height;
 }
 
 // -----------------------------------------
 
-void RenderSystem::framebufferSetup(std::shared_ptr<Framebuffer> framebuffer)
+void RenderSystem::updateRenderScale()
 {
-	framebuffer->bind();
+	const auto& properties = Settings::get().render;
+	if (!properties.dynamicResolution) {
+		m_targetScale = m_renderScale = properties.maxScale;
+		return;
+	}
+
+	if (!m_frameTimer->poll() || m_frameTimer->result() == 0) {
+		return;
+	}
 
-	RenderCommand::setColorAttachmentCount(framebuffer->colorAttachmentCount());
-	RenderCommand::clearColor(framebuffer->clearColor());
-	RenderCommand::clearBit(framebuffer->clearBit());
+	// The amount of pixels, and with it the fill cost, grows with the square of the scale
+	float frameTime = static_cast<float>(m_frameTimer->milliseconds());
+	float scale = m_targetScale * std::sqrt(properties.targetFrameTime / frameTime);
+
+	// Move slowly toward the budget, so a single slow frame doesnt cause a visible jump
+	m_targetScale = std::clamp(std::lerp(m_targetScale, scale, 0.1f), properties.minScale, properties.maxScale);
+
+	// Only change the resolution in steps, every new size allocates new render targets
+	constexpr float step = 0.05f;
+	if (std::abs(m_targetScale - m_renderScale) >= step) {
+		m_renderScale = std::clamp(std::round(m_targetScale / step) * step, properties.minScale, properties.maxScale);
+	}
 }
 
-void RenderSystem::framebufferTeardown(std::shared_ptr<Framebuffer> framebuffer)
+void RenderSystem::updateDepthPrepass()
 {
-	framebuffer->unbind();
+	if (m_samplesQuery->poll() && m_renderWidth > 0 && m_renderHeight > 0) {
+		// The geometry is depth tested with GL_LESS, in both the pre-pass and the G-buffer pass
+		float overdraw = static_cast<float>(m_samplesQuery->result()) / (m_renderWidth * m_renderHeight);
+		m_overdraw = std::lerp(m_overdraw, overdraw, 0.1f);
+	}
 
-	RenderCommand::setColorAttachmentCount(1);
+	const auto& mode = Settings::get().render.depthPrepass;
+	if (mode == "on") {
+		m_depthPrepass = true;
+		return;
+	}
+	if (mode == "off") {
+		m_depthPrepass = false;
+		return;
+	}
+
+	// Use separate thresholds, to avoid toggling every frame around a single value
+	if (!m_depthPrepass && m_overdraw > depthPrepassEnable) {
+		m_depthPrepass = true;
+	}
+	else if (m_depthPrepass && m_overdraw < depthPrepassDisable) {
+		m_depthPrepass = false;
+	}
 }
 
-void RenderSystem::renderGeometry()
+void RenderSystem::renderDepthPrepass()
 {
-	auto [projection, view] = CameraSystem::the().projectionView();
-	auto translate = CameraSystem::the().translate();
-	Uniformbuffer::the().setValue("Camera", "u_projectionView", projection * view);
-	Uniformbuffer::the().setValue("Camera", "u_position", translate);
+	Renderer3D::the().beginDepthPrepass();
+
+	auto modelView = m_registry->view<TransformComponent, ModelComponent>();
+
+	for (auto [entity, transform, model] : modelView.each()) {
+		Model* asset = model.model.get();
+		if (asset == nullptr || !asset->ready()) {
+			continue;
+		}
+
+		if (!visible(transform, asset->center(), asset->radius())) {
+			continue;
+		}
+
+		// Same submeshes as the geometry pass, which depth tests against these
+		m_meshRanges.clear();
+		for (const auto& submesh : asset->submeshes()) {
+			if (!visible(transform, submesh.center(), submesh.radius())) {
+				continue;
+			}
+
+			if (asset->vertexArray()) {
+				m_meshRanges.push_back({ submesh.elementOffset, submesh.elementCount });
+				continue;
+			}
+			Renderer3D::the().drawModelDepth(asset->vertices().subspan(submesh.vertexOffset, submesh.vertexCount),
+			                                 asset->elements().subspan(submesh.elementOffset, submesh.elementCount),
+			                                 transform,
+			                                 submesh.vertexOffset);
+		}
+
+		// The GPU submeshes of the entity in one draw call
+		if (asset->vertexArray()) {
+			Renderer3D::the().drawMeshDepth(asset->depthVertexArray(), transform, m_meshRanges);
+		}
+	}
+
+	Renderer3D::the().endScene();
+}
 
+void RenderSystem::renderGeometry()
+{
 	static DirectionalLightBlock directionalLights[2] = {
 		{
 			.direction = { -8.0f, -8.0f, -8.0f },
@@ -145,16 +329,57 @@ void RenderSystem::renderGeometry()
 			.specular = { 1.0f, 0.0f, 0.0f },
 		},
 	};
-	ShaderStorageBuffer::the().setValue("DirectionalLights", "u_directionalLight", directionalLights);
+	std::span<const DirectionalLightBlock> lights = directionalLights;
+	if (m_directionalLights.size != lights.size_bytes()) {
+		m_storageArena->free(m_directionalLights);
+		m_directionalLights = m_storageArena->allocate(lights.size_bytes());
+	}
+	m_storageArena->setValues(m_directionalLights, lights);
+	m_storageArena->upload();
+	m_storageArena->bind(m_directionalLights, 0);
 
 	auto modelView = m_registry->view<TransformComponent, ModelComponent>();
 
 	for (auto [entity, transform, model] : modelView.each()) {
-		Renderer3D::the().drawModel(model.model->vertices(),
-		                            model.model->elements(),
-		                            transform,
-		                            model.color,
-		                            model.model->texture() ? model.model->texture() : model.texture);
+		// Still loading, nothing to draw yet
+		Model* asset = model.model.get();
+		if (asset == nullptr || !asset->ready()) {
+			continue;
+		}
+
+		if (!visible(transform, asset->center(), asset->radius())) {
+			continue;
+		}
+
+		// Every submesh is culled on its own and drawn with its material
+		m_meshRanges.clear();
+		for (const auto& submesh : asset->submeshes()) {
+			if (!visible(transform, submesh.center(), submesh.radius())) {
+				continue;
+			}
+
+			const Material& material = asset->materials()[submesh.material];
+			Texture2D* texture = asset->texture(material) ? asset->texture(material) : model.texture.get();
+			if (texture != nullptr && texture->streamed()) {
+				texture->requestSize(projectedSize(transform, submesh.center(), submesh.radius()));
+			}
+
+			if (asset->vertexArray()) {
+				m_meshRanges.push_back({ submesh.elementOffset, submesh.elementCount, model.color * material.color, texture });
+				continue;
+			}
+			Renderer3D::the().drawModel(asset->vertices().subspan(submesh.vertexOffset, submesh.vertexCount),
+			                            asset->elements().subspan(submesh.elementOffset, submesh.elementCount),
+			                            transform,
+			                            model.color * material.color,
+			                            texture,
+			                            submesh.vertexOffset);
+		}
+
+		// The GPU submeshes of the entity, grouped on their material
+		if (asset->vertexArray()) {
+			Renderer3D::the().drawMesh(asset->vertexArray(), transform, m_meshRanges);
+		}
 	}
 
 	Renderer3D::the().endScene();
@@ -169,7 +394,7 @@ void RenderSystem::renderSkybox()
 
 	for (auto [entity, transform, cubemap] : cubemapView.each()) {
 		if (!cubemap.isLight) {
-			RendererCubemap::the().drawCubemap(transform, cubemap.color, cubemap.texture);
+			RendererCubemap::the().drawCubemap(transform, cubemap.color, cubemap.texture.get());
 		}
 	}
 
@@ -197,7 +422,15 @@ void RenderSystem::renderOverlay()
 	auto quadView = m_registry->view<TransformComponent, SpriteComponent>();
 
 	for (auto [entity, transform, sprite] : quadView.each()) {
-		Renderer2D::the().drawQuad(transform, sprite.color, sprite.texture);
+		Texture* texture = sprite.texture.get();
+		if (texture != nullptr && texture->isTexture2D() && static_cast<Texture2D*>(texture)->streamed()) {
+			// The quad covers the screen in normalized device coordinates before the transform
+			float width = glm::length(glm::vec3(transform.transform[0])) * m_width;
+			float height = glm::length(glm::vec3(transform.transform[1])) * m_height;
+			static_cast<Texture2D*>(texture)->requestSize(std::max(width, height));
+		}
+
+		Renderer2D::the().drawQuad(transform, sprite.color, texture);
 	}
 
 	Renderer2D::the().endScene();
@@ -206,4 +439,49 @@ void RenderSystem::renderOverlay()
 	RendererFont::the().endScene();
 }
 
+// Largest scale of the transform
+static float largestScale(const glm::mat4& transform)
+{
+	return std::max({ glm::length(glm::vec3(transform[0])),
+	                  glm::length(glm::vec3(transform[1])),
+	                  glm::length(glm::vec3(transform[2])) });
+}
+
+float RenderSystem::projectedSize(const TransformComponent& transform, glm::vec3 center, float radius) const
+{
+	auto [projection, view] = CameraSystem::the().projectionView();
+	glm::vec4 position = projection * view * transform.transform * glm::vec4(center, 1.0f);
+	float scale = largestScale(transform.transform);
+
+	// The camera is inside the sphere
+	if (position.w <= radius * scale) {
+		return static_cast<float>(m_renderHeight);
+	}
+
+	return radius * scale * projection[1][1] / position.w * m_renderHeight;
+}
+
+bool RenderSystem::visible(const TransformComponent& transform, glm::vec3 center, float radius) const
+{
+	auto [projection, view] = CameraSystem::the().projectionView();
+	glm::mat4 projectionView = projection * view;
+	glm::vec3 position = glm::vec3(transform.transform * glm::vec4(center, 1.0f));
+	radius *= largestScale(transform.transform);
+
+	// The planes of the frustum in world space are sums of the rows of the matrix
+	auto row = [&projectionView](int32_t i) {
+		return glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+	};
+	for (int32_t i = 0; i < 3; ++i) {
+		for (float sign : { 1.0f, -1.0f }) {
+			glm::vec4 plane = row(3) + sign * row(i);
+			if (glm::dot(glm::vec3(plane), position) + plane.w < -radius * glm::length(glm::vec3(plane))) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 } // namespace Inferno
@@ -8,17 +8,36 @@
 
 #include <cstdint> // int32_t, uint32_t
 #include <memory>  //std::shared_ptr
+#include <string>  // std::string
+#include <vector>
 
-#include "entt/entity/fwd.hpp" // entt::registry
-
+#include "entt/entity/fwd.hpp"       // entt::registry
+#include "glm/ext/vector_float3.hpp" // glm::vec3
 #include "ruc/singleton.h"
 
+#include "inferno/render/gpu-query.h"
+#include "inferno/render/render-graph.h"
+#include "inferno/render/renderer.h"
+#include "inferno/render/shader-storage-arena.h"
+
 namespace Inferno {
 
-class Framebuffer;
+struct TransformComponent;
+
+struct RenderProperties {
+	bool dynamicResolution { true };
+	float targetFrameTime { 16.6f }; // GPU time per frame, in milliseconds
+	float minScale { 0.5f };
+	float maxScale { 1.0f };
+	std::string depthPrepass { "auto" }; // auto/on/off
+};
 
 class RenderSystem final : public ruc::Singleton<RenderSystem> {
 public:
+	// Overdraw at which the depth pre-pass is turned on and off again
+	static constexpr const float depthPrepassEnable = 1.5f;
+	static constexpr const float depthPrepassDisable = 1.2f;
+
 	RenderSystem(s);
 	virtual ~RenderSystem();
 
@@ -29,16 +48,40 @@ public:
 
 	void setRegistry(std::shared_ptr<entt::registry> registry) { m_registry = registry; };
 
+	float renderScale() const { return m_renderScale; }
+	float overdraw() const { return m_overdraw; }
+	bool depthPrepass() const { return m_depthPrepass; }
+
 private:
-	void framebufferSetup(std::shared_ptr<Framebuffer> framebuffer);
-	void framebufferTeardown(std::shared_ptr<Framebuffer> framebuffer);
+	void updateRenderScale();
+	void updateDepthPrepass();
+	void renderDepthPrepass();
 	void renderGeometry();
 	void renderSkybox();
 	void renderLightCubes();
 	void renderOverlay();
 
-	std::shared_ptr<Framebuffer> m_framebuffer;
-	std::shared_ptr<Framebuffer> m_screenFramebuffer;
+	// Diameter in pixels of a bounding sphere in model space, drawn with this transform
+	float projectedSize(const TransformComponent& transform, glm::vec3 center, float radius) const;
+	// Bounding sphere in model space, drawn with this transform, is inside the view frustum
+	bool visible(const TransformComponent& transform, glm::vec3 center, float radius) const;
+
+	uint32_t m_width { 0 };
+	uint32_t m_height { 0 };
+	float m_renderScale { 1.0f };
+	float m_targetScale { 1.0f };
+	std::shared_ptr<GpuQuery> m_frameTimer;
+	uint32_t m_renderWidth { 0 };
+	uint32_t m_renderHeight { 0 };
+
+	// Fragments that pass the GL_LESS depth test, per pixel of the render target
+	bool m_depthPrepass { false };
+	float m_overdraw { 0.0f };
+	std::shared_ptr<GpuQuery> m_samplesQuery;
+	RenderGraph m_renderGraph;
+	std::shared_ptr<ShaderStorageArena> m_storageArena;
+	ArenaRange m_directionalLights;
+	std::vector<MeshRange> m_meshRanges; // Visible submeshes of the entity being drawn
 	std::shared_ptr<entt::registry> m_registry;
 };
 
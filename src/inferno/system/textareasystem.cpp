@@ -4,10 +4,12 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm> // std::erase_if, std::find, std::sort, std::unique
+#include <vector>
+
+#include "entt/entity/registry.hpp" // entt::registry
 #include "ruc/format/log.h"
-#include "ruc/meta/assert.h"
 
-#include "inferno/application.h"
 #include "inferno/asset/font.h"
 #include "inferno/asset/texture.h"
 #include "inferno/component/textareacomponent.h"
@@ -15,7 +17,7 @@
 #include "inferno/render/renderer.h"
 #include "inferno/scene/scene.h"
 #include "inferno/system/textareasystem.h"
-#include "inferno/window.h"
+#include "inferno/util/utf8.h"
 
 namespace Inferno {
 
@@ -28,59 +30,126 @@ TextAreaSystem::~TextAreaSystem()
 {
 }
 
+bool TextLayout::matches(const TextAreaComponent& textarea) const
+{
+	return fontSize == textarea.fontSize
+	       && lineSpacing == textarea.lineSpacing
+	       && width == textarea.width
+	       && font == textarea.font
+	       && content == textarea.content;
+}
+
+// -----------------------------------------
+
 void TextAreaSystem::render()
 {
-	auto view = m_scene->registry()->view<TransformComponent, TextAreaComponent>();
+	auto registry = m_scene->registry();
+	auto view = registry->view<TransformComponent, TextAreaComponent>();
 
-	glm::ivec2 viewport = {
-		Application::the().window().getWidth(),
-		Application::the().window().getHeight(),
-	};
+	// Cached layouts don't look up their glyphs, mark them as used first so that laying
+	// out the changed text areas doesn't evict them
+	for (auto [entity, transform, textarea] : view.each()) {
+		TextLayout& layout = m_layouts[entity];
+		if (layout.fontAsset && layout.matches(textarea)) {
+			layout.fontAsset->touch(layout.codepoints);
+		}
+	}
+
+	for (auto [entity, transform, textarea] : view.each()) {
+		// Only lay out the text again if it has changed since the last frame
+		TextLayout& layout = m_layouts[entity];
+		if (!layout.fontAsset || !layout.matches(textarea)) {
+			createLayout(layout, textarea);
+		}
+	}
+
+	// Glyphs used this frame are never evicted, so this only catches the glyphs that
+	// were evicted while their layout was not drawn. Only the layouts that contain an
+	// evicted glyph are laid out again
+	for (auto [entity, transform, textarea] : view.each()) {
+		TextLayout& layout = m_layouts[entity];
+		if (layout.fontAsset->evicted(layout.codepoints, layout.generation)) {
+			createLayout(layout, textarea);
+		}
+	}
+
+	m_fonts.clear();
+	for (auto [entity, transform, textarea] : view.each()) {
+		TextLayout& layout = m_layouts[entity];
+		if (std::find(m_fonts.begin(), m_fonts.end(), layout.fontAsset.get()) == m_fonts.end()) {
+			m_fonts.push_back(layout.fontAsset.get());
+		}
+	}
+
+	// Upload newly rasterized glyphs before any text is drawn
+	for (auto* font : m_fonts) {
+		font->upload();
+	}
 
 	for (auto [entity, transform, textarea] : view.each()) {
-		// Loop through textareas content
-		// Linebreak if width reached
-		// Break if lines AND width reached
-		// Calculate symbol quad
-		// Submit symbol quad for rendering
-
-		std::shared_ptr<Font> font = AssetManager::the().load<Font>(textarea.font);
-		// glm::mat4 translate = transform.translate;
-
-		m_symbols.clear();
-		createLines(font, textarea);
-		createQuads(font, textarea);
+		TextLayout& layout = m_layouts[entity];
+		uint32_t style = RendererFont::the().addStyle(layout.style);
+		RendererFont::the().drawSymbols(layout.symbols, layout.fontAsset->texture().get(), style);
+	}
+
+	// Drop the layouts of destroyed text areas
+	if (m_layouts.size() > view.size_hint()) {
+		std::erase_if(m_layouts, [&registry](const auto& layout) {
+			return !registry->valid(layout.first) || !registry->has<TextAreaComponent>(layout.first);
+		});
 	}
 }
 
-using Symbols = std::vector<std::shared_ptr<Symbol>>;
+void TextAreaSystem::createLayout(TextLayout& layout, const TextAreaComponent& textarea)
+{
+	if (!layout.fontAsset || layout.font != textarea.font) {
+		layout.fontAsset = AssetManager::the().load<Font>(textarea.font);
+	}
+
+	layout.content = textarea.content;
+	layout.font = textarea.font;
+	layout.fontSize = textarea.fontSize;
+	layout.lineSpacing = textarea.lineSpacing;
+	layout.width = textarea.width;
+
+	// Loop through textareas content
+	// Linebreak if width reached
+	// Break if lines AND width reached
+	// Calculate symbol quads
+
+	m_symbols.clear();
+	layout.symbols.clear();
+	createLines(layout.fontAsset, textarea);
+	createQuads(layout.fontAsset, textarea, layout.symbols);
+	layout.generation = layout.fontAsset->generation();
+
+	layout.codepoints.clear();
+	for (const auto* symbol : m_symbols) {
+		if (symbol != nullptr) {
+			layout.codepoints.push_back(symbol->id);
+		}
+	}
+	std::sort(layout.codepoints.begin(), layout.codepoints.end());
+	layout.codepoints.erase(std::unique(layout.codepoints.begin(), layout.codepoints.end()), layout.codepoints.end());
+}
 
 void TextAreaSystem::createLines(std::shared_ptr<Font> font, const TextAreaComponent& textarea)
 {
 	float fontScale = textarea.fontSize / (float)font->size();
 
-	// Texture
-	// -------------------------------------
-
-	float textureWidth = static_cast<float>(font->texture()->width());
-	float textureHeight = static_cast<float>(font->texture()->height());
-	VERIFY(textureWidth == textureHeight, "TextAreaSystem read invalid font texture");
-
-	// -------------------------------------
-
-	char previous = 0;
+	uint32_t previous = 0;
 	size_t spaceIndex = 0;
 	float lineWidth = 0.0f;
 	float lineWidthSinceLastSpace = 0.0f;
-	for (char symbol : textarea.content) {
-		auto c = font->get(symbol);
+	for (size_t i = 0; i < textarea.content.size();) {
+		uint32_t symbol = UTF8::decode(textarea.content, i);
+		const Symbol* c = font->get(symbol);
+		if (c == nullptr) {
+			continue;
+		}
 		m_symbols.push_back(c);
 
-		// Kerning
-		char kerning = 0;
-		if (c->kernings.find(previous) != c->kernings.end()) {
-			kerning = c->kernings.at(previous);
-		}
+		float kerning = font->kerning(previous, symbol);
 
 		lineWidth += (c->advance + kerning) * fontScale;
 		lineWidthSinceLastSpace += (c->advance + kerning) * fontScale;
@@ -90,7 +159,7 @@ void TextAreaSystem::createLines(std::shared_ptr<Font> font, const TextAreaCompo
 			lineWidthSinceLastSpace = 0;
 		}
 
-		if (lineWidth > textureWidth) {
+		if (lineWidth > layoutSize) {
 			m_symbols[spaceIndex] = nullptr;
 			lineWidth = 0;
 			lineWidth = lineWidthSinceLastSpace;
@@ -100,11 +169,11 @@ void TextAreaSystem::createLines(std::shared_ptr<Font> font, const TextAreaCompo
 	}
 }
 
-void TextAreaSystem::createQuads(std::shared_ptr<Font> font, const TextAreaComponent& textarea)
+void TextAreaSystem::createQuads(std::shared_ptr<Font> font, const TextAreaComponent& textarea, std::vector<SymbolInstance>& symbols)
 {
 	float fontScale = textarea.fontSize / (float)font->size();
 
-	char previous = 0;
+	uint32_t previous = 0;
 	float advanceX = 0.0f;
 	float advanceY = 0.0f;
 	for (const auto& symbol : m_symbols) {
@@ -115,25 +184,18 @@ void TextAreaSystem::createQuads(std::shared_ptr<Font> font, const TextAreaCompo
 			continue;
 		}
 
-		std::optional<SymbolQuad> quad = calculateSymbolQuad(symbol, previous, font, fontScale, advanceX, advanceY);
+		std::optional<SymbolInstance> quad = calculateSymbolQuad(symbol, previous, font, fontScale, advanceX, advanceY);
 		if (quad) {
-			RendererFont::the().drawSymbol(quad.value(), font->texture());
+			symbols.push_back(*quad);
 		}
 
 		previous = symbol->id;
 	}
 }
 
-std::optional<SymbolQuad> TextAreaSystem::calculateSymbolQuad(std::shared_ptr<Symbol> c, char previous, std::shared_ptr<Font> font, float fontScale, float& advanceX, float& advanceY)
+std::optional<SymbolInstance> TextAreaSystem::calculateSymbolQuad(const Symbol* c, uint32_t previous, std::shared_ptr<Font> font, float fontScale, float& advanceX, float& advanceY)
 {
-	SymbolQuad symbolQuad;
-
-	// Texture
-	// -------------------------------------
-
-	float textureWidth = static_cast<float>(font->texture()->width());
-	float textureHeight = static_cast<float>(font->texture()->height());
-	VERIFY(textureWidth == textureHeight, "TextAreaSystem read invalid font texture");
+	SymbolInstance symbolQuad;
 
 	// Skip empty symbols (like space)
 	if (c->size.x == 0 || c->size.y == 0) {
@@ -145,31 +207,25 @@ std::optional<SymbolQuad> TextAreaSystem::calculateSymbolQuad(std::shared_ptr<Sy
 	// Position
 	// -------------------------------------
 
-	// Kerning
-	char kerning = 0;
-	if (c->kernings.find(previous) != c->kernings.end()) {
-		kerning = c->kernings.at(previous);
-	}
+	float kerning = font->kerning(previous, c->id);
 
 	glm::vec2 cursor = { advanceX + (c->offset.x * fontScale) + (kerning * fontScale),
 		                 advanceY - (c->offset.y * fontScale) };
 	glm::vec2 cursorMax = { cursor.x + (c->size.x * fontScale),
 		                    cursor.y - (c->size.y * fontScale) };
 
-	// Scale the values from 0:512 (texture size) to -1:1 (screen space)
+	// Scale the values from 0:512 (layout size) to -1:1 (screen space)
 	glm::vec2 cursorScreen = {
-		(cursor.x / textureWidth * 2) - 1,
-		(cursor.y / textureHeight * 2) + 1,
+		(cursor.x / layoutSize * 2) - 1,
+		(cursor.y / layoutSize * 2) + 1,
 	};
 	glm::vec2 cursorScreenMax = {
-		(cursorMax.x / textureWidth * 2) - 1,
-		(cursorMax.y / textureHeight * 2) + 1,
+		(cursorMax.x / layoutSize * 2) - 1,
+		(cursorMax.y / layoutSize * 2) + 1,
 	};
 
-	symbolQuad.at(0).quad.position = { cursorScreen.x, cursorScreenMax.y, 0.0f };    // bottom left
-	symbolQuad.at(1).quad.position = { cursorScreenMax.x, cursorScreenMax.y, 0.0f }; // bottom right
-	symbolQuad.at(2).quad.position = { cursorScreenMax.x, cursorScreen.y, 0.0f };    // top right
-	symbolQuad.at(3).quad.position = { cursorScreen.x, cursorScreen.y, 0.0f };       // top left
+	// Bottom left, top right
+	symbolQuad.position = { cursorScreen.x, cursorScreenMax.y, cursorScreenMax.x, cursorScreen.y };
 
 	// Jump to the next glyph
 	advanceX += (c->advance + kerning) * fontScale;
@@ -177,19 +233,7 @@ std::optional<SymbolQuad> TextAreaSystem::calculateSymbolQuad(std::shared_ptr<Sy
 	// Texture coordinates
 	// -------------------------------------
 
-	glm::vec2 x {
-		1 - (textureWidth - c->position.x) / textureWidth,
-		1 - (textureWidth - c->position.x - c->size.x) / textureWidth
-	};
-	glm::vec2 y {
-		(textureHeight - c->position.y - c->size.y) / textureHeight,
-		(textureHeight - c->position.y) / textureHeight
-	};
-
-	symbolQuad.at(0).quad.textureCoordinates = { x.x, y.x };
-	symbolQuad.at(1).quad.textureCoordinates = { x.y, y.x };
-	symbolQuad.at(2).quad.textureCoordinates = { x.y, y.y };
-	symbolQuad.at(3).quad.textureCoordinates = { x.x, y.y };
+	symbolQuad.textureCoordinates = { c->textureMin.x, c->textureMin.y, c->textureMax.x, c->textureMax.y };
 
 	return symbolQuad;
 }
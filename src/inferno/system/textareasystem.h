@@ -6,10 +6,14 @@
 
 #pragma once
 
+#include <cstdint>  // uint32_t
 #include <memory>   // std::shared_ptr
 #include <optional> // std::optional
-#include <vector>   // std::vector
+#include <string>   // std::string
+#include <unordered_map>
+#include <vector> // std::vector
 
+#include "entt/entity/fwd.hpp" // entt::entity
 #include "ruc/singleton.h"
 
 #include "inferno/asset/font.h"
@@ -17,14 +21,33 @@
 
 namespace Inferno {
 
-using Symbols = std::vector<std::shared_ptr<Symbol>>;
-using SymbolQuad = std::array<SymbolVertex, RendererFont::vertexPerQuad>;
+using Symbols = std::vector<const Symbol*>;
 
 class Scene;
 class TextAreaComponent;
 
+// Glyph instances of a text area, built once and resubmitted until the text changes
+struct TextLayout {
+	std::string content;
+	std::string font;
+	unsigned char fontSize { 0 };
+	float lineSpacing { 0.0f };
+	uint32_t width { 0 };
+
+	std::shared_ptr<Font> fontAsset;
+	uint32_t generation { 0 };        // Font atlas generation the texture coordinates belong to
+	std::vector<uint32_t> codepoints; // Unique codepoints of the symbols, kept in the atlas while drawn
+	std::vector<SymbolInstance> symbols;
+	SymbolStyle style;
+
+	bool matches(const TextAreaComponent& textarea) const;
+};
+
 class TextAreaSystem final : public ruc::Singleton<TextAreaSystem> {
 public:
+	// Text is laid out in a square of this size, which is then mapped onto the screen
+	static constexpr const float layoutSize = 512.0f;
+
 	TextAreaSystem(s);
 	virtual ~TextAreaSystem();
 
@@ -33,12 +56,15 @@ public:
 	void setScene(Scene* scene) { m_scene = scene; }
 
 private:
+	void createLayout(TextLayout& layout, const TextAreaComponent& textarea);
 	void createLines(std::shared_ptr<Font> font, const TextAreaComponent& textarea);
-	void createQuads(std::shared_ptr<Font> font, const TextAreaComponent& textarea);
+	void createQuads(std::shared_ptr<Font> font, const TextAreaComponent& textarea, std::vector<SymbolInstance>& symbols);
 
-	std::optional<SymbolQuad> calculateSymbolQuad(std::shared_ptr<Symbol> c, char previous, std::shared_ptr<Font> font, float fontSize, float& advanceX, float& advanceY);
+	std::optional<SymbolInstance> calculateSymbolQuad(const Symbol* c, uint32_t previous, std::shared_ptr<Font> font, float fontSize, float& advanceX, float& advanceY);
 
 	Symbols m_symbols;
+	std::vector<Font*> m_fonts; // Fonts drawn this frame
+	std::unordered_map<entt::entity, TextLayout> m_layouts;
 	Scene* m_scene { nullptr };
 };
 
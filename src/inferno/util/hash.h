@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <bit>     // std::rotl
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint64_t
+#include <cstring> // std::memcpy
+#include <span>
+
+namespace Inferno {
+
+// Hash of a block of memory, for comparing large buffers by content.
+// Based on XXH64, four lanes of 8 bytes are mixed independently.
+inline uint64_t hashBytes(std::span<const uint8_t> data, uint64_t seed = 0)
+{
+	constexpr uint64_t prime1 = 0x9e3779b185ebca87;
+	constexpr uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+	constexpr uint64_t prime3 = 0x165667b19e3779f9;
+	constexpr uint64_t prime4 = 0x85ebca77c2b2ae63;
+	constexpr uint64_t prime5 = 0x27d4eb2f165667c5;
+
+	auto read = [](const uint8_t* pointer) {
+		uint64_t value = 0;
+		std::memcpy(&value, pointer, sizeof(value));
+		return value;
+	};
+	auto round = [](uint64_t accumulator, uint64_t input) {
+		return std::rotl(accumulator + input * prime2, 31) * prime1;
+	};
+	auto merge = [&round](uint64_t hash, uint64_t lane) {
+		return (hash ^ round(0, lane)) * prime1 + prime4;
+	};
+
+	const uint8_t* pointer = data.data();
+	const uint8_t* end = pointer + data.size();
+	uint64_t hash = 0;
+
+	if (data.size() >= 32) {
+		uint64_t lanes[4] = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+		for (; pointer + 32 <= end; pointer += 32) {
+			for (size_t i = 0; i < 4; ++i) {
+				lanes[i] = round(lanes[i], read(pointer + i * 8));
+			}
+		}
+
+		hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+		for (uint64_t lane : lanes) {
+			hash = merge(hash, lane);
+		}
+	}
+	else {
+		hash = seed + prime5;
+	}
+
+	hash += data.size();
+
+	for (; pointer + 8 <= end; pointer += 8) {
+		hash = std::rotl(hash ^ round(0, read(pointer)), 27) * prime1 + prime4;
+	}
+	for (; pointer < end; ++pointer) {
+		hash = std::rotl(hash ^ (*pointer * prime5), 11) * prime1;
+	}
+
+	// Avalanche, every input bit affects every output bit
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+} // namespace Inferno
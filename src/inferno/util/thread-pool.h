@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint> // uint32_t
+#include <deque>
+#include <functional> // std::function
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Inferno {
+
+// Fixed amount of worker threads that run tasks in the order they are queued
+class ThreadPool final {
+public:
+	// Uses one thread less than the hardware supports when threadCount is 0,
+	// leaving a core for the main thread
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	void enqueue(std::function<void()> task);
+
+	uint32_t size() const { return static_cast<uint32_t>(m_threads.size()); }
+
+private:
+	void work();
+
+	bool m_stop { false };
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<std::function<void()>> m_tasks;
+	std::vector<std::thread> m_threads;
+};
+
+} // namespace Inferno
+
+#if 0
+
+// -----------------------------------------
+// Example usage:
+
+ThreadPool pool;
+pool.enqueue([]() { /* runs on a worker thread */ });
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
+#include <string_view>
+
+namespace Inferno::UTF8 {
+
+static constexpr const uint32_t replacementCharacter = 0xfffd;
+
+// Decode the codepoint starting at index and move index past it,
+// invalid sequences decode to the replacement character
+inline uint32_t decode(std::string_view string, size_t& index)
+{
+	uint8_t lead = static_cast<uint8_t>(string[index++]);
+	if (lead < 0x80) {
+		return lead;
+	}
+
+	size_t length = 0;
+	uint32_t codepoint = 0;
+	if ((lead & 0xe0) == 0xc0) {
+		length = 1;
+		codepoint = lead & 0x1f;
+	}
+	else if ((lead & 0xf0) == 0xe0) {
+		length = 2;
+		codepoint = lead & 0x0f;
+	}
+	else if ((lead & 0xf8) == 0xf0) {
+		length = 3;
+		codepoint = lead & 0x07;
+	}
+	else {
+		return replacementCharacter;
+	}
+
+	for (size_t i = 0; i < length; ++i) {
+		if (index >= string.size() || (static_cast<uint8_t>(string[index]) & 0xc0) != 0x80) {
+			return replacementCharacter;
+		}
+		codepoint = (codepoint << 6) | (static_cast<uint8_t>(string[index++]) & 0x3f);
+	}
+
+	// Reject overlong encodings, surrogates and values out of range
+	static constexpr uint32_t minimum[4] = { 0, 0x80, 0x800, 0x10000 };
+	if (codepoint < minimum[length] || (codepoint >= 0xd800 && codepoint <= 0xdfff) || codepoint > 0x10ffff) {
+		return replacementCharacter;
+	}
+
+	return codepoint;
+}
+
+} // namespace Inferno::UTF8
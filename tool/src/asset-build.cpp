@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>  // std::sort, std::unique
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t, uint64_t
+#include <filesystem> // std::filesystem::exists, std::filesystem::recursive_directory_iterator
+#include <fstream>    // std::ifstream, std::ofstream
+#include <iomanip>    // std::setprecision
+#include <mutex>      // std::lock_guard, std::unique_lock
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "ruc/format/log.h"
+
+#include "inferno/asset/font.h"
+#include "inferno/asset/model.h"
+#include "inferno/asset/texture.h"
+#include "inferno/io/file-system.h"
+#include "inferno/io/mapped-file.h"
+#include "inferno/io/pak.h"
+#include "inferno/util/hash.h"
+#include "inferno/util/thread-pool.h"
+
+#include "asset-build.h"
+
+namespace Inferno {
+
+// Bump when the block compression of the textures changes
+static constexpr const uint32_t textureVersion = 1;
+
+AssetBuild::AssetBuild(std::string_view directory, std::string_view archive, bool compress)
+	: m_directory(directory)
+	, m_archive(archive)
+	, m_compress(compress)
+{
+}
+
+bool AssetBuild::run()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	loadManifest();
+	scan();
+
+	size_t staleCount = 0;
+	for (auto& job : m_jobs) {
+		job.hash = hash(job);
+		auto it = m_manifest.find(job.path);
+		job.stale = it == m_manifest.end() || it->second.hash != job.hash || !std::filesystem::exists(job.output);
+		staleCount += job.stale;
+	}
+
+	// Convert on every core, the converters only share the read-only file layer
+	{
+		std::mutex mutex;
+		std::condition_variable condition;
+		size_t remaining = staleCount;
+
+		ThreadPool pool(std::thread::hardware_concurrency());
+		for (auto& job : m_jobs) {
+			if (!job.stale) {
+				continue;
+			}
+
+			pool.enqueue([this, &job, &mutex, &condition, &remaining]() {
+				auto jobStart = std::chrono::steady_clock::now();
+				std::vector<std::string> reads { job.path };
+				if (job.recordInputs) {
+					FileSystem::the().recordReads(&reads);
+				}
+				job.result = job.convert();
+				job.time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+
+				// Hashed again over what the conversion actually read, for the next build
+				if (job.recordInputs) {
+					FileSystem::the().recordReads(nullptr);
+					std::sort(reads.begin(), reads.end());
+					reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+					job.inputs = std::move(reads);
+					job.hash = hash(job);
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--remaining == 0) {
+					condition.notify_one();
+				}
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&remaining]() { return remaining == 0; });
+	}
+
+	// The archive depends on every file in the directory, including the converted ones
+	Job pak { m_compress ? "pak --compress" : "pak", PakHeader::currentVersion, m_archive, m_archive, {}, {} };
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(m_directory)) {
+		if (entry.is_regular_file()) {
+			pak.inputs.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(pak.inputs.begin(), pak.inputs.end());
+	pak.hash = hash(pak);
+	auto it = m_manifest.find(pak.path);
+	pak.stale = it == m_manifest.end() || it->second.hash != pak.hash || !std::filesystem::exists(pak.output);
+	if (pak.stale) {
+		auto pakStart = std::chrono::steady_clock::now();
+		pak.result = Pak::write(m_archive, pak.inputs, m_compress);
+		pak.time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pakStart).count();
+		staleCount++;
+	}
+	m_jobs.push_back(std::move(pak));
+
+	// Failed conversions are left out, so they are tried again in the next build
+	size_t failedCount = 0;
+	for (const auto& job : m_jobs) {
+		if (job.result) {
+			m_manifest[job.path] = { job.hash, job.recordInputs ? job.inputs : std::vector<std::string> {} };
+		}
+		else {
+			m_manifest.erase(job.path);
+			failedCount++;
+		}
+	}
+
+	bool result = saveManifest() && saveReport() && failedCount == 0;
+
+	float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	ruc::info("AssetBuild {} assets, {} rebuilt, {} failed, in {:.2f}ms", m_jobs.size(), staleCount, failedCount, time);
+
+	return result;
+}
+
+// -----------------------------------------
+
+void AssetBuild::scan()
+{
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(m_directory)) {
+		if (entry.is_regular_file()) {
+			files.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	auto extension = [](std::string_view path) {
+		size_t dot = path.find_last_of('.');
+		return dot != std::string_view::npos ? path.substr(dot) : std::string_view {};
+	};
+
+	// Font, .fnt + .png -> .ifnt, the atlas image is not a texture of its own
+	std::unordered_set<std::string> images; // Part of another asset
+	for (const auto& path : files) {
+		if (extension(path) == ".fnt") {
+			std::string font = path.substr(0, path.size() - 4);
+			images.insert(font + ".png");
+			m_jobs.push_back({ "font", FontHeader::currentVersion, path, font + ".ifnt", { path, font + ".png" },
+			                   [font]() { return Font::cook(font); } });
+		}
+	}
+
+	// Cubemap, -px/-nx/.. .png/.jpg -> .ktx2 with six faces, the faces are not textures of their own
+	static constexpr const char* faces[6] { "-px", "-nx", "-py", "-ny", "-pz", "-nz" };
+	for (const auto& path : files) {
+		auto type = extension(path);
+		std::string base = path.substr(0, path.size() - type.size());
+		if ((type != ".png" && type != ".jpg" && type != ".jpeg") || !base.ends_with("-px")) {
+			continue;
+		}
+
+		std::string cubemap = base.substr(0, base.size() - 3) + std::string(type);
+		Job job { "cubemap", textureVersion, cubemap, cubemap + ".ktx2", {}, [cubemap]() { return TextureCubemap::cook(cubemap); } };
+		for (const char* face : faces) {
+			job.inputs.push_back(base.substr(0, base.size() - 3) + face + std::string(type));
+			images.insert(job.inputs.back());
+		}
+		m_jobs.push_back(std::move(job));
+	}
+
+	for (const auto& path : files) {
+		auto type = extension(path);
+
+		// Texture, .png/.jpg -> .ktx2
+		if ((type == ".png" || type == ".jpg" || type == ".jpeg") && !images.contains(path)) {
+			m_jobs.push_back({ "texture", textureVersion, path, path + ".ktx2", { path },
+			                   [path]() { return Texture2D::cook(path); } });
+		}
+
+		// Model, .obj/.fbx/.dae/.gltf/.glb -> .imesh
+		if (type == ".obj" || type == ".fbx" || type == ".dae" || type == ".gltf" || type == ".glb") {
+			addModel(path);
+		}
+	}
+}
+
+void AssetBuild::addModel(const std::string& path)
+{
+	Job job { "model", MeshHeader::currentVersion, path, path + ".imesh", { path }, [path]() { return Model::cook(path); } };
+
+	// Every file that the importer read in the last build, like buffers, material
+	// libraries and embedded images. Without a last build, the job is stale anyway
+	job.recordInputs = true;
+	if (auto it = m_manifest.find(path); it != m_manifest.end() && !it->second.inputs.empty()) {
+		job.inputs = it->second.inputs;
+	}
+
+	m_jobs.push_back(std::move(job));
+}
+
+uint64_t AssetBuild::hash(const Job& job) const
+{
+	uint64_t result = hashBytes({ reinterpret_cast<const uint8_t*>(job.converter.data()), job.converter.size() }, job.version);
+	for (const auto& input : job.inputs) {
+		result = hashBytes({ reinterpret_cast<const uint8_t*>(input.data()), input.size() }, result);
+
+		// A missing input hashes as empty, the conversion then reports it
+		if (auto file = MappedFile::create(input)) {
+			result = hashBytes({ file->data(), file->size() }, result);
+		}
+	}
+
+	return result;
+}
+
+// -----------------------------------------
+
+void AssetBuild::loadManifest()
+{
+	std::ifstream file(manifestPath);
+
+	// Lines of: hash path, followed by the recorded inputs on lines of: tab input
+	std::string line;
+	Entry* entry = nullptr;
+	while (std::getline(file, line)) {
+		if (line.starts_with('\t')) {
+			if (entry) {
+				entry->inputs.push_back(line.substr(1));
+			}
+			continue;
+		}
+
+		size_t space = line.find(' ');
+		if (space == std::string::npos) {
+			entry = nullptr;
+			continue;
+		}
+		entry = &m_manifest[line.substr(space + 1)];
+		entry->hash = std::stoull(line.substr(0, space));
+	}
+}
+
+bool AssetBuild::saveManifest() const
+{
+	std::vector<std::string> paths;
+	for (const auto& [path, entry] : m_manifest) {
+		paths.push_back(path);
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::ofstream file(manifestPath, std::ios::trunc);
+	for (const auto& path : paths) {
+		const auto& entry = m_manifest.at(path);
+		file << entry.hash << ' ' << path << '\n';
+		for (const auto& input : entry.inputs) {
+			file << '\t' << input << '\n';
+		}
+	}
+
+	if (!file) {
+		ruc::error("AssetBuild could not write: '{}'", manifestPath);
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetBuild::saveReport() const
+{
+	// Slowest first
+	std::vector<const Job*> jobs;
+	for (const auto& job : m_jobs) {
+		jobs.push_back(&job);
+	}
+	std::sort(jobs.begin(), jobs.end(), [](const Job* a, const Job* b) { return a->time > b->time; });
+
+	std::ofstream file(reportPath, std::ios::trunc);
+	for (const auto* job : jobs) {
+		const char* status = !job->stale ? "up to date" : job->result ? "rebuilt" : "failed";
+		file << std::fixed << std::setprecision(2) << job->time << "ms\t" << job->converter << '\t' << status << '\t' << job->path << '\n';
+	}
+
+	if (!file) {
+		ruc::error("AssetBuild could not write: '{}'", reportPath);
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace Inferno
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <cstdint> // uint32_t, uint64_t
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Inferno {
+
+// Incremental build of an asset directory. Every conversion is hashed over the
+// contents of its inputs and the version of its converter, only the ones whose
+// hash changed since the last build are run, in parallel. The archive is written
+// last, when anything in the directory changed.
+class AssetBuild final {
+public:
+	static constexpr const char* manifestPath = "assets.manifest"; // Hashes of the last build
+	static constexpr const char* reportPath = "assets.report";     // Time spent per asset
+
+	AssetBuild(std::string_view directory, std::string_view archive, bool compress);
+
+	bool run();
+
+private:
+	struct Job {
+		std::string converter;
+		uint32_t version { 0 };          // Bumping it rebuilds everything the converter made
+		std::string path;                // Main input
+		std::string output;              // Rebuilt if it is missing
+		std::vector<std::string> inputs; // Includes the main input
+		std::function<bool()> convert;
+		bool recordInputs { false }; // Inputs are the files the conversion read, known after it ran
+
+		uint64_t hash { 0 };
+		bool stale { false };
+		bool result { true };
+		float time { 0.0f }; // ms
+	};
+
+	void scan();
+	void addModel(const std::string& path);
+	uint64_t hash(const Job& job) const;
+
+	void loadManifest();
+	bool saveManifest() const;
+	bool saveReport() const;
+
+	std::string m_directory;
+	std::string m_archive;
+	bool m_compress { false };
+
+	struct Entry {
+		uint64_t hash { 0 };
+		std::vector<std::string> inputs; // Recorded by the last conversion
+	};
+
+	std::vector<Job> m_jobs;
+	std::unordered_map<std::string, Entry> m_manifest; // On the main input
+};
+
+} // namespace Inferno
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 Riyyi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>  // std::sort
+#include <cstdio>     // fprintf
+#include <cstring>    // strcmp
+#include <filesystem> // std::filesystem::is_directory, std::filesystem::recursive_directory_iterator
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "inferno/asset/font.h"
+#include "inferno/asset/model.h"
+#include "inferno/asset/texture.h"
+#include "inferno/io/bcn.h"
+#include "inferno/io/file-system.h"
+#include "inferno/io/pak.h"
+
+#include "asset-build.h"
+
+static int usage(const char* name)
+{
+	fprintf(stderr, "usage: %s font <path without extension> [--embed-atlas]\n", name);
+	fprintf(stderr, "       %s texture <path or directory> [bc1|bc3|bc5|bc7]\n", name);
+	fprintf(stderr, "       %s cubemap <path without -px/-nx/..> [bc1|bc3|bc5|bc7]\n", name);
+	fprintf(stderr, "       %s model <path or directory>\n", name);
+	fprintf(stderr, "       %s pak <output> <directory> [--compress]\n", name);
+	fprintf(stderr, "       %s build <directory> <output> [--compress]\n", name);
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		return usage(argv[0]);
+	}
+
+	// Font, .fnt + .png -> .ifnt
+	if (strcmp(argv[1], "font") == 0) {
+		bool embedAtlas = argc > 3 && strcmp(argv[3], "--embed-atlas") == 0;
+		return Inferno::Font::cook(argv[2], embedAtlas) ? 0 : 1;
+	}
+
+	// Texture, .png/.jpg -> .ktx2, the format is picked per texture if none is given
+	// Cubemap, six -px/-nx/.. .png/.jpg -> one .ktx2
+	if (strcmp(argv[1], "texture") == 0 || strcmp(argv[1], "cubemap") == 0) {
+		std::optional<Inferno::BCn::Format> format;
+		if (argc > 3) {
+			static constexpr const char* names[] = { "bc1", "bc3", "bc5", "bc7" };
+			for (size_t i = 0; i < 4; ++i) {
+				if (strcmp(argv[3], names[i]) == 0) {
+					format = static_cast<Inferno::BCn::Format>(i);
+				}
+			}
+			if (!format) {
+				return usage(argv[0]);
+			}
+		}
+
+		if (strcmp(argv[1], "cubemap") == 0) {
+			return Inferno::TextureCubemap::cook(argv[2], format) ? 0 : 1;
+		}
+
+		if (!std::filesystem::is_directory(argv[2])) {
+			return Inferno::Texture2D::cook(argv[2], format) ? 0 : 1;
+		}
+
+		bool result = true;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[2])) {
+			auto extension = entry.path().extension();
+			if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg")) {
+				result &= Inferno::Texture2D::cook(entry.path().generic_string(), format);
+			}
+		}
+
+		return result ? 0 : 1;
+	}
+
+	// Model, .obj/.fbx/.dae/.gltf/.glb -> .imesh
+	if (strcmp(argv[1], "model") == 0) {
+		if (!std::filesystem::is_directory(argv[2])) {
+			return Inferno::Model::cook(argv[2]) ? 0 : 1;
+		}
+
+		bool result = true;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[2])) {
+			auto extension = entry.path().extension();
+			if (entry.is_regular_file()
+			    && (extension == ".obj" || extension == ".fbx" || extension == ".dae" || extension == ".gltf" || extension == ".glb")) {
+				result &= Inferno::Model::cook(entry.path().generic_string());
+			}
+		}
+
+		return result ? 0 : 1;
+	}
+
+	// Directory -> .pak, files are stored under their path relative to the working directory
+	if (strcmp(argv[1], "pak") == 0 && argc > 3) {
+		bool compress = argc > 4 && strcmp(argv[4], "--compress") == 0;
+
+		std::vector<std::string> files;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[3])) {
+			if (entry.is_regular_file()) {
+				files.push_back(entry.path().generic_string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		return Inferno::Pak::write(argv[2], files, compress) ? 0 : 1;
+	}
+
+	// Directory -> converted assets + .pak, only what changed since the last build
+	if (strcmp(argv[1], "build") == 0 && argc > 3) {
+		bool compress = argc > 4 && strcmp(argv[4], "--compress") == 0;
+
+		// Sources are read from disk, not from an archive of the previous build
+		Inferno::FileSystem::the().unmountAll();
+
+		Inferno::AssetBuild build(argv[2], argv[3], compress);
+		return build.run() ? 0 : 1;
+	}
+
+	return usage(argv[0]);
+}